@@ -0,0 +1,245 @@
+/*
+* MIT License
+*
+* Copyright (c) 2018 Antonio Alecrim Jr
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*/
+
+#include "capture.h"
+#include <QDebug>
+#include <QElapsedTimer>
+#include <QFileInfo>
+#include <climits>
+#ifdef Q_OS_WIN
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+CaptureQueue::CaptureQueue() : ring(capture_queue_size), textRing(capture_text_ring_size)
+{
+    head.store(0);
+    tail.store(0);
+    tailCache = 0;
+    dropped.store(0);
+    droppedTime = 0;
+    textHead = 0;
+    textTail.store(0);
+    textTailCache = 0;
+}
+
+bool CaptureQueue::push(const QPointF &pos, int time, QEvent::Type type, int argI, const QString &argS, const QPointF &pos2)
+{
+    quint32 h = head.load();
+    int length = argS.size();
+    quint32 textUnits = length > capture_text_size ? static_cast<quint32>(length) : 0;
+    bool full = length > 0xffff;
+
+    if (!full && h - tailCache == static_cast<quint32>(capture_queue_size)) {
+        tailCache = tail.loadAcquire();
+        full = h - tailCache == static_cast<quint32>(capture_queue_size);
+    }
+    if (!full && textUnits > capture_text_ring_size - (textHead - textTailCache)) {
+        textTailCache = textTail.loadAcquire();
+        full = textUnits > capture_text_ring_size - (textHead - textTailCache);
+    }
+    if (full) {
+        droppedTime += time;
+        dropped.fetchAndAddRelaxed(1);
+        return false;
+    }
+
+    captureRecord &rec = ring[h & (capture_queue_size - 1)];
+    rec.x = pos.x();
+    rec.y = pos.y();
+    rec.x2 = pos2.x();
+    rec.y2 = pos2.y();
+    rec.time = static_cast<qint32>(qMin<qint64>(time + droppedTime, INT_MAX));
+    rec.type = type;
+    rec.argI = argI;
+    rec.textLength = static_cast<quint16>(length);
+    if (textUnits == 0) {
+        memcpy(rec.text, argS.utf16(), length * sizeof(ushort));
+    }
+    else {
+        // rare (key text is a character or two, wait steps carry a condition)
+        quint32 at = textHead & (capture_text_ring_size - 1);
+        quint32 first = qMin<quint32>(textUnits, capture_text_ring_size - at);
+        memcpy(textRing.data() + at, argS.utf16(), first * sizeof(ushort));
+        memcpy(textRing.data(), argS.utf16() + first, (textUnits - first) * sizeof(ushort));
+        textHead += textUnits;
+    }
+    droppedTime = 0;
+    // publishes the text units too, the consumer reads them after acquiring head
+    head.storeRelease(h + 1);
+
+    return true;
+}
+
+int CaptureQueue::drain(QVector<recEvent> *out)
+{
+    quint32 t = tail.load();
+    quint32 h = head.loadAcquire();
+    quint32 textAt = textTail.load();
+    int count = static_cast<int>(h - t);
+
+    for (; t != h; t++) {
+        const captureRecord &rec = ring.at(t & (capture_queue_size - 1));
+        recEvent ev;
+        ev.pos = QPointF(rec.x, rec.y);
+        ev.pos2 = QPointF(rec.x2, rec.y2);
+        ev.time = rec.time;
+        ev.type = static_cast<QEvent::Type>(rec.type);
+        ev.argI = rec.argI;
+        if (rec.textLength > capture_text_size) {
+            quint32 at = textAt & (capture_text_ring_size - 1);
+            quint32 first = qMin<quint32>(rec.textLength, capture_text_ring_size - at);
+            ev.argS = QString::fromUtf16(textRing.constData() + at, first);
+            ev.argS.append(QString::fromUtf16(textRing.constData(), rec.textLength - first));
+            textAt += rec.textLength;
+        }
+        else {
+            ev.argS = QString::fromUtf16(rec.text, rec.textLength);
+        }
+        out->append(ev);
+    }
+    textTail.storeRelease(textAt);
+    tail.storeRelease(t);
+
+    return count;
+}
+
+quint32 CaptureQueue::droppedCount() const
+{
+    return dropped.load();
+}
+
+CaptureWriter::CaptureWriter(const QString &path, qint64 rotateBytes, QObject *parent) : QThread(parent)
+{
+    this->path = path;
+    this->rotateBytes = rotateBytes;
+    segment = 0;
+    written = 0;
+    stopping.store(0);
+}
+
+CaptureWriter::~CaptureWriter()
+{
+    stop();
+}
+
+bool CaptureWriter::open_segment()
+{
+    QString name = path;
+
+    if (segment > 0) {
+        QFileInfo info(path);
+        name = info.path() + "/" + info.completeBaseName() + "." + QString::number(segment);
+        if (!info.suffix().isEmpty())
+            name += "." + info.suffix();
+    }
+    file.setFileName(name);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        qDebug() << "Qtghost:" << "can't create capture file:" << name << file.errorString();
+        return false;
+    }
+
+    QByteArray header;
+    encoder.begin(&header);
+
+    return file.write(header) == header.size();
+}
+
+void CaptureWriter::sync()
+{
+    file.flush();
+#ifdef Q_OS_WIN
+    _commit(file.handle());
+#else
+    fsync(file.handle());
+#endif
+}
+
+bool CaptureWriter::begin()
+{
+    if (!open_segment())
+        return false;
+    start(QThread::LowPriority);
+
+    return true;
+}
+
+void CaptureWriter::run()
+{
+    QVector<recEvent> batch;
+    QByteArray out;
+    QElapsedTimer sinceSync;
+
+    sinceSync.start();
+    forever {
+        // read before draining, so nothing pushed before stop() is left behind
+        bool last = stopping.loadAcquire();
+
+        batch.resize(0);
+        out.resize(0);
+        queue.drain(&batch);
+        foreach (const recEvent &ev, batch) {
+            encoder.encode(ev, &out);
+        }
+        if (!out.isEmpty() && file.isOpen() && file.write(out) == out.size()) {
+            written += batch.size();
+            if (rotateBytes > 0 && file.pos() >= rotateBytes) {
+                sync();
+                file.close();
+                segment++;
+                open_segment();
+            }
+        }
+        if (last)
+            break;
+        if (sinceSync.elapsed() >= capture_sync_interval) {
+            sync();
+            sinceSync.restart();
+        }
+        msleep(capture_poll_interval);
+    }
+    if (file.isOpen()) {
+        sync();
+        file.close();
+    }
+}
+
+void CaptureWriter::stop()
+{
+    stopping.storeRelease(1);
+    wait();
+}
+
+QJsonObject CaptureWriter::toJSON() const
+{
+    QJsonObject obj;
+
+    obj.insert("path", path);
+    obj.insert("files", segment + 1);
+    obj.insert("events", static_cast<double>(written));
+    obj.insert("dropped", static_cast<double>(queue.droppedCount()));
+
+    return obj;
+}
@@ -0,0 +1,161 @@
+/*
+* MIT License
+*
+* Copyright (c) 2018 Antonio Alecrim Jr
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*/
+
+#ifndef CAPTURE_H
+#define CAPTURE_H
+
+#include <QAtomicInteger>
+#include <QFile>
+#include <QJsonObject>
+#include <QThread>
+#include <QVector>
+#include "recbinary.h"
+#include "recevent.h"
+
+const int capture_queue_size = 16384; ///< \brief capture queue records (power of two), 1 MB.
+const int capture_text_size = 9; ///< \brief argS UTF-16 units stored in place, longer ones go to the text ring.
+const int capture_text_ring_size = 65536; ///< \brief text ring UTF-16 units (power of two), 128 KB.
+const int capture_poll_interval = 20; ///< \brief ms between queue drains.
+const int capture_sync_interval = 1000; ///< \brief ms between fsyncs of the capture file.
+
+///< \brief a recorded event in the capture queue, fixed size (64 bytes).
+struct captureRecord {
+    double x; ///< \brief pos x.
+    double y; ///< \brief pos y.
+    double x2; ///< \brief pos2 x.
+    double y2; ///< \brief pos2 y.
+    qint32 time; ///< \brief delay since the previous event (ms).
+    qint32 type; ///< \brief QEvent::Type.
+    qint32 argI; ///< \brief integer argument.
+    quint16 textLength; ///< \brief argS length, in the text ring when above capture_text_size.
+    ushort text[capture_text_size]; ///< \brief argS UTF-16 units.
+};
+
+/**
+  \brief lock-free single producer (GUI thread), single consumer (CaptureWriter) queue of events.
+
+  push() only copies a fixed size record and publishes it with a release store, it
+  never blocks nor allocates. An argS longer than capture_text_size is copied to a
+  second preallocated ring of UTF-16 units, read back in record order. When the
+  consumer falls behind and either ring is full, the event is counted as dropped and
+  its delay is carried to the next event pushed, so the timeline keeps its length.
+*/
+class CaptureQueue
+{
+    QVector<captureRecord> ring; ///< \brief capture_queue_size records.
+    QAtomicInteger<quint32> head; ///< \brief next record to be written, producer.
+    QAtomicInteger<quint32> tail; ///< \brief next record to be read, consumer.
+    quint32 tailCache; ///< \brief producer copy of tail, reloaded when the queue looks full.
+    QAtomicInteger<quint32> dropped; ///< \brief events lost to a full queue.
+    qint64 droppedTime; ///< \brief delay of the events dropped since the last push, producer.
+    QVector<ushort> textRing; ///< \brief capture_text_ring_size units of long argS.
+    quint32 textHead; ///< \brief next text unit to be written, producer.
+    QAtomicInteger<quint32> textTail; ///< \brief next text unit to be read, consumer.
+    quint32 textTailCache; ///< \brief producer copy of textTail, reloaded when the text ring looks full.
+
+public:
+    CaptureQueue();
+    /**
+      \brief queues an event, producer side.
+      \return false if the queue was full (the event is dropped, its delay goes to the next one).
+    */
+    bool push(const QPointF &pos, int time, QEvent::Type type, int argI, const QString &argS, const QPointF &pos2);
+    /**
+      \brief takes the queued events, consumer side.
+      \param out where the events are appended.
+      \return number of events taken.
+    */
+    int drain(QVector<recEvent> *out);
+    /**
+      \brief number of events dropped so far.
+    */
+    quint32 droppedCount() const;
+};
+
+/**
+  \brief background persistence of a recording.
+
+  Drains the capture queue every capture_poll_interval, encodes the events in the
+  binary format (see recbinary.h, appendable: a crash only loses the records not
+  written yet) and appends them to the capture file, fsync'ed every
+  capture_sync_interval. With a rotation size, the recording rolls over to
+  numbered files (name.1.qgr, name.2.qgr...), each one a complete recording.
+*/
+class CaptureWriter : public QThread
+{
+    Q_OBJECT
+
+    CaptureQueue queue; ///< \brief events from the GUI thread.
+    QString path; ///< \brief first capture file.
+    qint64 rotateBytes; ///< \brief file size that starts a new file, 0 for none.
+    QFile file; ///< \brief current capture file.
+    int segment; ///< \brief current file number.
+    RecEncoder encoder; ///< \brief encoding state of the current file.
+    qint64 written; ///< \brief events written.
+    QAtomicInt stopping; ///< \brief set by stop().
+
+    /**
+      \brief opens capture file number segment and writes its header.
+      \return false on failure.
+    */
+    bool open_segment();
+    /**
+      \brief flushes the current file to disk.
+    */
+    void sync();
+
+protected:
+    void run() override;
+
+public:
+    /**
+      \brief constructor.
+      \param path capture file.
+      \param rotateBytes file size that starts a new file, 0 for none.
+    */
+    CaptureWriter(const QString &path, qint64 rotateBytes, QObject *parent = nullptr);
+    ~CaptureWriter();
+    /**
+      \brief opens the first capture file and starts the writer thread.
+      \return false if the file can't be created.
+    */
+    bool begin();
+    /**
+      \brief queues an event, GUI thread (see CaptureQueue::push).
+    */
+    inline bool push(const QPointF &pos, int time, QEvent::Type type, int argI, const QString &argS, const QPointF &pos2)
+    {
+        return queue.push(pos, time, type, argI, argS, pos2);
+    }
+    /**
+      \brief writes what is left in the queue, syncs and waits for the writer thread.
+    */
+    void stop();
+    /**
+      \brief capture summary as JSON: path, files, events written and dropped.
+    */
+    QJsonObject toJSON() const;
+};
+
+#endif // CAPTURE_H
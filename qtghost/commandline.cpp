@@ -0,0 +1,128 @@
+/*
+* MIT License
+*
+* Copyright (c) 2018 Antonio Alecrim Jr
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*/
+
+#include "commandline.h"
+#include <QCoreApplication>
+#include <QStringList>
+
+CommandLine::CommandLine() :
+    recordOption(QStringList() << "r" << "record", QCoreApplication::translate("record", "Start recording.")),
+    captureOption(QStringList() << "capture", QCoreApplication::translate("record", "Record to this file instead of memory."), "file"),
+    rotateOption(QStringList() << "rotate", QCoreApplication::translate("record", "Capture file size that starts a new file."), "MB"),
+    stopRecordOption(QStringList() << "s" << "stop-recording", QCoreApplication::translate("stop", "Stop recording.")),
+    playOption(QStringList() << "p" << "play", QCoreApplication::translate("play", "Start playing.")),
+    stepOption(QStringList() << "e" << "step", QCoreApplication::translate("step", "Pay one step.")),
+    getRecOption(QStringList() << "g" << "get-rec", QCoreApplication::translate("get", "Get recorded ghost.")),
+    getBinOption(QStringList() << "b" << "get-bin", QCoreApplication::translate("get", "Get recorded ghost in binary format.")),
+    subscribeOption(QStringList() << "u" << "subscribe", QCoreApplication::translate("subscribe", "Push recorded events as they come.")),
+    liveOnlyOption(QStringList() << "live-only", QCoreApplication::translate("subscribe", "Subscribed events are not kept in memory.")),
+    unsubscribeOption(QStringList() << "unsubscribe", QCoreApplication::translate("subscribe", "Stop pushing recorded events.")),
+    simplifyOption(QStringList() << "f" << "simplify", QCoreApplication::translate("simplify", "Mouse path simplification tolerance (0 disables)."), "px"),
+    minDistanceOption(QStringList() << "min-distance", QCoreApplication::translate("simplify", "Drop mouse moves closer than this to the previous one."), "px"),
+    minIntervalOption(QStringList() << "min-interval", QCoreApplication::translate("simplify", "Drop mouse moves sooner than this after the previous one."), "ms"),
+    touchCoalesceOption(QStringList() << "touch-coalesce", QCoreApplication::translate("touch", "Merge touch moves closer than this (0 disables)."), "ms"),
+    waitOption(QStringList() << "w" << "wait", QCoreApplication::translate("wait", "Reply once the condition holds."), "condition"),
+    waitStepOption(QStringList() << "wait-step", QCoreApplication::translate("wait", "Record a step waiting for the condition."), "condition"),
+    waitTimeoutOption(QStringList() << "wait-timeout", QCoreApplication::translate("wait", "Give up waiting after ms."), "ms"),
+    speedOption(QStringList() << "speed", QCoreApplication::translate("play", "Playback speed multiplier."), "x"),
+    maxGapOption(QStringList() << "max-gap", QCoreApplication::translate("play", "Cap on any single delay while playing."), "ms"),
+    fastOption(QStringList() << "fast", QCoreApplication::translate("play", "Play as fast as the event loop allows.")),
+    fromOption(QStringList() << "from", QCoreApplication::translate("play", "Index of the first event played."), "n"),
+    toOption(QStringList() << "to", QCoreApplication::translate("play", "Index of the event the play stops at."), "n"),
+    checkpointOption(QStringList() << "checkpoint", QCoreApplication::translate("play", "Hash the window every n events played."), "n"),
+    forceFramesOption(QStringList() << "force-frames", QCoreApplication::translate("play", "Request a frame after every event played.")),
+    seekOption(QStringList() << "seek", QCoreApplication::translate("seek", "Move the play cursor to an event."), "n"),
+    seekTimeOption(QStringList() << "seek-time", QCoreApplication::translate("seek", "Move the play cursor to a recorded time."), "ms"),
+    pauseOption(QStringList() << "pause", QCoreApplication::translate("pause", "Pause the play.")),
+    resumeOption(QStringList() << "resume", QCoreApplication::translate("pause", "Resume the paused play.")),
+    playReportOption(QStringList() << "t" << "play-report", QCoreApplication::translate("play", "Get the timing report of the last play.")),
+    latenessOption(QStringList() << "lateness", QCoreApplication::translate("play", "Add per event lateness (us) to the play report.")),
+    getVerOption(QStringList() << "v" << "version", QCoreApplication::translate("version", "send version.")),
+    getScrOption(QStringList() << "c" << "screenshot", QCoreApplication::translate("screenshot", "take screenshot.")),
+    scrFormatOption(QStringList() << "format", QCoreApplication::translate("screenshot", "Screenshot encoding: png, raw, fast or diff."), "format", "png"),
+    scrLevelOption(QStringList() << "level", QCoreApplication::translate("screenshot", "PNG compression level (0-9)."), "level"),
+    scrRegionOption(QStringList() << "region", QCoreApplication::translate("screenshot", "Screenshot sub-rectangle."), "x,y,w,h"),
+    scrKeyframeOption(QStringList() << "keyframe", QCoreApplication::translate("screenshot", "Diff screenshot: send every tile.")),
+    assertOption(QStringList() << "a" << "assert", QCoreApplication::translate("assert", "Compare the current frame to a reference image."), "id"),
+    toleranceOption(QStringList() << "tolerance", QCoreApplication::translate("assert", "Per channel difference still counted as equal."), "0-255"),
+    maxDiffOption(QStringList() << "max-diff", QCoreApplication::translate("assert", "Fraction of differing pixels still passing."), "ratio"),
+    phashOption(QStringList() << "phash", QCoreApplication::translate("assert", "Pass on perceptual hash distance instead."), "bits"),
+    maskOption(QStringList() << "mask", QCoreApplication::translate("assert", "Send back a PNG mask of the differing pixels.")),
+    shmOption(QStringList() << "m" << "shm", QCoreApplication::translate("shm", "Create the shared memory frame ring."), "name"),
+    shmSlotsOption(QStringList() << "slots", QCoreApplication::translate("shm", "Number of frame slots."), "n"),
+    shmFrameOption(QStringList() << "shm-frame", QCoreApplication::translate("shm", "Export the current frame.")),
+    shmStreamOption(QStringList() << "shm-stream", QCoreApplication::translate("shm", "Export every rendered frame.")),
+    shmStopOption(QStringList() << "shm-stop", QCoreApplication::translate("shm", "Stop exporting every rendered frame.")),
+    loadOption(QStringList() << "l" << "load", QCoreApplication::translate("load", "Map an indexed recording file (app side)."), "file")
+{
+    parser.setApplicationDescription("Qtghost");
+    parser.addOption(recordOption);
+    parser.addOption(captureOption);
+    parser.addOption(rotateOption);
+    parser.addOption(stopRecordOption);
+    parser.addOption(playOption);
+    parser.addOption(stepOption);
+    parser.addOption(getRecOption);
+    parser.addOption(getBinOption);
+    parser.addOption(subscribeOption);
+    parser.addOption(liveOnlyOption);
+    parser.addOption(unsubscribeOption);
+    parser.addOption(simplifyOption);
+    parser.addOption(minDistanceOption);
+    parser.addOption(minIntervalOption);
+    parser.addOption(touchCoalesceOption);
+    parser.addOption(waitOption);
+    parser.addOption(waitStepOption);
+    parser.addOption(waitTimeoutOption);
+    parser.addOption(speedOption);
+    parser.addOption(maxGapOption);
+    parser.addOption(fastOption);
+    parser.addOption(fromOption);
+    parser.addOption(toOption);
+    parser.addOption(checkpointOption);
+    parser.addOption(forceFramesOption);
+    parser.addOption(seekOption);
+    parser.addOption(seekTimeOption);
+    parser.addOption(pauseOption);
+    parser.addOption(resumeOption);
+    parser.addOption(playReportOption);
+    parser.addOption(latenessOption);
+    parser.addOption(getVerOption);
+    parser.addOption(getScrOption);
+    parser.addOption(scrFormatOption);
+    parser.addOption(scrLevelOption);
+    parser.addOption(scrRegionOption);
+    parser.addOption(scrKeyframeOption);
+    parser.addOption(assertOption);
+    parser.addOption(toleranceOption);
+    parser.addOption(maxDiffOption);
+    parser.addOption(phashOption);
+    parser.addOption(maskOption);
+    parser.addOption(shmOption);
+    parser.addOption(shmSlotsOption);
+    parser.addOption(shmFrameOption);
+    parser.addOption(shmStreamOption);
+    parser.addOption(shmStopOption);
+    parser.addOption(loadOption);
+}
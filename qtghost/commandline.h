@@ -0,0 +1,91 @@
+/*
+* MIT License
+*
+* Copyright (c) 2018 Antonio Alecrim Jr
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*/
+
+#ifndef COMMANDLINE_H
+#define COMMANDLINE_H
+
+#include <QCommandLineOption>
+#include <QCommandLineParser>
+
+/**
+  \brief options of the v1 text commands.
+
+  Built once and reused for every command: parsing a packet only splits it
+  and looks the options up, the options themselves are not rebuilt.
+*/
+struct CommandLine {
+    QCommandLineParser parser; ///< \brief parser of the options below.
+    const QCommandLineOption recordOption; ///< \brief -r, --record: start recording.
+    const QCommandLineOption captureOption; ///< \brief --capture <file>: record to this file instead of memory.
+    const QCommandLineOption rotateOption; ///< \brief --rotate <MB>: capture file size that starts a new file.
+    const QCommandLineOption stopRecordOption; ///< \brief -s, --stop-recording: stop recording.
+    const QCommandLineOption playOption; ///< \brief -p, --play: start playing.
+    const QCommandLineOption stepOption; ///< \brief -e, --step: pay one step.
+    const QCommandLineOption getRecOption; ///< \brief -g, --get-rec: get recorded ghost.
+    const QCommandLineOption getBinOption; ///< \brief -b, --get-bin: get recorded ghost in binary format.
+    const QCommandLineOption subscribeOption; ///< \brief -u, --subscribe: push recorded events as they come.
+    const QCommandLineOption liveOnlyOption; ///< \brief --live-only: subscribed events are not kept in memory.
+    const QCommandLineOption unsubscribeOption; ///< \brief --unsubscribe: stop pushing recorded events.
+    const QCommandLineOption simplifyOption; ///< \brief -f, --simplify <px>: mouse path simplification tolerance (0 disables).
+    const QCommandLineOption minDistanceOption; ///< \brief --min-distance <px>: drop mouse moves closer than this to the previous one.
+    const QCommandLineOption minIntervalOption; ///< \brief --min-interval <ms>: drop mouse moves sooner than this after the previous one.
+    const QCommandLineOption touchCoalesceOption; ///< \brief --touch-coalesce <ms>: merge touch moves closer than this (0 disables).
+    const QCommandLineOption waitOption; ///< \brief -w, --wait <condition>: reply once the condition holds.
+    const QCommandLineOption waitStepOption; ///< \brief --wait-step <condition>: record a step waiting for the condition.
+    const QCommandLineOption waitTimeoutOption; ///< \brief --wait-timeout <ms>: give up waiting after ms.
+    const QCommandLineOption speedOption; ///< \brief --speed <x>: playback speed multiplier.
+    const QCommandLineOption maxGapOption; ///< \brief --max-gap <ms>: cap on any single delay while playing.
+    const QCommandLineOption fastOption; ///< \brief --fast: play as fast as the event loop allows.
+    const QCommandLineOption fromOption; ///< \brief --from <n>: index of the first event played.
+    const QCommandLineOption toOption; ///< \brief --to <n>: index of the event the play stops at.
+    const QCommandLineOption checkpointOption; ///< \brief --checkpoint <n>: hash the window every n events played.
+    const QCommandLineOption forceFramesOption; ///< \brief --force-frames: request a frame after every event played.
+    const QCommandLineOption seekOption; ///< \brief --seek <n>: move the play cursor to an event.
+    const QCommandLineOption seekTimeOption; ///< \brief --seek-time <ms>: move the play cursor to a recorded time.
+    const QCommandLineOption pauseOption; ///< \brief --pause: pause the play.
+    const QCommandLineOption resumeOption; ///< \brief --resume: resume the paused play.
+    const QCommandLineOption playReportOption; ///< \brief -t, --play-report: get the timing report of the last play.
+    const QCommandLineOption latenessOption; ///< \brief --lateness: add per event lateness (us) to the play report.
+    const QCommandLineOption getVerOption; ///< \brief -v, --version: send version.
+    const QCommandLineOption getScrOption; ///< \brief -c, --screenshot: take screenshot.
+    const QCommandLineOption scrFormatOption; ///< \brief --format <format>: screenshot encoding: png, raw, fast or diff.
+    const QCommandLineOption scrLevelOption; ///< \brief --level <level>: PNG compression level (0-9).
+    const QCommandLineOption scrRegionOption; ///< \brief --region <x,y,w,h>: screenshot sub-rectangle.
+    const QCommandLineOption scrKeyframeOption; ///< \brief --keyframe: diff screenshot: send every tile.
+    const QCommandLineOption assertOption; ///< \brief -a, --assert <id>: compare the current frame to a reference image.
+    const QCommandLineOption toleranceOption; ///< \brief --tolerance <0-255>: per channel difference still counted as equal.
+    const QCommandLineOption maxDiffOption; ///< \brief --max-diff <ratio>: fraction of differing pixels still passing.
+    const QCommandLineOption phashOption; ///< \brief --phash <bits>: pass on perceptual hash distance instead.
+    const QCommandLineOption maskOption; ///< \brief --mask: send back a PNG mask of the differing pixels.
+    const QCommandLineOption shmOption; ///< \brief -m, --shm <name>: create the shared memory frame ring.
+    const QCommandLineOption shmSlotsOption; ///< \brief --slots <n>: number of frame slots.
+    const QCommandLineOption shmFrameOption; ///< \brief --shm-frame: export the current frame.
+    const QCommandLineOption shmStreamOption; ///< \brief --shm-stream: export every rendered frame.
+    const QCommandLineOption shmStopOption; ///< \brief --shm-stop: stop exporting every rendered frame.
+    const QCommandLineOption loadOption; ///< \brief -l, --load <file>: map an indexed recording file (app side).
+
+    CommandLine();
+};
+
+#endif // COMMANDLINE_H
@@ -0,0 +1,202 @@
+/*
+* MIT License
+*
+* Copyright (c) 2018 Antonio Alecrim Jr
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*/
+
+#include "eventstore.h"
+
+EventStore::EventStore()
+{
+    count = 0;
+    pool.append(QString());
+}
+
+EventStore::EventStore(const EventStore &other) :
+    chunks(other.chunks),
+    count(other.count),
+    pool(other.pool),
+    poolIndex(other.poolIndex),
+    mapped(other.mapped)
+{
+}
+
+EventStore &EventStore::operator=(const EventStore &other)
+{
+    chunks = other.chunks;
+    count = other.count;
+    pool = other.pool;
+    poolIndex = other.poolIndex;
+    mapped = other.mapped;
+
+    return *this;
+}
+
+bool EventStore::map(const QString &path, QString *error)
+{
+    QSharedPointer<MappedRecording> recording(new MappedRecording);
+
+    if (!recording->open(path)) {
+        if (error)
+            *error = recording->errorString();
+        return false;
+    }
+    clear();
+    mapped = recording;
+    count = recording->size();
+
+    return true;
+}
+
+bool EventStore::isMapped() const
+{
+    return !mapped.isNull();
+}
+
+void EventStore::grow()
+{
+    if (spare.isEmpty()) {
+        chunks.append(QSharedPointer<eventChunk>(new eventChunk));
+    }
+    else {
+        chunks.append(spare.takeFirst());
+    }
+}
+
+void EventStore::append(const QPointF &p, int time, QEvent::Type t, int argI, const QString &argS, const QPointF &p2)
+{
+    qint32 string = 0;
+
+    // a mapped recording is read only, appending starts a new in-memory one
+    if (mapped)
+        clear();
+    int offset = count & event_chunk_mask;
+    if (!offset)
+        grow();
+    if (!argS.isEmpty()) {
+        QHash<QString, qint32>::const_iterator it = poolIndex.constFind(argS);
+        if (it != poolIndex.constEnd()) {
+            string = it.value();
+        }
+        else {
+            string = pool.size();
+            pool.append(argS);
+            poolIndex.insert(argS, string);
+        }
+    }
+
+    eventChunk *chunk = chunks.at(chunks.size() - 1).data();
+    chunk->x[offset] = p.x();
+    chunk->y[offset] = p.y();
+    chunk->x2[offset] = p2.x();
+    chunk->y2[offset] = p2.y();
+    chunk->time[offset] = time;
+    chunk->argI[offset] = argI;
+    chunk->argS[offset] = string;
+    chunk->type[offset] = static_cast<quint16>(t);
+    count++;
+}
+
+void EventStore::append(const recEvent &event)
+{
+    append(event.pos, event.time, event.type, event.argI, event.argS, event.pos2);
+}
+
+recEvent EventStore::at(int i) const
+{
+    if (mapped)
+        return mapped->at(i);
+
+    const eventChunk *chunk = chunks.at(i >> event_chunk_bits).data();
+    int offset = i & event_chunk_mask;
+    recEvent event;
+
+    event.pos = QPointF(chunk->x[offset], chunk->y[offset]);
+    event.time = chunk->time[offset];
+    event.type = static_cast<QEvent::Type>(chunk->type[offset]);
+    event.argI = chunk->argI[offset];
+    event.argS = pool.at(chunk->argS[offset]);
+    event.pos2 = QPointF(chunk->x2[offset], chunk->y2[offset]);
+
+    return event;
+}
+
+QEvent::Type EventStore::typeAt(int i) const
+{
+    if (mapped)
+        return mapped->typeAt(i);
+
+    return static_cast<QEvent::Type>(chunks.at(i >> event_chunk_bits)->type[i & event_chunk_mask]);
+}
+
+int EventStore::timeAt(int i) const
+{
+    if (mapped)
+        return mapped->timeAt(i);
+
+    return chunks.at(i >> event_chunk_bits)->time[i & event_chunk_mask];
+}
+
+int EventStore::size() const
+{
+    return count;
+}
+
+bool EventStore::isEmpty() const
+{
+    return !count;
+}
+
+void EventStore::clear()
+{
+    chunks.clear();
+    mapped.reset();
+    count = 0;
+    pool.resize(1);
+    poolIndex.clear();
+}
+
+void EventStore::reserve(int n)
+{
+    int free = count ? (event_chunk_size - (count & event_chunk_mask)) & event_chunk_mask : 0;
+
+    for (; free + spare.size() * event_chunk_size < n; ) {
+        spare.append(QSharedPointer<eventChunk>(new eventChunk));
+    }
+}
+
+bool EventStore::needsReserve() const
+{
+    return spare.isEmpty();
+}
+
+qint64 EventStore::memoryUsage() const
+{
+    qint64 bytes = static_cast<qint64>(chunks.size() + spare.size()) * sizeof(eventChunk);
+
+    foreach (const QString &string, pool) {
+        bytes += string.capacity() * sizeof(QChar);
+    }
+    if (mapped)
+        bytes += mapped->memoryUsage();
+
+    return bytes;
+}
@@ -0,0 +1,153 @@
+/*
+* MIT License
+*
+* Copyright (c) 2018 Antonio Alecrim Jr
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*/
+
+#ifndef EVENTSTORE_H
+#define EVENTSTORE_H
+
+#include <QHash>
+#include <QList>
+#include <QSharedPointer>
+#include <QVector>
+#include "mappedrecording.h"
+#include "recevent.h"
+
+const int event_chunk_bits = 12;
+const int event_chunk_size = 1 << event_chunk_bits; ///< \brief events per chunk (4096).
+const int event_chunk_mask = event_chunk_size - 1;
+
+///< \brief fixed size numeric columns for event_chunk_size events.
+struct eventChunk {
+    qreal x[event_chunk_size]; ///< \brief pos x.
+    qreal y[event_chunk_size]; ///< \brief pos y.
+    qreal x2[event_chunk_size]; ///< \brief pos2 x.
+    qreal y2[event_chunk_size]; ///< \brief pos2 y.
+    qint32 time[event_chunk_size]; ///< \brief delay since previous event.
+    qint32 argI[event_chunk_size]; ///< \brief integer argument.
+    qint32 argS[event_chunk_size]; ///< \brief string pool index, 0 for an empty string.
+    quint16 type[event_chunk_size]; ///< \brief QEvent::Type.
+};
+
+/**
+  \brief chunked struct-of-arrays event storage.
+
+  Events are stored column by column into chunks reserved ahead of time, and
+  argS values are interned in a string pool, so appending an event does not
+  allocate while there are spare chunks left (see needsReserve). Copies are
+  cheap snapshots: they share the chunks, and the original can keep appending
+  past the snapshot size while the snapshot is read.
+
+  A store can also read its events in place from an indexed recording file
+  (see map()), it is then read only until clear().
+*/
+class EventStore
+{
+    QVector<QSharedPointer<eventChunk> > chunks; ///< \brief chunks in use.
+    QList<QSharedPointer<eventChunk> > spare; ///< \brief chunks reserved ahead.
+    int count; ///< \brief number of stored events.
+    QVector<QString> pool; ///< \brief interned strings, pool[0] is the empty string.
+    QHash<QString, qint32> poolIndex; ///< \brief string to pool index.
+    QSharedPointer<MappedRecording> mapped; ///< \brief file-backed events, shared by snapshots, null for in-memory ones.
+
+    /**
+      \brief makes room for one more chunk, taking it from the spare ones if possible.
+    */
+    void grow();
+
+public:
+    EventStore();
+    /**
+      \brief snapshot constructor, shares the chunks of other (spare chunks are not shared).
+    */
+    EventStore(const EventStore &other);
+    EventStore &operator=(const EventStore &other);
+    /**
+      \brief replaces the events by the ones of an indexed recording file, read in place.
+      \param path indexed recording (see mappedrecording.h).
+      \param error set to the reason of a failure, if not null.
+      \return false if the file can't be mapped, the store is left untouched.
+    */
+    bool map(const QString &path, QString *error = nullptr);
+    /**
+      \brief tells if the events are read from a mapped file.
+    */
+    bool isMapped() const;
+    /**
+      \brief stores an event, a mapped store is cleared first (a new in-memory recording).
+      \param p position where the event occurred.
+      \param time delay since previous event.
+      \param t event type.
+      \param argI integer argument.
+      \param argS string argument.
+      \param p2 position 2.
+    */
+    void append(const QPointF &p, int time, QEvent::Type t, int argI, const QString &argS, const QPointF &p2);
+    /**
+      \brief stores an event.
+      \param event event to be stored.
+    */
+    void append(const recEvent &event);
+    /**
+      \brief reads an event.
+      \param i event index, must be lower than size().
+      \return event at index i.
+    */
+    recEvent at(int i) const;
+    /**
+      \brief event type without materializing the whole event.
+      \param i event index, must be lower than size().
+      \return event type at index i.
+    */
+    QEvent::Type typeAt(int i) const;
+    /**
+      \brief event delay without materializing the whole event.
+      \param i event index, must be lower than size().
+      \return delay since previous event at index i.
+    */
+    int timeAt(int i) const;
+    /**
+      \brief number of stored events.
+    */
+    int size() const;
+    bool isEmpty() const;
+    /**
+      \brief removes all events (and the mapping), spare chunks are kept.
+    */
+    void clear();
+    /**
+      \brief reserves chunks ahead, so that n more events can be appended without allocating.
+      \param n number of events.
+    */
+    void reserve(int n);
+    /**
+      \brief tells if the spare chunks are exhausted and reserve should be called.
+    */
+    bool needsReserve() const;
+    /**
+      \brief memory used by the store (chunks, spare chunks and string pool).
+      \return bytes.
+    */
+    qint64 memoryUsage() const;
+};
+
+#endif // EVENTSTORE_H
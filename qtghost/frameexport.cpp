@@ -0,0 +1,212 @@
+/*
+* MIT License
+*
+* Copyright (c) 2018 Antonio Alecrim Jr
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*/
+
+#include "frameexport.h"
+#include <QDebug>
+#include <QDir>
+#include <QOpenGLContext>
+#include <QOpenGLFunctions>
+#include <QSGRendererInterface>
+#include <atomic>
+#include <cstring>
+
+FrameExport::FrameExport(QQuickWindow *view, QObject *parent) : QObject(parent)
+{
+    window = view;
+    map = nullptr;
+    slotCount = 0;
+    slotSize = 0;
+    sequence = 0;
+    streaming = false;
+}
+
+FrameExport::~FrameExport()
+{
+    close();
+}
+
+bool FrameExport::open(const QString &name, int count)
+{
+    close();
+    if (!window || count < 1)
+        return false;
+
+    QSize size = window->size() * window->devicePixelRatio();
+    QString path = name;
+    if (!name.contains('/')) {
+        // tmpfs when available, the file never hits the disk
+        path = (QDir("/dev/shm").exists() ? QString("/dev/shm") : QDir::tempPath()) + "/" + name;
+    }
+    slotCount = count;
+    slotSize = static_cast<int>(sizeof(frameSlotHeader)) + size.width() * size.height() * 4;
+    qint64 total = static_cast<qint64>(sizeof(frameBufferHeader)) + static_cast<qint64>(slotSize) * slotCount;
+
+    file.setFileName(path);
+    if (!file.open(QIODevice::ReadWrite | QIODevice::Truncate) ||
+            !file.setPermissions(QFileDevice::ReadOwner | QFileDevice::WriteOwner) ||
+            !file.resize(total) || !(map = file.map(0, total))) {
+        qDebug() << "Qtghost:" << "unable to map frame export file" << path << file.errorString();
+        close();
+        return false;
+    }
+
+    frameBufferHeader *header = reinterpret_cast<frameBufferHeader*>(map);
+    memset(header, 0, sizeof(frameBufferHeader));
+    memcpy(header->magic, "QGFB", 4);
+    header->version = 1;
+    header->slotCount = static_cast<quint32>(slotCount);
+    header->slotSize = static_cast<quint32>(slotSize);
+    header->headerSize = sizeof(frameBufferHeader);
+    sequence = 0;
+    clock.start();
+    qDebug() << "Qtghost:" << "exporting frames to" << path << slotCount << "slots of" << size;
+
+    return true;
+}
+
+void FrameExport::close()
+{
+    setStreaming(false);
+    QMutexLocker locker(&lock);
+    if (map) {
+        file.unmap(map);
+        map = nullptr;
+    }
+    if (file.isOpen()) {
+        file.close();
+        file.remove();
+    }
+}
+
+bool FrameExport::isOpen() const
+{
+    return map != nullptr;
+}
+
+QJsonObject FrameExport::describe() const
+{
+    QJsonObject description;
+    QSize size = window ? window->size() * window->devicePixelRatio() : QSize();
+
+    description.insert("path", file.fileName());
+    description.insert("slots", slotCount);
+    description.insert("slotSize", slotSize);
+    description.insert("headerSize", static_cast<int>(sizeof(frameBufferHeader)));
+    description.insert("width", size.width());
+    description.insert("height", size.height());
+
+    return description;
+}
+
+frameSlotHeader *FrameExport::beginSlot(int width, int height, quint32 flags, quint64 *seq)
+{
+    if (!map || static_cast<qint64>(sizeof(frameSlotHeader)) + static_cast<qint64>(width) * height * 4 > slotSize) {
+        qDebug() << "Qtghost:" << "frame doesn't fit the export slots (window resized?)";
+        return nullptr;
+    }
+
+    *seq = ++sequence;
+    frameSlotHeader *slot = reinterpret_cast<frameSlotHeader*>(
+                map + sizeof(frameBufferHeader) + (*seq % slotCount) * slotSize);
+    slot->sequence = 0;
+    // readers must see the slot as busy before its pixels change
+    std::atomic_thread_fence(std::memory_order_release);
+    slot->width = static_cast<quint32>(width);
+    slot->height = static_cast<quint32>(height);
+    slot->stride = static_cast<quint32>(width * 4);
+    slot->flags = flags;
+    slot->timestamp = clock.elapsed();
+
+    return slot;
+}
+
+void FrameExport::endSlot(frameSlotHeader *slot, quint64 seq)
+{
+    std::atomic_thread_fence(std::memory_order_release);
+    slot->sequence = seq;
+    reinterpret_cast<frameBufferHeader*>(map)->sequence = seq;
+    emit frameReady(seq, static_cast<int>(seq % slotCount), static_cast<int>(slot->width),
+                    static_cast<int>(slot->height));
+}
+
+quint64 FrameExport::publish(const QImage &frame)
+{
+    QImage image = frame.convertToFormat(QImage::Format_RGBA8888);
+    QMutexLocker locker(&lock);
+    quint64 seq;
+    frameSlotHeader *slot = beginSlot(image.width(), image.height(), 0, &seq);
+
+    if (!slot)
+        return 0;
+    uchar *pixels = reinterpret_cast<uchar*>(slot + 1);
+    int stride = image.width() * 4;
+    for (int y = 0; y < image.height(); y++) {
+        memcpy(pixels + y * stride, image.constScanLine(y), stride);
+    }
+    endSlot(slot, seq);
+
+    return seq;
+}
+
+void FrameExport::setStreaming(bool flag)
+{
+    if (!window || flag == streaming)
+        return;
+
+    streaming = flag;
+    if (!flag) {
+        disconnect(window, nullptr, this, nullptr);
+        return;
+    }
+    if (window->rendererInterface()->graphicsApi() == QSGRendererInterface::OpenGL) {
+        // read back before the swap, on the render thread
+        connect(window, SIGNAL(afterRendering()), SLOT(readBack()), Qt::DirectConnection);
+    }
+    else {
+        connect(window, SIGNAL(frameSwapped()), SLOT(grabFrame()), Qt::QueuedConnection);
+    }
+}
+
+void FrameExport::readBack()
+{
+    QOpenGLContext *context = QOpenGLContext::currentContext();
+
+    if (!context || !window)
+        return;
+    QSize size = window->size() * window->devicePixelRatio();
+    QMutexLocker locker(&lock);
+    quint64 seq;
+    frameSlotHeader *slot = beginSlot(size.width(), size.height(), FRAME_BOTTOM_UP, &seq);
+
+    if (!slot)
+        return;
+    context->functions()->glReadPixels(0, 0, size.width(), size.height(), GL_RGBA, GL_UNSIGNED_BYTE, slot + 1);
+    endSlot(slot, seq);
+}
+
+void FrameExport::grabFrame()
+{
+    if (streaming && window)
+        publish(window->grabWindow());
+}
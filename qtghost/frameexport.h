@@ -0,0 +1,172 @@
+/*
+* MIT License
+*
+* Copyright (c) 2018 Antonio Alecrim Jr
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*/
+
+#ifndef FRAMEEXPORT_H
+#define FRAMEEXPORT_H
+
+#include <QObject>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QImage>
+#include <QJsonObject>
+#include <QMutex>
+#include <QPointer>
+#include <QQuickWindow>
+
+const int frame_export_slots = 4; ///< \brief default number of frame slots.
+
+/**
+  \brief frame ring file header, little endian, at offset 0.
+
+  The file is frameBufferHeader then slotCount slots of slotSize bytes,
+  each one a frameSlotHeader followed by the RGBA8888 pixels.
+*/
+struct frameBufferHeader {
+    char magic[4]; ///< \brief "QGFB".
+    quint32 version; ///< \brief 1.
+    quint32 slotCount; ///< \brief number of slots.
+    quint32 slotSize; ///< \brief bytes per slot, slot header included.
+    quint32 headerSize; ///< \brief offset of the first slot.
+    quint32 reserved; ///< \brief 0.
+    quint64 sequence; ///< \brief last published frame number, 0 before the first one.
+    char padding[32]; ///< \brief up to 64 bytes.
+};
+
+///< \brief frameSlotHeader::flags.
+enum frameSlotFlags {
+    FRAME_BOTTOM_UP = 1 ///< \brief rows are stored bottom to top (OpenGL read back).
+};
+
+/**
+  \brief header of a frame slot.
+
+  sequence is 0 while the slot is being written and the frame number once
+  it's complete: readers copy the pixels then check sequence didn't change.
+*/
+struct frameSlotHeader {
+    quint64 sequence; ///< \brief frame number (slot is sequence % slotCount).
+    quint32 width; ///< \brief width in pixels.
+    quint32 height; ///< \brief height in pixels.
+    quint32 stride; ///< \brief bytes per row.
+    quint32 flags; ///< \brief see frameSlotFlags.
+    qint64 timestamp; ///< \brief ms since the export was opened.
+};
+
+/**
+  \brief exports frames into a shared memory ring (a file mapped by both sides).
+
+  Same-host consumers map the file and read frames in raw form, the control
+  channel only carries small "frame N ready" notifications (see frameReady()).
+  When streaming on OpenGL, every rendered frame is read back on the render
+  thread straight into its slot; other backends grab the window once per
+  swapped frame.
+*/
+class FrameExport : public QObject
+{
+    Q_OBJECT
+
+    QPointer<QQuickWindow> window; ///< \brief exported window.
+    QFile file; ///< \brief ring file, in /dev/shm when available.
+    uchar *map; ///< \brief mapped file.
+    int slotCount; ///< \brief number of slots.
+    int slotSize; ///< \brief bytes per slot.
+    quint64 sequence; ///< \brief last published frame number.
+    QMutex lock; ///< \brief GUI (grab) and render (read back) threads may both publish.
+    QElapsedTimer clock; ///< \brief frame timestamps.
+    bool streaming; ///< \brief every rendered frame is exported.
+
+    /**
+      \brief claims the next slot, marking it as being written.
+      \param width frame width.
+      \param height frame height.
+      \param flags frame flags.
+      \param seq frame number, output.
+      \return slot header, nullptr if the frame doesn't fit.
+    */
+    frameSlotHeader *beginSlot(int width, int height, quint32 flags, quint64 *seq);
+    /**
+      \brief marks a slot as complete and notifies.
+      \param slot slot header.
+      \param seq frame number.
+    */
+    void endSlot(frameSlotHeader *slot, quint64 seq);
+
+public:
+    explicit FrameExport(QQuickWindow *view, QObject *parent = nullptr);
+    ~FrameExport();
+    /**
+      \brief creates (or recreates) the ring file, sized for the current window.
+      \param name file name (in /dev/shm, or the temp dir) or full path.
+      \param count number of slots.
+      \return false if the file can't be created or mapped.
+    */
+    bool open(const QString &name, int count = frame_export_slots);
+    /**
+      \brief unmaps and removes the ring file, stops streaming.
+    */
+    void close();
+    /**
+      \brief if the ring file is open.
+      \return true if open.
+    */
+    bool isOpen() const;
+    /**
+      \brief ring description: path, slots, slotSize, headerSize, width, height.
+      \return JSON object.
+    */
+    QJsonObject describe() const;
+    /**
+      \brief copies a frame into the next slot.
+      \param frame frame, converted to RGBA8888 if needed.
+      \return frame number, 0 if it doesn't fit.
+    */
+    quint64 publish(const QImage &frame);
+    /**
+      \brief exports every rendered frame until stopped.
+      \param flag true: start, false: stop.
+    */
+    void setStreaming(bool flag);
+
+signals:
+    /**
+      \brief emitted when a frame is complete, from the thread that wrote it.
+      \param seq frame number.
+      \param slot slot index.
+      \param width frame width.
+      \param height frame height.
+    */
+    void frameReady(quint64 seq, int slot, int width, int height);
+
+private slots:
+    /**
+      \brief reads the rendered frame back into a slot, render thread (OpenGL only).
+    */
+    void readBack();
+    /**
+      \brief grabs and publishes the window, for backends without read back.
+    */
+    void grabFrame();
+};
+
+#endif // FRAMEEXPORT_H
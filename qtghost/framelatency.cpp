@@ -0,0 +1,201 @@
+/*
+* MIT License
+*
+* Copyright (c) 2018 Antonio Alecrim Jr
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*/
+
+#include "framelatency.h"
+#include <QJsonArray>
+#include <QMutexLocker>
+#include <QScreen>
+#include <algorithm>
+
+LatencyHistogram::LatencyHistogram()
+{
+    reset();
+}
+
+void LatencyHistogram::reset()
+{
+    samples.clear();
+    sum = 0;
+    std::fill(buckets, buckets + latency_buckets, 0);
+}
+
+void LatencyHistogram::add(qint64 us)
+{
+    qint32 sample = static_cast<qint32>(qBound<qint64>(0, us, 0x7fffffff));
+    int bucket = 0;
+
+    while (bucket < latency_buckets - 1 && sample >= (128 << bucket))
+        bucket++;
+    buckets[bucket]++;
+    samples.append(sample);
+    sum += sample;
+}
+
+int LatencyHistogram::count() const
+{
+    return samples.size();
+}
+
+QJsonObject LatencyHistogram::toJSON() const
+{
+    QJsonObject obj;
+    QJsonArray histogram;
+    QVector<qint32> sorted = samples;
+
+    std::sort(sorted.begin(), sorted.end());
+    obj.insert("count", sorted.size());
+    obj.insert("mean", sorted.isEmpty() ? 0.0 : static_cast<double>(sum) / sorted.size());
+    obj.insert("max", sorted.isEmpty() ? 0 : sorted.last());
+    obj.insert("p50", sorted.isEmpty() ? 0 : sorted.at((sorted.size() - 1) * 50 / 100));
+    obj.insert("p95", sorted.isEmpty() ? 0 : sorted.at((sorted.size() - 1) * 95 / 100));
+    obj.insert("p99", sorted.isEmpty() ? 0 : sorted.at((sorted.size() - 1) * 99 / 100));
+    for (int i = 0; i < latency_buckets; i++) {
+        histogram.append(QJsonArray() << (i < latency_buckets - 1 ? 128 << i : 0) << buckets[i]);
+    }
+    obj.insert("histogram", histogram);
+
+    return obj;
+}
+
+FrameLatency::FrameLatency(QObject *parent) : QObject(parent)
+{
+    active = false;
+    finishing = false;
+    forceFrames = false;
+    lastSwap = -1;
+    period = 16666667;
+    frames = 0;
+    dropped = 0;
+    clock.start();
+}
+
+void FrameLatency::setWindow(QQuickWindow *window)
+{
+    QMutexLocker locker(&lock);
+
+    if (this->window == window)
+        return;
+    if (this->window)
+        disconnect(this->window, nullptr, this, nullptr);
+    this->window = window;
+    active = false;
+    if (window) {
+        // render thread (threaded render loop): frame boundaries and timestamps as close to the swap as possible
+        connect(window, SIGNAL(beforeSynchronizing()), SLOT(synchronizing()), Qt::DirectConnection);
+        connect(window, SIGNAL(frameSwapped()), SLOT(swapped()), Qt::DirectConnection);
+    }
+}
+
+void FrameLatency::start(bool force)
+{
+    QMutexLocker locker(&lock);
+
+    if (window && window->screen() && window->screen()->refreshRate() > 0)
+        period = static_cast<qint64>(1e9 / window->screen()->refreshRate());
+    pending.clear();
+    synced.clear();
+    forceFrames = force;
+    lastSwap = -1;
+    frames = 0;
+    dropped = 0;
+    latency.reset();
+    frameTimes.reset();
+    finishing = false;
+    active = !window.isNull();
+}
+
+void FrameLatency::finish()
+{
+    QMutexLocker locker(&lock);
+
+    finishing = true;
+    if (pending.isEmpty() && synced.isEmpty())
+        active = false;
+}
+
+void FrameLatency::eventInjected()
+{
+    {
+        QMutexLocker locker(&lock);
+
+        if (!active)
+            return;
+        pending.append(clock.nsecsElapsed());
+        if (!forceFrames)
+            return;
+    }
+    window->update();
+}
+
+QJsonObject FrameLatency::toJSON()
+{
+    QMutexLocker locker(&lock);
+    QJsonObject obj;
+
+    obj.insert("frames", frames);
+    obj.insert("dropped", dropped);
+    obj.insert("unmatched", pending.size() + synced.size());
+    obj.insert("forced", forceFrames);
+    obj.insert("refresh", 1e9 / period);
+    obj.insert("latency", latency.toJSON());
+    obj.insert("frameTime", frameTimes.toJSON());
+
+    return obj;
+}
+
+void FrameLatency::synchronizing()
+{
+    QMutexLocker locker(&lock);
+
+    // the events injected so far are in this frame, the later ones wait for the next one
+    if (!active || pending.isEmpty())
+        return;
+    synced += pending;
+    pending.clear();
+}
+
+void FrameLatency::swapped()
+{
+    qint64 now = clock.nsecsElapsed();
+    QMutexLocker locker(&lock);
+
+    if (!active)
+        return;
+    frames++;
+    if (lastSwap >= 0)
+        frameTimes.add((now - lastSwap) / 1000);
+    if (!synced.isEmpty()) {
+        // periods between the first chance to show the oldest event and this swap
+        qint64 waited = now - qMax(synced.first(), lastSwap);
+        dropped += static_cast<int>(qMax<qint64>((waited + period / 2) / period - 1, 0));
+        foreach (qint64 injected, synced) {
+            latency.add((now - injected) / 1000);
+        }
+        synced.clear();
+    }
+    lastSwap = now;
+    // a frame in flight at the end of the play doesn't hold the last events
+    if (finishing && pending.isEmpty())
+        active = false;
+}
@@ -0,0 +1,143 @@
+/*
+* MIT License
+*
+* Copyright (c) 2018 Antonio Alecrim Jr
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*/
+
+#ifndef FRAMELATENCY_H
+#define FRAMELATENCY_H
+
+#include <QObject>
+#include <QElapsedTimer>
+#include <QJsonObject>
+#include <QMutex>
+#include <QPointer>
+#include <QQuickWindow>
+#include <QVector>
+
+const int latency_buckets = 16; ///< \brief histogram buckets: < 128 us, < 256 us, ... < 2 s, more.
+
+/**
+  \brief latency samples (us): summary and a power of two histogram.
+*/
+class LatencyHistogram
+{
+    QVector<qint32> samples; ///< \brief every sample (us), for exact percentiles.
+    qint64 sum; ///< \brief sum of samples.
+    qint32 buckets[latency_buckets]; ///< \brief sample count per bucket.
+
+public:
+    LatencyHistogram();
+    /**
+      \brief forgets all samples.
+    */
+    void reset();
+    /**
+      \brief adds one sample.
+      \param us latency in microseconds.
+    */
+    void add(qint64 us);
+    /**
+      \brief number of samples.
+    */
+    int count() const;
+    /**
+      \brief summary as JSON: count, mean, max, p50, p95, p99 (us) and the
+      histogram as [upper bound (us, 0 for the last one), count] pairs.
+    */
+    QJsonObject toJSON() const;
+};
+
+/**
+  \brief input to frame latency of a play.
+
+  Every injected event waits for the first frame synchronized after it
+  (beforeSynchronizing(), the GUI thread is blocked while the scene is copied),
+  and its latency is the time from sendEvent() to that frame's frameSwapped(),
+  i.e. until the first frame that could show its effect is on screen. A frame
+  already rendering when the event came doesn't complete it. Frame times are
+  the intervals between swaps during the play; a swap that completes events
+  more than one refresh period after they came counts the periods it missed as
+  dropped frames.
+
+  Only the frames the application renders anyway are measured: an event that
+  changes nothing waits for the next frame something else requests, which
+  inflates its latency, or stays unmatched. With forced frames a frame is
+  requested after every injected event, so every event completes, at the cost
+  of frames the application would not have rendered.
+*/
+class FrameLatency : public QObject
+{
+    Q_OBJECT
+
+    QPointer<QQuickWindow> window; ///< \brief measured window.
+    QMutex lock; ///< \brief swaps are reported on the render thread.
+    QElapsedTimer clock; ///< \brief time base of every timestamp.
+    bool active; ///< \brief frames are being measured.
+    bool finishing; ///< \brief play is over, stop with the frame of the last events.
+    bool forceFrames; ///< \brief a frame is requested after every injected event.
+    QVector<qint64> pending; ///< \brief injection time (ns) of the events waiting for a frame to be synchronized.
+    QVector<qint64> synced; ///< \brief injection time (ns) of the events in the frames being rendered.
+    qint64 lastSwap; ///< \brief time (ns) of the previous swap, -1 before the first one.
+    qint64 period; ///< \brief refresh period (ns) of the window's screen.
+    int frames; ///< \brief swaps measured.
+    int dropped; ///< \brief refresh periods missed by frames completing events.
+    LatencyHistogram latency; ///< \brief injection to swap, per event.
+    LatencyHistogram frameTimes; ///< \brief swap to swap.
+
+public:
+    explicit FrameLatency(QObject *parent = nullptr);
+    /**
+      \brief sets the measured window, used from the next start() on.
+      \param window measured window, nothing is measured if null.
+    */
+    void setWindow(QQuickWindow *window);
+    /**
+      \brief forgets previous results and starts measuring, to be called when a play starts.
+      \param force request a frame after every injected event.
+    */
+    void start(bool force = false);
+    /**
+      \brief stops measuring once the events injected so far got their frame.
+    */
+    void finish();
+    /**
+      \brief an event was just injected, requests a frame if they are forced.
+    */
+    void eventInjected();
+    /**
+      \brief results as JSON: frames, dropped, unmatched (events still waiting
+      for a frame), forced, latency and frameTime histograms (see LatencyHistogram).
+    */
+    QJsonObject toJSON();
+
+private slots:
+    /**
+      \brief a frame is being synchronized, render thread (GUI thread blocked).
+    */
+    void synchronizing();
+    /**
+      \brief a frame reached the screen, render thread.
+    */
+    void swapped();
+};
+
+#endif // FRAMELATENCY_H
@@ -0,0 +1,215 @@
+/*
+* MIT License
+*
+* Copyright (c) 2018 Antonio Alecrim Jr
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*/
+
+#include "mappedrecording.h"
+#include <QtEndian>
+#include <string.h>
+
+#if Q_BYTE_ORDER == Q_BIG_ENDIAN
+/**
+  \brief byte swaps a double, qbswap only takes integers.
+  \param value double as read.
+  \return swapped double.
+*/
+static double swap_double(double value)
+{
+    quint64 bits;
+
+    memcpy(&bits, &value, sizeof(bits));
+    bits = qbswap(bits);
+    memcpy(&value, &bits, sizeof(value));
+
+    return value;
+}
+#endif
+
+/**
+  \brief converts a header read from the file to host order.
+  \param header header, in place.
+*/
+static void from_little_endian(indexedHeader *header)
+{
+#if Q_BYTE_ORDER == Q_BIG_ENDIAN
+    header->version = qbswap(header->version);
+    header->count = qbswap(header->count);
+    header->recordSize = qbswap(header->recordSize);
+    header->stringsOffset = qbswap(header->stringsOffset);
+    header->stringCount = qbswap(header->stringCount);
+    header->headerSize = qbswap(header->headerSize);
+#else
+    Q_UNUSED(header);
+#endif
+}
+
+/**
+  \brief converts a record read from the file to host order.
+  \param rec record, in place.
+*/
+static void from_little_endian(indexedRecord *rec)
+{
+#if Q_BYTE_ORDER == Q_BIG_ENDIAN
+    rec->x = swap_double(rec->x);
+    rec->y = swap_double(rec->y);
+    rec->x2 = swap_double(rec->x2);
+    rec->y2 = swap_double(rec->y2);
+    rec->time = qbswap(rec->time);
+    rec->argI = qbswap(rec->argI);
+    rec->argS = qbswap(rec->argS);
+    rec->type = qbswap(rec->type);
+#else
+    Q_UNUSED(rec);
+#endif
+}
+
+MappedRecording::MappedRecording()
+{
+    records = nullptr;
+    count = 0;
+    recordSize = sizeof(indexedRecord);
+}
+
+MappedRecording::~MappedRecording()
+{
+    file.close();
+}
+
+bool MappedRecording::open(const QString &path)
+{
+    indexedHeader header;
+    const uchar *data;
+    qint64 size;
+
+    file.close();
+    records = nullptr;
+    count = 0;
+    strings.clear();
+    file.setFileName(path);
+    if (!file.open(QIODevice::ReadOnly)) {
+        error = file.errorString();
+        return false;
+    }
+    size = file.size();
+    data = size >= static_cast<qint64>(sizeof(header)) ? file.map(0, size) : nullptr;
+    if (!data) {
+        error = size < static_cast<qint64>(sizeof(header)) ? "not an indexed recording" : file.errorString();
+        file.close();
+        return false;
+    }
+
+    memcpy(&header, data, sizeof(header));
+    from_little_endian(&header);
+    qint64 end = header.headerSize + static_cast<qint64>(header.count) * header.recordSize;
+    if (memcmp(header.magic, rec_indexed_magic, 4) || header.version != rec_indexed_version ||
+            header.count > 0x7fffffff ||
+            header.recordSize < sizeof(indexedRecord) || header.headerSize < sizeof(indexedHeader) ||
+            end > static_cast<qint64>(header.stringsOffset) || static_cast<qint64>(header.stringsOffset) > size) {
+        error = "not an indexed recording";
+        file.close();
+        return false;
+    }
+
+    // the string table is small (key texts), read it once; each string takes at least
+    // its length, so a count the file can't hold is rejected before reserving for it
+    qint64 offset = header.stringsOffset;
+    if (header.stringCount > (size - offset) / 4) {
+        error = "truncated string table";
+        file.close();
+        return false;
+    }
+    strings.reserve(static_cast<int>(header.stringCount) + 1);
+    strings.append(QString());
+    for (quint32 i = 0; i < header.stringCount; i++) {
+        quint32 length = offset + 4 <= size ? qFromLittleEndian<quint32>(data + offset) : 0;
+        if (offset + 4 + length > size) {
+            error = "truncated string table";
+            file.close();
+            strings.clear();
+            return false;
+        }
+        strings.append(QString::fromUtf8(reinterpret_cast<const char*>(data + offset + 4), length));
+        offset += 4 + length;
+    }
+
+    records = data + header.headerSize;
+    count = header.count;
+    recordSize = header.recordSize;
+
+    return true;
+}
+
+QString MappedRecording::errorString() const
+{
+    return error;
+}
+
+indexedRecord MappedRecording::record(int i) const
+{
+    indexedRecord rec;
+
+    memcpy(&rec, records + static_cast<qint64>(i) * recordSize, sizeof(rec));
+    from_little_endian(&rec);
+
+    return rec;
+}
+
+recEvent MappedRecording::at(int i) const
+{
+    indexedRecord rec = record(i);
+    recEvent event;
+
+    event.pos = QPointF(rec.x, rec.y);
+    event.time = rec.time;
+    event.type = static_cast<QEvent::Type>(rec.type);
+    event.argI = rec.argI;
+    event.argS = rec.argS > 0 && rec.argS < strings.size() ? strings.at(rec.argS) : QString();
+    event.pos2 = QPointF(rec.x2, rec.y2);
+
+    return event;
+}
+
+QEvent::Type MappedRecording::typeAt(int i) const
+{
+    return static_cast<QEvent::Type>(record(i).type);
+}
+
+int MappedRecording::timeAt(int i) const
+{
+    return record(i).time;
+}
+
+int MappedRecording::size() const
+{
+    return static_cast<int>(count);
+}
+
+qint64 MappedRecording::memoryUsage() const
+{
+    qint64 bytes = 0;
+
+    foreach (const QString &string, strings) {
+        bytes += string.capacity() * sizeof(QChar);
+    }
+
+    return bytes;
+}
@@ -0,0 +1,131 @@
+/*
+* MIT License
+*
+* Copyright (c) 2018 Antonio Alecrim Jr
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*/
+
+#ifndef MAPPEDRECORDING_H
+#define MAPPEDRECORDING_H
+
+#include <QFile>
+#include <QString>
+#include <QVector>
+#include "recevent.h"
+
+/*
+ * Indexed recording format (version 1), little endian (swapped as read on big
+ * endian hosts), meant to be mapped and played in place:
+ *
+ *   header: indexedHeader (32 bytes)
+ *   records: count fixed width records of recordSize bytes (indexedRecord, 48 bytes
+ *            in version 1), event i is at headerSize + i * recordSize
+ *   strings: at stringsOffset, stringCount times (u32 length, UTF-8 bytes);
+ *            indexedRecord::argS n > 0 is the nth string, 0 is the empty string
+ *
+ * See qtghost3/ghostbin.py (json_to_indexed) to convert JSON or binary recordings.
+ */
+
+const char rec_indexed_magic[] = "QGRX";
+const quint32 rec_indexed_version = 1;
+
+///< \brief indexed recording header.
+struct indexedHeader {
+    char magic[4]; ///< \brief "QGRX".
+    quint32 version; ///< \brief 1.
+    quint32 count; ///< \brief number of events.
+    quint32 recordSize; ///< \brief bytes per record, at least sizeof(indexedRecord).
+    quint64 stringsOffset; ///< \brief offset of the string table.
+    quint32 stringCount; ///< \brief number of strings.
+    quint32 headerSize; ///< \brief offset of the first record.
+};
+
+///< \brief indexed recording event, fixed width.
+struct indexedRecord {
+    double x; ///< \brief pos x.
+    double y; ///< \brief pos y.
+    double x2; ///< \brief pos2 x.
+    double y2; ///< \brief pos2 y.
+    qint32 time; ///< \brief delay since previous event (ms).
+    qint32 argI; ///< \brief integer argument.
+    qint32 argS; ///< \brief string table index, 0 for an empty string.
+    quint16 type; ///< \brief QEvent::Type.
+    quint16 reserved; ///< \brief 0.
+};
+
+/**
+  \brief read only, memory mapped indexed recording.
+
+  Opening only checks the header and reads the (small) string table: records
+  are read in place, so playback can start at once, any event is reached in
+  O(1) and the OS only pages in what is played.
+*/
+class MappedRecording
+{
+    QFile file; ///< \brief mapped file.
+    const uchar *records; ///< \brief first record.
+    quint32 count; ///< \brief number of events.
+    quint32 recordSize; ///< \brief record stride.
+    QVector<QString> strings; ///< \brief string table, strings[0] is the empty string.
+    QString error; ///< \brief see errorString().
+
+    /**
+      \brief reads a record in place.
+    */
+    indexedRecord record(int i) const;
+
+public:
+    MappedRecording();
+    ~MappedRecording();
+    /**
+      \brief maps an indexed recording.
+      \param path recording file.
+      \return false if the file can't be mapped or is not a valid indexed recording.
+    */
+    bool open(const QString &path);
+    /**
+      \brief reason of the last open() failure.
+    */
+    QString errorString() const;
+    /**
+      \brief reads an event.
+      \param i event index, must be lower than size().
+    */
+    recEvent at(int i) const;
+    /**
+      \brief event type, see EventStore::typeAt.
+    */
+    QEvent::Type typeAt(int i) const;
+    /**
+      \brief event delay, see EventStore::timeAt.
+    */
+    int timeAt(int i) const;
+    /**
+      \brief number of events.
+    */
+    int size() const;
+    /**
+      \brief memory held outside the mapping (string table).
+      \return bytes.
+    */
+    qint64 memoryUsage() const;
+};
+
+#endif // MAPPEDRECORDING_H
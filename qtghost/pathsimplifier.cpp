@@ -0,0 +1,159 @@
+/*
+* MIT License
+*
+* Copyright (c) 2018 Antonio Alecrim Jr
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*/
+
+#include "pathsimplifier.h"
+#include <QLineF>
+
+PathSimplifier::PathSimplifier()
+{
+    tolerance = 0;
+    minDistance = 0;
+    minInterval = 0;
+    run.reserve(max_simplify_run);
+    reset();
+}
+
+void PathSimplifier::configure(qreal tol, qreal minDist, int minInt)
+{
+    tolerance = qMax<qreal>(tol, 0);
+    minDistance = qMax<qreal>(minDist, 0);
+    minInterval = qMax(minInt, 0);
+}
+
+bool PathSimplifier::isEnabled() const
+{
+    return tolerance > 0 || minDistance > 0 || minInterval > 0;
+}
+
+void PathSimplifier::reset()
+{
+    clock = 0;
+    lastTime = 0;
+    lastPos = QPointF();
+    anchored = false;
+    run.clear();
+    lastMoveDropped = false;
+}
+
+void PathSimplifier::emitEvent(recEvent event, QVector<recEvent> *out)
+{
+    qint64 at = event.time;
+
+    event.time = static_cast<int>(at - lastTime);
+    lastTime = at;
+    lastPos = event.pos;
+    anchored = true;
+    out->append(event);
+}
+
+void PathSimplifier::add(const recEvent &event, QVector<recEvent> *out)
+{
+    recEvent move = event;
+
+    clock += event.time;
+    move.time = static_cast<int>(clock);
+    if (event.type != QEvent::MouseMove) {
+        flush(out);
+        emitEvent(move, out);
+        return;
+    }
+
+    QPointF prevPos = run.isEmpty() ? lastPos : run.last().pos;
+    qint64 prevTime = run.isEmpty() ? lastTime : run.last().time;
+    lastMove = move;
+    if ((minDistance > 0 && QLineF(prevPos, move.pos).length() < minDistance) ||
+        (minInterval > 0 && clock - prevTime < minInterval)) {
+        lastMoveDropped = true;
+        return;
+    }
+    lastMoveDropped = false;
+    run.append(move);
+    if (run.size() >= max_simplify_run)
+        flush(out);
+}
+
+void PathSimplifier::simplify(int first, int last, QVector<bool> *keep) const
+{
+    // run[first] and run[last] are kept, checks the moves in between
+    while (last - first > 1) {
+        const recEvent &a = run.at(first);
+        const recEvent &b = run.at(last);
+        qreal span = b.time - a.time;
+        qreal worst = -1;
+        int split = -1;
+
+        for (int i = first + 1; i < last; i++) {
+            const recEvent &p = run.at(i);
+            qreal ratio = span > 0 ? (p.time - a.time) / span : 0.5;
+            QPointF at = a.pos + (b.pos - a.pos) * ratio;
+            qreal distance = QLineF(at, p.pos).length();
+            if (distance > worst) {
+                worst = distance;
+                split = i;
+            }
+        }
+        if (worst <= tolerance)
+            return;
+        (*keep)[split] = true;
+        simplify(first, split, keep);
+        first = split;
+    }
+}
+
+void PathSimplifier::flush(QVector<recEvent> *out)
+{
+    if (lastMoveDropped) {
+        run.append(lastMove);
+        lastMoveDropped = false;
+    }
+    if (run.isEmpty())
+        return;
+
+    if (tolerance > 0 && run.size() > 1) {
+        int first = 0;
+        if (anchored) {
+            // the previous emitted event anchors the first segment
+            recEvent anchor = run.first();
+            anchor.pos = lastPos;
+            anchor.time = static_cast<int>(lastTime);
+            run.prepend(anchor);
+            first = 1;
+        }
+
+        QVector<bool> keep(run.size(), false);
+        keep[0] = !anchored;
+        keep[run.size() - 1] = true;
+        simplify(0, run.size() - 1, &keep);
+        for (int i = first; i < run.size(); i++) {
+            if (keep.at(i))
+                emitEvent(run.at(i), out);
+        }
+    }
+    else {
+        foreach (const recEvent &move, run) {
+            emitEvent(move, out);
+        }
+    }
+    run.clear();
+}
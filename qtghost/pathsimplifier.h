@@ -0,0 +1,93 @@
+/*
+* MIT License
+*
+* Copyright (c) 2018 Antonio Alecrim Jr
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*/
+
+#ifndef PATHSIMPLIFIER_H
+#define PATHSIMPLIFIER_H
+
+#include <QVector>
+#include "recevent.h"
+
+const int max_simplify_run = 512; ///< \brief buffered mouse moves before a forced simplification.
+
+/**
+  \brief online simplification of recorded mouse move runs.
+
+  Mouse moves are buffered until any other event arrives (or max_simplify_run
+  moves are pending), then reduced with a min distance/interval filter and a
+  time aware Ramer-Douglas-Peucker: a move is dropped only if it lies within
+  tolerance of the position interpolated, at the same time, between the kept
+  ones (synchronized euclidean distance), so velocity is kept along with the
+  path. The last move before any other event is always kept and every other
+  event passes through untouched. The delays of dropped moves are carried to
+  the next kept event, so the timeline is unchanged. Touch tracks are not
+  simplified (see TouchRecorder for their coalescing).
+*/
+class PathSimplifier
+{
+    qreal tolerance; ///< \brief RDP tolerance in pixels, 0 disables it.
+    qreal minDistance; ///< \brief moves closer than this to the previous kept one are dropped.
+    int minInterval; ///< \brief moves sooner than this (ms) than the previous kept one are dropped.
+
+    qint64 clock; ///< \brief absolute time of the last received event.
+    qint64 lastTime; ///< \brief absolute time of the last emitted event.
+    QPointF lastPos; ///< \brief position of the last emitted event.
+    bool anchored; ///< \brief if an event was emitted, lastPos/lastTime are valid.
+    QVector<recEvent> run; ///< \brief pending moves, time holds absolute time.
+    recEvent lastMove; ///< \brief last received move, kept even if filtered out.
+    bool lastMoveDropped; ///< \brief if lastMove is not in run.
+
+    void simplify(int first, int last, QVector<bool> *keep) const;
+    void emitEvent(recEvent event, QVector<recEvent> *out);
+
+public:
+    PathSimplifier();
+    /**
+      \brief configures the simplification, all zero disables it.
+      \param tol RDP tolerance in pixels.
+      \param minDist minimum distance in pixels between kept moves.
+      \param minInt minimum interval in ms between kept moves.
+    */
+    void configure(qreal tol, qreal minDist, int minInt);
+    /**
+      \brief tells if any simplification is configured.
+    */
+    bool isEnabled() const;
+    /**
+      \brief forgets any pending state, to be called when a recording starts.
+    */
+    void reset();
+    /**
+      \brief feeds one recorded event.
+      \param event event, time is the delay since the previous received event.
+      \param out events to be stored are appended here, time is the delay since the previous stored event.
+    */
+    void add(const recEvent &event, QVector<recEvent> *out);
+    /**
+      \brief emits the pending moves, to be called when a recording stops.
+      \param out events to be stored are appended here.
+    */
+    void flush(QVector<recEvent> *out);
+};
+
+#endif // PATHSIMPLIFIER_H
@@ -0,0 +1,164 @@
+/*
+* MIT License
+*
+* Copyright (c) 2018 Antonio Alecrim Jr
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*/
+
+#include "playback.h"
+#include <algorithm>
+
+playOptions::playOptions()
+{
+    speed = 1;
+    maxGap = -1;
+    fast = false;
+    from = 0;
+    to = -1;
+    checkpoint = 0;
+    forceFrames = false;
+}
+
+int playOptions::delay(int recorded) const
+{
+    if (fast)
+        return 0;
+
+    int scaled = qRound(qMax(recorded, 0) / (speed > 0 ? speed : 1));
+    if (maxGap >= 0 && scaled > maxGap)
+        scaled = maxGap;
+
+    return scaled;
+}
+
+QJsonObject playOptions::toJSON() const
+{
+    QJsonObject obj;
+
+    obj.insert("speed", speed);
+    obj.insert("maxGap", maxGap);
+    obj.insert("fast", fast);
+    obj.insert("from", from);
+    obj.insert("to", to);
+    obj.insert("checkpoint", checkpoint);
+    obj.insert("forceFrames", forceFrames);
+
+    return obj;
+}
+
+QJsonObject playCheckpoint::toJSON() const
+{
+    QJsonObject obj;
+
+    obj.insert("index", index);
+    obj.insert("time", static_cast<double>(time));
+    obj.insert("hash", QString("%1").arg(hash, 16, 16, QChar('0')));
+
+    return obj;
+}
+
+TimeIndex::TimeIndex()
+{
+    count = 0;
+}
+
+void TimeIndex::build(const EventStore &events)
+{
+    qint64 time = 0;
+
+    samples.clear();
+    samples.reserve(events.size() / time_index_stride + 1);
+    for (int i = 0; i < events.size(); i++) {
+        time += events.timeAt(i);
+        if (!(i % time_index_stride))
+            samples.append(time);
+    }
+    count = events.size();
+}
+
+void TimeIndex::clear()
+{
+    samples.clear();
+    count = 0;
+}
+
+bool TimeIndex::covers(const EventStore &events) const
+{
+    return count == events.size();
+}
+
+int TimeIndex::indexAt(const EventStore &events, qint64 ms) const
+{
+    // first sample at or after ms, the event is in the stride before it
+    int sample = static_cast<int>(std::lower_bound(samples.constBegin(), samples.constEnd(), ms) -
+                                  samples.constBegin());
+    if (!sample)
+        return 0;
+
+    int i = (sample - 1) * time_index_stride;
+    qint64 time = samples.at(sample - 1);
+    while (time < ms && ++i < count) {
+        time += events.timeAt(i);
+    }
+
+    return i;
+}
+
+LatenessStats::LatenessStats()
+{
+    reset();
+}
+
+void LatenessStats::reset()
+{
+    samples.clear();
+    sum = 0;
+    worst = 0;
+}
+
+void LatenessStats::add(qint64 us)
+{
+    qint32 sample = static_cast<qint32>(qBound<qint64>(0, us, 0x7fffffff));
+
+    samples.append(sample);
+    sum += sample;
+    worst = qMax(worst, sample);
+}
+
+const QVector<qint32> &LatenessStats::perEvent() const
+{
+    return samples;
+}
+
+QJsonObject LatenessStats::toJSON() const
+{
+    QJsonObject obj;
+    QVector<qint32> sorted = samples;
+
+    std::sort(sorted.begin(), sorted.end());
+    obj.insert("count", sorted.size());
+    obj.insert("mean", sorted.isEmpty() ? 0.0 : static_cast<double>(sum) / sorted.size());
+    obj.insert("max", worst);
+    obj.insert("p50", sorted.isEmpty() ? 0 : sorted.at((sorted.size() - 1) * 50 / 100));
+    obj.insert("p95", sorted.isEmpty() ? 0 : sorted.at((sorted.size() - 1) * 95 / 100));
+    obj.insert("p99", sorted.isEmpty() ? 0 : sorted.at((sorted.size() - 1) * 99 / 100));
+
+    return obj;
+}
@@ -0,0 +1,137 @@
+/*
+* MIT License
+*
+* Copyright (c) 2018 Antonio Alecrim Jr
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*/
+
+#ifndef PLAYBACK_H
+#define PLAYBACK_H
+
+#include <QJsonObject>
+#include <QVector>
+#include "eventstore.h"
+
+const int max_play_batch = 256; ///< \brief overdue events injected at most per wakeup.
+const int time_index_stride = 64; ///< \brief events between two samples of a TimeIndex.
+
+///< \brief how recorded delays are turned into playback delays, and which events are played.
+struct playOptions {
+    qreal speed; ///< \brief speed multiplier, 1 plays at the recorded pace.
+    int maxGap; ///< \brief cap (ms) on any single delay after scaling, negative for no cap.
+    bool fast; ///< \brief ignore recorded delays, play as fast as the event loop allows.
+    int from; ///< \brief index of the first event played.
+    int to; ///< \brief index of the event the play stops at (not played), negative for the end.
+    int checkpoint; ///< \brief a checkpoint (see playCheckpoint) every this many events played, 0 for none.
+    bool forceFrames; ///< \brief request a frame after every injected event, for frame latency (see FrameLatency).
+
+    playOptions();
+    /**
+      \brief playback delay of an event.
+      \param recorded recorded delay (ms) since the previous event.
+      \return delay (ms) to be waited while playing.
+    */
+    int delay(int recorded) const;
+    /**
+      \brief options as JSON, for play reports.
+    */
+    QJsonObject toJSON() const;
+};
+
+///< \brief window state after a given number of events, to find where two plays diverge.
+struct playCheckpoint {
+    int index; ///< \brief events [0, index) were played (or skipped) when the frame was grabbed.
+    qint64 time; ///< \brief play time (ms, pauses excluded) of the grab.
+    quint64 hash; ///< \brief hash of the window contents (see hashImage), 0 without a window.
+
+    /**
+      \brief checkpoint as JSON, the hash as 16 hex digits (doubles can't hold 64 bits).
+    */
+    QJsonObject toJSON() const;
+};
+
+/**
+  \brief recorded time (ms since the recording started) to event index lookups.
+
+  Recordings only hold the delay of each event since the previous one. The index
+  samples the running sum every time_index_stride events, so a lookup is a binary
+  search plus at most time_index_stride delays, for 1/8 byte per event.
+*/
+class TimeIndex
+{
+    QVector<qint64> samples; ///< \brief recorded time of every time_index_stride-th event.
+    int count; ///< \brief number of events indexed.
+
+public:
+    TimeIndex();
+    /**
+      \brief indexes events, done again whenever the recording changed.
+      \param events recording.
+    */
+    void build(const EventStore &events);
+    /**
+      \brief forgets the index, to be called when the recording is replaced.
+    */
+    void clear();
+    /**
+      \brief tells if the index covers every event of the recording.
+      \param events recording.
+    */
+    bool covers(const EventStore &events) const;
+    /**
+      \brief first event recorded at or after a time.
+      \param events indexed recording.
+      \param ms time since the recording started.
+      \return event index, events.size() if the recording ends before ms.
+    */
+    int indexAt(const EventStore &events, qint64 ms) const;
+};
+
+/**
+  \brief per event lateness (injection time - deadline) of a play.
+*/
+class LatenessStats
+{
+    QVector<qint32> samples; ///< \brief lateness (us) of each injected event, in play order.
+    qint64 sum; ///< \brief sum of samples.
+    qint32 worst; ///< \brief largest sample.
+
+public:
+    LatenessStats();
+    /**
+      \brief forgets all samples, to be called when a play starts.
+    */
+    void reset();
+    /**
+      \brief adds the lateness of one injected event.
+      \param us lateness in microseconds.
+    */
+    void add(qint64 us);
+    /**
+      \brief lateness of each injected event.
+    */
+    const QVector<qint32> &perEvent() const;
+    /**
+      \brief summary as JSON: count, mean, max, p50, p95 and p99 (us).
+    */
+    QJsonObject toJSON() const;
+};
+
+#endif // PLAYBACK_H
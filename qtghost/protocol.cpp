@@ -0,0 +1,66 @@
+/*
+* MIT License
+*
+* Copyright (c) 2018 Antonio Alecrim Jr
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*/
+
+#include "protocol.h"
+
+///< \brief v1 response command and its v2 opcode.
+struct commandOpcode {
+    const char *cmd; ///< \brief command without the trailing space.
+    quint8 opcode; ///< \brief opcode.
+};
+
+static const commandOpcode command_opcodes[] = {
+    {"-ok", OP_ACK},
+    {"-j", OP_GET_REC},
+    {"-b", OP_GET_BIN},
+    {"-u", OP_SUBSCRIBE},
+    {"-t", OP_PLAY_REPORT},
+    {"-v", OP_VERSION},
+    {"-c", OP_SCREENSHOT},
+    {"-a", OP_ASSERT},
+    {"-o", OP_ECHO},
+    {"-m", OP_FRAMES},
+    {"-w", OP_WAIT},
+    {"-x", OP_ERROR}
+};
+
+replyTarget::replyTarget(int client, quint32 request)
+{
+    this->client = client;
+    this->request = request;
+}
+
+quint8 opcodeForCommand(const QString &cmd)
+{
+    QString name = cmd.trimmed();
+
+    if (name.endsWith('+'))
+        name.chop(1);
+    for (unsigned i = 0; i < sizeof(command_opcodes) / sizeof(command_opcodes[0]); i++) {
+        if (name == QLatin1String(command_opcodes[i].cmd))
+            return command_opcodes[i].opcode;
+    }
+
+    return OP_ERROR;
+}
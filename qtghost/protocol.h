@@ -0,0 +1,100 @@
+/*
+* MIT License
+*
+* Copyright (c) 2018 Antonio Alecrim Jr
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*/
+
+#ifndef PROTOCOL_H
+#define PROTOCOL_H
+
+#include <QString>
+
+/**
+  \brief protocol v2 opcodes.
+
+  v2 is negotiated by sending rpc_magic as the first bytes of a connection
+  (echoed back). Every packet is a u32 little endian length followed by:
+  requests: u8 opcode, u32 request id, arguments;
+  responses: u32 request id, u8 opcode, u8 flags (see rpcFlags), data.
+  Request ids are chosen by the client and echoed in every response, so
+  requests can be pipelined. Arguments are little endian, optional trailing
+  arguments take their default value.
+*/
+enum ghostOpcode {
+    OP_ACK = 0, ///< \brief response: request done, no data.
+    OP_TEXT = 1, ///< \brief UTF-8 text command (v1 syntax, any option), its responses only.
+    OP_RECORD = 2, ///< \brief start recording, optional u32 rotate (MB, 0 none), UTF-8 capture file (see Qtghost::setCapture); ack.
+    OP_STOP_RECORD = 3, ///< \brief stop recording, ack.
+    OP_PLAY = 4, ///< \brief f64 speed, i32 max gap (ms, -1 none), u8 fast, i32 from, i32 to (-1 end), i32 checkpoint interval (0 none), u8 force frames; ack.
+    OP_STEP = 5, ///< \brief play one event, ack.
+    OP_GET_REC = 6, ///< \brief JSON recording, streamed.
+    OP_SET_REC = 7, ///< \brief JSON recording bytes, ack.
+    OP_GET_BIN = 8, ///< \brief binary recording, streamed.
+    OP_SET_BIN = 9, ///< \brief binary recording bytes, ack.
+    OP_SUBSCRIBE = 10, ///< \brief u8 live only; ack, then JSON event batches with this request id.
+    OP_UNSUBSCRIBE = 11, ///< \brief ack.
+    OP_PLAY_REPORT = 12, ///< \brief u8 per event lateness; JSON report.
+    OP_VERSION = 13, ///< \brief version string.
+    OP_SCREENSHOT = 14, ///< \brief u8 format, i8 level, u8 keyframe, i32 x, y, w, h (region, w 0: whole frame); screenshot.
+    OP_REFERENCE = 15, ///< \brief u32 id, image bytes; ack.
+    OP_ASSERT = 16, ///< \brief u32 id, u8 tolerance, f64 max diff, i8 max hash distance (-1 none), u8 mask, i32 x, y, w, h; JSON verdict.
+    OP_ECHO = 17, ///< \brief bytes, echoed back.
+    OP_FRAMES = 18, ///< \brief u8 action (see frameAction); open: u32 slots, UTF-8 name, ring description; frame: notification; stream, stop: ack.
+    OP_LOAD = 19, ///< \brief UTF-8 path of an indexed recording on the app side, mapped (see Qtghost::mapEvents); ack.
+    OP_SEEK = 20, ///< \brief u8 by time, i64 event index or recorded time (ms), see Qtghost::seek; ack.
+    OP_PAUSE = 21, ///< \brief u8 pause (1) or resume (0); ack.
+    OP_WAIT = 22, ///< \brief u32 timeout (ms, 0 default), UTF-8 condition (see waitCondition::parse); JSON result once it holds or times out.
+    OP_ERROR = 255 ///< \brief response: unknown opcode or invalid arguments, UTF-8 message.
+};
+
+///< \brief OP_FRAMES actions.
+enum frameAction {
+    FRAMES_OPEN = 0, ///< \brief create the shared memory ring.
+    FRAMES_ONE = 1, ///< \brief export the current frame.
+    FRAMES_STREAM = 2, ///< \brief export every rendered frame.
+    FRAMES_STOP = 3 ///< \brief stop streaming.
+};
+
+///< \brief protocol v2 response flags.
+enum rpcFlags {
+    RPC_MORE = 1 ///< \brief more responses to the same request follow.
+};
+
+const int all_clients = -1; ///< \brief reply target: every connected client.
+const char rpc_magic[] = "QGB\x02"; ///< \brief sent first by a client to use protocol v2, echoed back.
+const int rpc_request_head = 5; ///< \brief u8 opcode, u32 request id.
+
+///< \brief where a response goes.
+struct replyTarget {
+    int client; ///< \brief client id, all_clients for every connected client.
+    quint32 request; ///< \brief protocol v2 request id, echoed in the response.
+
+    replyTarget(int client = all_clients, quint32 request = 0);
+};
+
+/**
+  \brief v2 opcode of a v1 response command.
+  \param cmd response command ("-c ", "-j+ "...).
+  \return opcode, OP_ERROR if cmd is unknown.
+*/
+quint8 opcodeForCommand(const QString &cmd);
+
+#endif // PROTOCOL_H
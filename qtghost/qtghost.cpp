@@ -23,31 +23,69 @@
 */
 
 #include "qtghost.h"
-#include <QCommandLineParser>
+#include "recbinary.h"
+#include "recstream.h"
+#include "tilehash.h"
+#include <QMetaObject>
 #include <QMouseEvent>
 #include <QDebug>
 #include <QJsonArray>
 #include <QJsonDocument>
 #include <QJsonObject>
 #include <QQuickWindow>
+#include <QTouchDevice>
 #include <QDir>
 #include <QBuffer>
+#include <QDataStream>
+#include <QtEndian>
 
 Qtghost::Qtghost(QGuiApplication *app, QQmlApplicationEngine *engine)
 {
     keyPressed = false;
     allMouseMoves = false;
     recording = false;
+    lastEventTime = 0;
     stepbystep = false;
 
-    app->installEventFilter(this);
+    // dormant: no event filter until a recording starts (see arm())
     appI = app;
     eng = engine;
     eventsIndex = 0;
     createScreenshotCache = false;
     toWatch = eng->rootObjects()[0];
+    reservePending = false;
+    subscribed = false;
+    liveOnly = false;
+    playDeadline = 0;
+    playEnd = 0;
+    playing = false;
+    paused = false;
+    pausedTime = 0;
 
+    frameExport = nullptr;
+    captureRotate = 0;
+    capture = nullptr;
+    touchDevice = nullptr;
+    playWait = nullptr;
+    waitPausedTime = 0;
+    waitedIndex = -1;
+    objects = new ObjectIndex(this);
+    objects->setRoot(toWatch);
+    frameLatency = new FrameLatency(this);
+    screenshots = new ScreenshotPipeline(this);
+    connect(screenshots, SIGNAL(ready(QString,QByteArray,replyTarget)), SLOT(send_screenshot(QString,QByteArray,replyTarget)));
+
+    playTimer.setTimerType(Qt::PreciseTimer);
     connect(&playTimer,SIGNAL(timeout()),this,SLOT(consume_event()));
+    liveTimer.setSingleShot(true);
+    connect(&liveTimer,SIGNAL(timeout()),this,SLOT(flush_live()));
+    touchTimer.setSingleShot(true);
+    connect(&touchTimer,SIGNAL(timeout()),this,SLOT(flush_touch()));
+}
+
+Qtghost::~Qtghost()
+{
+    delete touchDevice;
 }
 
 QString Qtghost::getVersion()
@@ -58,16 +96,30 @@ QString Qtghost::getVersion()
 void Qtghost::setWatchable(QObject *watch)
 {
     toWatch = watch;
+    objects->setRoot(watch);
+    if (filtered)
+        arm(true);
+}
+
+void Qtghost::arm(bool on)
+{
+    QObject *target = on ? toWatch : nullptr;
+
+    if (filtered == target)
+        return;
+    if (filtered)
+        filtered->removeEventFilter(this);
+    filtered = target;
+    if (filtered)
+        filtered->installEventFilter(this);
 }
 
 bool Qtghost::eventFilter(QObject *watched, QEvent * event)
 {
     QMouseEvent *mouseEvent;
     QDropEvent *genericDragEvent;
-    QTouchEvent *touchEvent;
     QKeyEvent *keyEvent;
     QWheelEvent *wheelEvent;
-    QList<QTouchEvent::TouchPoint> touchList;
 
     if (watched == toWatch) {
         switch(event->type()) {
@@ -75,12 +127,15 @@ bool Qtghost::eventFilter(QObject *watched, QEvent * event)
         case QEvent::MouseButtonRelease:
         case QEvent::MouseButtonDblClick:
             mouseEvent = static_cast<QMouseEvent*>(event);
+            // mouse events synthesized from touch would play twice, the touch events are recorded
+            if (mouseEvent->source() != Qt::MouseEventNotSynthesized)
+                break;
             add_event(mouseEvent->pos(), event->type());
             keyPressed = (event->type() == QEvent::MouseButtonPress);
             break;
         case QEvent::MouseMove:
-            if (keyPressed || allMouseMoves) {
-                mouseEvent = static_cast<QMouseEvent*>(event);
+            mouseEvent = static_cast<QMouseEvent*>(event);
+            if ((keyPressed || allMouseMoves) && mouseEvent->source() == Qt::MouseEventNotSynthesized) {
                 add_event(mouseEvent->pos(), event->type());
             }
             break;
@@ -92,30 +147,18 @@ bool Qtghost::eventFilter(QObject *watched, QEvent * event)
             add_event(genericDragEvent->pos(), event->type());
             break;
         case QTouchEvent::TouchBegin:
-        case QTouchEvent::TouchCancel:
+        case QTouchEvent::TouchUpdate:
         case QTouchEvent::TouchEnd:
-            touchEvent = static_cast<QTouchEvent*>(event);
-            touchList = touchEvent->touchPoints();
-            if (touchList.length()) {
-                // convert into mouse event for simplicity
-                if (event->type() == QTouchEvent::TouchBegin) {
-                    add_event(touchList[0].pos(), QEvent::MouseButtonPress);
-                }
-                else {
-                    add_event(touchList[0].pos(), QEvent::MouseButtonRelease);
-                }
+        case QTouchEvent::TouchCancel:
+            // per point tracks, only the points that changed (see touchtrack.h)
+            if (touchRecorder.add(static_cast<QTouchEvent*>(event), recordClock.elapsed(), &touchRecords)) {
+                if (!touchTimer.isActive())
+                    touchTimer.start(touchRecorder.coalescing());
             }
-            keyPressed = (event->type() == QTouchEvent::TouchBegin);
-            break;
-        case QTouchEvent::TouchUpdate:
-            if (keyPressed) {
-                touchEvent = static_cast<QTouchEvent*>(event);
-                touchList = touchEvent->touchPoints();
-                if (touchList.length()) {
-                    // convert into mouse event for simplicity
-                    add_event(touchList[0].pos(), QEvent::MouseMove);
-                }
+            else {
+                touchTimer.stop();
             }
+            store_touch();
             break;
         case QEvent::KeyPress:
         case QEvent::KeyRelease:
@@ -140,106 +183,417 @@ bool Qtghost::eventFilter(QObject *watched, QEvent * event)
     return false;
 }
 
-void Qtghost::consume_event()
+void Qtghost::inject_event(const recEvent &ev)
 {
     QMouseEvent *eve;
     QDropEvent *genericDragEvent;
     QKeyEvent *keyEvent;
+    QTouchEvent *touchEvent;
     QWheelEvent *wheelEvent;
     Qt::Orientation orientation;
 
-    if (eventsIndex < events.length()) {
-        switch (events[eventsIndex].type) {
-        case QEvent::MouseButtonPress:
-        case QEvent::MouseButtonRelease:
-        case QEvent::MouseButtonDblClick:
-        case QEvent::MouseMove:
-            eve = new QMouseEvent(events[eventsIndex].type,
-                            events[eventsIndex].pos,
-                            Qt::LeftButton, //should get this from event register?
-                            Qt::NoButton,
-                            Qt::NoModifier);
-            appI->sendEvent(toWatch, eve);
-            delete eve;
-            break;
-        case QEvent::DragEnter:
-        case QEvent::DragLeave:
-        case QEvent::DragMove:
-        case QEvent::DragResponse:
-            genericDragEvent = new QDropEvent(events[eventsIndex].pos,
-                                        Qt::MoveAction,
-                                        Q_NULLPTR,
-                                        Qt::LeftButton,
-                                        Qt::NoModifier,
-                                        events[eventsIndex].type);
-            appI->sendEvent(toWatch, genericDragEvent);
-            delete genericDragEvent;
-            break;
-        case QEvent::KeyPress:
-        case QEvent::KeyRelease:
-        case QEvent::ShortcutOverride:
-            keyEvent = new QKeyEvent(events[eventsIndex].type,
-                                     events[eventsIndex].argI,
-                                     Qt::NoModifier,
-                                     events[eventsIndex].argS);
-            appI->sendEvent(toWatch, keyEvent);
-            delete keyEvent;
-            break;
-        case QEvent::Wheel:
-            orientation = (Qt::Orientation)events[eventsIndex].argS.toInt();
-            wheelEvent = new QWheelEvent(events[eventsIndex].pos,
-                                         events[eventsIndex].pos2,
-                                         QPoint(),
-                                         (orientation == Qt::Vertical) ?
-                                             QPoint(0,events[eventsIndex].argI) :
-                                             QPoint(events[eventsIndex].argI, 0),
-                                         events[eventsIndex].argI,
-                                         orientation,
-                                         Qt::NoButton,
-                                         Qt::NoModifier);
-            appI->sendEvent(toWatch, wheelEvent);
-            delete wheelEvent;
-            break;
-        default:
-            break;
-        }
-
-        if (!stepbystep) {
-            if (++eventsIndex < events.length()) { //next event
-                playTimer.start(events[eventsIndex].time);
-            }
-            else {
-                qDebug() << "Qtghost:" << "Ghost mode stopped!";
+    switch (ev.type) {
+    case QEvent::MouseButtonPress:
+    case QEvent::MouseButtonRelease:
+    case QEvent::MouseButtonDblClick:
+    case QEvent::MouseMove:
+        eve = new QMouseEvent(ev.type,
+                        ev.pos,
+                        Qt::LeftButton, //should get this from event register?
+                        Qt::NoButton,
+                        Qt::NoModifier);
+        appI->sendEvent(toWatch, eve);
+        delete eve;
+        break;
+    case QEvent::DragEnter:
+    case QEvent::DragLeave:
+    case QEvent::DragMove:
+    case QEvent::DragResponse:
+        genericDragEvent = new QDropEvent(ev.pos,
+                                    Qt::MoveAction,
+                                    Q_NULLPTR,
+                                    Qt::LeftButton,
+                                    Qt::NoModifier,
+                                    ev.type);
+        appI->sendEvent(toWatch, genericDragEvent);
+        delete genericDragEvent;
+        break;
+    case QEvent::KeyPress:
+    case QEvent::KeyRelease:
+    case QEvent::ShortcutOverride:
+        keyEvent = new QKeyEvent(ev.type,
+                                 ev.argI,
+                                 Qt::NoModifier,
+                                 ev.argS);
+        appI->sendEvent(toWatch, keyEvent);
+        delete keyEvent;
+        break;
+    case QEvent::TouchBegin:
+    case QEvent::TouchUpdate:
+    case QEvent::TouchEnd:
+    case QEvent::TouchCancel:
+        // records of one touch event are batched back into it
+        if (touchPlayer.add(ev)) {
+            if (!touchDevice) {
+                touchDevice = new QTouchDevice;
+                touchDevice->setName("qtghost");
+                touchDevice->setType(QTouchDevice::TouchScreen);
+                touchDevice->setCapabilities(QTouchDevice::Position);
             }
+            touchEvent = touchPlayer.take(touchDevice, qobject_cast<QWindow*>(toWatch),
+                                          static_cast<ulong>(play_time()));
+            appI->sendEvent(toWatch, touchEvent);
+            delete touchEvent;
         }
-        else {
+        break;
+    case QEvent::Wheel:
+        orientation = (Qt::Orientation)ev.argS.toInt();
+        wheelEvent = new QWheelEvent(ev.pos,
+                                     ev.pos2,
+                                     QPoint(),
+                                     (orientation == Qt::Vertical) ?
+                                         QPoint(0,ev.argI) :
+                                         QPoint(ev.argI, 0),
+                                     ev.argI,
+                                     orientation,
+                                     Qt::NoButton,
+                                     Qt::NoModifier);
+        appI->sendEvent(toWatch, wheelEvent);
+        delete wheelEvent;
+        break;
+    default:
+        break;
+    }
+}
+
+void Qtghost::consume_event()
+{
+    if (stepbystep) {
+        if (eventsIndex < events.size()) {
+            recEvent ev = events.at(eventsIndex);
+            inject_event(ev);
             stepbystep = false;
             qDebug() << "Qtghost:" << "step: one event consumed: "
-                     << events[eventsIndex].type << " at "
-                     << events[eventsIndex].pos;
+                     << ev.type << " at "
+                     << ev.pos;
+        }
+        return;
+    }
+
+    if (!playing || paused || playWait)
+        return;
+
+    // inject every event whose deadline (absolute offset from play start) has passed
+    int end = qMin(playEnd, events.size());
+    int batch = playOpts.fast ? 1 : max_play_batch;
+    qint64 now = playClock.nsecsElapsed() / 1000;
+    while (eventsIndex < end && batch-- > 0 && playDeadline * 1000 <= now) {
+        if (events.typeAt(eventsIndex) == wait_event) {
+            // the next events wait for the condition, not for their recorded delays
+            if (!wait_step(events.at(eventsIndex)))
+                return;
+        }
+        else {
+            playLateness.add(now - playDeadline * 1000);
+            inject_event(events.at(eventsIndex));
+            frameLatency->eventInjected();
+        }
+        if (++eventsIndex < end) { //next event
+            playDeadline += playOpts.delay(events.timeAt(eventsIndex));
         }
+        // checkpoints at absolute indexes, so plays of different ranges can be compared
+        if (playOpts.checkpoint > 0 && (!(eventsIndex % playOpts.checkpoint) || eventsIndex == end))
+            take_checkpoint();
+        now = playClock.nsecsElapsed() / 1000;
+    }
+
+    if (eventsIndex < end) {
+        playTimer.start(static_cast<int>(qMax<qint64>(playDeadline - now / 1000, 0)));
+    }
+    else {
+        playing = false;
+        frameLatency->finish();
+        release_objects();
+        playReport = play_report();
+        qDebug() << "Qtghost:" << "Ghost mode stopped! drift:"
+                 << playReport.value("drift").toDouble() << "ms";
+        emit playFinished(playReport);
     }
 }
 
 int Qtghost::play()
 {
-    qDebug() << "Qtghost:" << "Running in ghost mode! size: " << events.length();
-    eventsIndex = 0;
+    qDebug() << "Qtghost:" << "Running in ghost mode! size: " << events.size()
+             << "speed:" << playOpts.speed << "max gap:" << playOpts.maxGap
+             << "fast:" << playOpts.fast << "range:" << playOpts.from << playOpts.to;
+    eventsIndex = qBound(0, playOpts.from, events.size());
+    playEnd = playOpts.to < 0 ? events.size() : qBound(eventsIndex, playOpts.to, events.size());
+    playReport = QJsonObject();
+    playLateness.reset();
+    checkpoints.clear();
+    cancel_wait();
+    playWaits = QJsonArray();
+    touchPlayer.reset();
+    frameLatency->setWindow(qobject_cast<QQuickWindow*>(toWatch));
+    frameLatency->start(playOpts.forceFrames);
+    playDeadline = eventsIndex < playEnd ? playOpts.delay(events.timeAt(eventsIndex)) : 0;
+    playing = true;
+    paused = false;
+    pausedTime = 0;
+    playClock.start();
     playTimer.setSingleShot(true);
-    playTimer.start(10); //just to start with something
+    playTimer.start(static_cast<int>(playDeadline));
 
     return 0;
 }
 
+void Qtghost::setPlayOptions(const playOptions &options)
+{
+    playOpts = options;
+}
+
+qint64 Qtghost::play_time() const
+{
+    if (!playClock.isValid())
+        return 0;
+
+    return playClock.elapsed() - pausedTime - (paused ? pauseClock.elapsed() : 0);
+}
+
+QJsonObject Qtghost::play_report()
+{
+    QJsonObject report = playOpts.toJSON();
+    QJsonArray checkpointList;
+    qint64 actual = play_time();
+    // deadlines are shifted by the pauses once they are over
+    qint64 requested = (eventsIndex < qMin(playEnd, events.size()) ?
+                playDeadline - playOpts.delay(events.timeAt(eventsIndex)) : playDeadline) - pausedTime;
+
+    foreach (const playCheckpoint &checkpoint, checkpoints) {
+        checkpointList.append(checkpoint.toJSON());
+    }
+    report.insert("events", eventsIndex);
+    report.insert("end", playEnd);
+    report.insert("total", events.size());
+    report.insert("paused", paused);
+    report.insert("requested", static_cast<double>(requested));
+    report.insert("actual", static_cast<double>(actual));
+    report.insert("drift", static_cast<double>(actual - requested));
+    report.insert("lateness", playLateness.toJSON());
+    report.insert("frames", frameLatency->toJSON());
+    report.insert("checkpoints", checkpointList);
+    report.insert("waits", playWaits);
+
+    return report;
+}
+
+void Qtghost::take_checkpoint()
+{
+    QQuickWindow *view = qobject_cast<QQuickWindow*>(toWatch);
+    playCheckpoint checkpoint;
+
+    checkpoint.index = eventsIndex;
+    checkpoint.time = play_time();
+    // grabbed right away so the frame matches the events played so far, at the cost of a render
+    checkpoint.hash = view ? hashImage(view->grabWindow().convertToFormat(QImage::Format_RGBA8888)) : 0;
+    checkpoints.append(checkpoint);
+}
+
+bool Qtghost::seek(int index)
+{
+    if (index < 0 || index > events.size())
+        return false;
+
+    eventsIndex = index;
+    cancel_wait();
+    if (playing) {
+        // the skipped (or replayed) events don't count in the requested time
+        qint64 now = playClock.elapsed() - (paused ? pauseClock.elapsed() : 0);
+        playDeadline = now + (index < events.size() ? playOpts.delay(events.timeAt(index)) : 0);
+        if (!paused)
+            playTimer.start(0);
+    }
+    qDebug() << "Qtghost:" << "seek to event" << index << "of" << events.size();
+
+    return true;
+}
+
+bool Qtghost::seekTime(qint64 ms)
+{
+    if (ms < 0)
+        return false;
+    if (!timeIndex.covers(events))
+        timeIndex.build(events);
+
+    return seek(timeIndex.indexAt(events, ms));
+}
+
+bool Qtghost::seek_events(qint64 value, bool byTime)
+{
+    bool ok = byTime ? seekTime(value) :
+                       value <= events.size() && seek(static_cast<int>(value));
+
+    if (!ok)
+        server->sendRec("-x ", QString("seek out of range: %1").arg(value).toUtf8(), replyTo);
+
+    return ok;
+}
+
+bool Qtghost::wait_step(const recEvent &ev)
+{
+    if (waitedIndex == eventsIndex) {
+        waitedIndex = -1;
+        return true;
+    }
+
+    waitCondition condition = waitCondition::parse(ev.argS);
+    if (condition.name.isEmpty()) {
+        qDebug() << "Qtghost:" << "invalid wait step skipped:" << ev.argS;
+        return true;
+    }
+    ConditionWaiter *waiter = new ConditionWaiter(objects, condition, ev.argI, this);
+    if (waiter->start()) {
+        playWaits.append(waiter->toJSON(true));
+        delete waiter;
+        // kept for the next wait steps while playing, see release_objects
+        release_objects();
+        return true;
+    }
+    playWait = waiter;
+    waitPausedTime = pausedTime;
+    connect(waiter, SIGNAL(finished(bool,qint64)), SLOT(play_wait_done(bool,qint64)));
+
+    return false;
+}
+
+void Qtghost::play_wait_done(bool met, qint64 ms)
+{
+    QJsonObject result = playWait->toJSON(met);
+
+    playWaits.append(result);
+    if (!met)
+        qDebug() << "Qtghost:" << "wait step timed out:" << result.value("condition").toString();
+    playWait->deleteLater();
+    playWait = nullptr;
+    release_objects();
+    // waiting isn't play time, as for a pause, but the pauses during the wait are already counted
+    qint64 pauses = pausedTime - waitPausedTime + (paused ? pauseClock.elapsed() : 0);
+    qint64 waited = qMax<qint64>(ms - pauses, 0);
+    pausedTime += waited;
+    playDeadline += waited;
+    waitedIndex = eventsIndex;
+    if (!paused)
+        playTimer.start(0);
+}
+
+void Qtghost::cancel_wait()
+{
+    if (playWait) {
+        playWait->disconnect(this);
+        playWait->deleteLater();
+        playWait = nullptr;
+    }
+    waitedIndex = -1;
+    release_objects();
+}
+
+void Qtghost::release_objects()
+{
+    // the index watches every object of the scene, only while something may look it up
+    if (!playing && !playWait && liveWaits.isEmpty())
+        objects->release();
+}
+
+void Qtghost::wait_for(const QString &spec, int timeoutMs)
+{
+    waitCondition condition = waitCondition::parse(spec);
+
+    if (condition.name.isEmpty()) {
+        server->sendRec("-x ", QString("invalid condition: %1").arg(spec).toUtf8(), replyTo);
+        return;
+    }
+    ConditionWaiter *waiter = new ConditionWaiter(objects, condition, timeoutMs, this);
+    if (waiter->start()) {
+        server->sendRec("-w ", QJsonDocument(waiter->toJSON(true)).toJson(QJsonDocument::Compact), replyTo);
+        delete waiter;
+        release_objects();
+        return;
+    }
+    liveWaits.insert(waiter, replyTo);
+    connect(waiter, SIGNAL(finished(bool,qint64)), SLOT(live_wait_done(bool)));
+}
+
+void Qtghost::live_wait_done(bool met)
+{
+    ConditionWaiter *waiter = qobject_cast<ConditionWaiter*>(sender());
+
+    if (!waiter || !liveWaits.contains(waiter))
+        return;
+    server->sendRec("-w ", QJsonDocument(waiter->toJSON(met)).toJson(QJsonDocument::Compact),
+                    liveWaits.take(waiter));
+    waiter->deleteLater();
+    release_objects();
+}
+
+int Qtghost::add_wait(const QString &condition, int timeoutMs)
+{
+    return add_event(QPointF(), wait_event, qMax(timeoutMs, 0), condition);
+}
+
+void Qtghost::pause()
+{
+    if (!playing || paused)
+        return;
+
+    playTimer.stop();
+    paused = true;
+    pauseClock.start();
+    qDebug() << "Qtghost:" << "play paused at event" << eventsIndex;
+}
+
+void Qtghost::resume()
+{
+    if (!paused)
+        return;
+
+    qint64 pause = pauseClock.elapsed();
+    pausedTime += pause;
+    playDeadline += pause;
+    paused = false;
+    playTimer.start(0);
+    qDebug() << "Qtghost:" << "play resumed at event" << eventsIndex;
+}
+
+QJsonObject Qtghost::getPlayReport()
+{
+    if (!playReport.isEmpty()) {
+        // the frame of the last events is swapped after the play ended
+        playReport.insert("frames", frameLatency->toJSON());
+        return playReport;
+    }
+
+    return play_report();
+}
+
 int Qtghost::step()
 {
-    stepbystep = true;
-    if (eventsIndex <= events.length()) {
-        consume_event();
-        eventsIndex++;
+    // same [from, to) range and checkpoints as play()
+    int start = qBound(0, playOpts.from, events.size());
+    int end = playOpts.to < 0 ? events.size() : qBound(start, playOpts.to, events.size());
+
+    if (eventsIndex >= end) {
+        eventsIndex = start;
+        checkpoints.clear();
+        return 0;
     }
-    else {
-        eventsIndex = 0;
+    stepbystep = true;
+    consume_event();
+    eventsIndex++;
+    if (playOpts.checkpoint > 0 && (!(eventsIndex % playOpts.checkpoint) || eventsIndex == end)) {
+        take_checkpoint();
+        // the report of a finished play would hide it
+        if (!playing)
+            playReport = QJsonObject();
     }
 
     return 0;
@@ -247,9 +601,24 @@ int Qtghost::step()
 
 int Qtghost::record_start()
 {
+    stop_capture();
     events.clear();
+    timeIndex.clear();
+    events.reserve(event_chunk_size);
+    simplifier.reset();
+    touchRecorder.reset();
+    if (!capturePath.isEmpty()) {
+        capture = new CaptureWriter(capturePath, captureRotate, this);
+        if (!capture->begin()) {
+            delete capture;
+            capture = nullptr;
+            qDebug() << "Qtghost:" << "capture failed, recording in memory";
+        }
+    }
     recording = true;
-    time.start();
+    arm(true);
+    recordClock.start();
+    lastEventTime = 0;
     qDebug() << "Qtghost:" << "Creating a ghost!";
 
     return 0;
@@ -257,38 +626,316 @@ int Qtghost::record_start()
 
 int Qtghost::record_stop()
 {
+    touchTimer.stop();
+    flush_touch();
+    if (recording && simplifier.isEnabled()) {
+        simplifier.flush(&simplified);
+        store_simplified();
+    }
     recording = false;
+    arm(false);
+    stop_capture();
     qDebug() << "Qtghost:" << "Ghost creation done!";
 
     return 0;
 }
 
-int Qtghost::add_event(QPointF p, QEvent::Type t, int argI, QString argS, QPointF p2)
+void Qtghost::stop_capture()
+{
+    if (!capture)
+        return;
+    capture->stop();
+    qDebug() << "Qtghost:" << "capture done:" << capture->toJSON();
+    delete capture;
+    capture = nullptr;
+}
+
+void Qtghost::setCapture(const QString &path, qint64 rotateBytes)
+{
+    capturePath = path;
+    captureRotate = qMax<qint64>(rotateBytes, 0);
+}
+
+int Qtghost::add_event(QPointF p, QEvent::Type t, int argI, const QString &argS, QPointF p2)
 {
     if (recording) {
+        qint64 now = recordClock.elapsed();
+        int delay = static_cast<int>(now - lastEventTime);
+        lastEventTime = now;
+        if (capture) {
+            // GUI thread cost: a fixed size copy, encoding and I/O are on the writer thread
+            capture->push(p, delay, t, argI, argS, p2);
+        }
+        else if (simplifier.isEnabled()) {
+            recEvent rec;
+            rec.pos = p;
+            rec.time = delay;
+            rec.type = t;
+            rec.argI = argI;
+            rec.argS = argS;
+            rec.pos2 = p2;
+            simplifier.add(rec, &simplified);
+            store_simplified();
+        }
+        else {
+            store_event(p, delay, t, argI, argS, p2);
+        }
+    }
+
+    return 0;
+}
+
+void Qtghost::store_event(QPointF p, int delay, QEvent::Type t, int argI, const QString &argS, QPointF p2)
+{
+    if (!(subscribed && liveOnly)) {
+        events.append(p, delay, t, argI, argS, p2);
+        if (!reservePending && events.needsReserve()) {
+            // keep allocations out of event delivery, one queued call per chunk
+            reservePending = true;
+            QMetaObject::invokeMethod(this, "reserve_events", Qt::QueuedConnection);
+        }
+    }
+    if (subscribed) {
         recEvent rec;
         rec.pos = p;
-        rec.time = time.restart();
+        rec.time = delay;
         rec.type = t;
         rec.argI = argI;
         rec.argS = argS;
         rec.pos2 = p2;
-        events.append(rec);
+        publish_event(rec);
     }
+}
 
-    return 0;
+void Qtghost::store_simplified()
+{
+    foreach (const recEvent &rec, simplified) {
+        store_event(rec.pos, rec.time, rec.type, rec.argI, rec.argS, rec.pos2);
+    }
+    simplified.clear();
+}
+
+void Qtghost::store_touch()
+{
+    if (recording && !touchRecords.isEmpty()) {
+        // touch records bypass the path simplifier, its pending moves go first
+        if (!capture && simplifier.isEnabled()) {
+            simplifier.flush(&simplified);
+            store_simplified();
+        }
+        foreach (const recEvent &rec, touchRecords) {
+            // coalesced moves are observed before the timer stores them, other events may be stored in between
+            qint64 at = qMax<qint64>(rec.time, lastEventTime);
+            int delay = static_cast<int>(at - lastEventTime);
+            lastEventTime = at;
+            if (capture)
+                capture->push(rec.pos, delay, rec.type, rec.argI, QString(), QPointF());
+            else
+                store_event(rec.pos, delay, rec.type, rec.argI, QString(), QPointF());
+        }
+    }
+    touchRecords.clear();
+}
+
+void Qtghost::flush_touch()
+{
+    touchRecorder.flush(&touchRecords);
+    store_touch();
+}
+
+void Qtghost::setTouchCoalescing(int ms)
+{
+    flush_touch();
+    touchRecorder.setCoalescing(ms);
+    qDebug() << "Qtghost:" << "touch coalescing:" << touchRecorder.coalescing() << "ms";
+}
+
+void Qtghost::setPathSimplification(qreal tolerance, qreal minDistance, int minInterval)
+{
+    if (recording && simplifier.isEnabled()) {
+        simplifier.flush(&simplified);
+        store_simplified();
+    }
+    simplifier.configure(tolerance, minDistance, minInterval);
+    simplifier.reset();
+    qDebug() << "Qtghost:" << "path simplification tolerance:" << tolerance
+             << "min distance:" << minDistance << "min interval:" << minInterval;
+}
+
+void Qtghost::reserve_events()
+{
+    reservePending = false;
+    if (events.needsReserve()) {
+        events.reserve(event_chunk_size);
+    }
+}
+
+void Qtghost::publish_event(const recEvent &rec)
+{
+    liveBatch.append(recEventToJSON(rec));
+    if (liveBatch.size() >= live_batch_size) {
+        flush_live();
+    }
+    else if (!liveTimer.isActive()) {
+        liveTimer.start(live_flush_interval);
+    }
+}
+
+void Qtghost::flush_live()
+{
+    liveTimer.stop();
+    if (liveBatch.isEmpty())
+        return;
+
+    QJsonObject mainObj;
+    mainObj.insert("events", liveBatch);
+    QByteArray data = QJsonDocument(mainObj).toJson(QJsonDocument::Compact);
+    foreach (const liveSubscriber &subscriber, subscribers) {
+        server->sendRec("-u ", data, subscriber.to);
+    }
+    liveBatch = QJsonArray();
+}
+
+void Qtghost::setSubscribed(bool flag, bool keep)
+{
+    if (!flag) {
+        flush_live();
+        subscribers.remove(replyTo.client);
+    }
+    else {
+        liveSubscriber subscriber = {replyTo, !keep};
+        subscribers.insert(replyTo.client, subscriber);
+    }
+    subscribed = !subscribers.isEmpty();
+    // events are kept as long as one subscriber (or nobody) wants them
+    liveOnly = subscribed;
+    foreach (const liveSubscriber &subscriber, subscribers) {
+        liveOnly = liveOnly && subscriber.liveOnly;
+    }
+    qDebug() << "Qtghost:" << "client" << replyTo.client << (flag ? "subscribed" : "unsubscribed")
+             << (flag && !keep ? "(live only)" : "");
 }
 
 int Qtghost::init(quint16 port)
 {
+    // an orchestrator running several instances assigns their endpoints through the environment
+    if (qEnvironmentVariableIsSet("QTGHOST_SOCKET"))
+        return init(QString::fromLocal8Bit(qgetenv("QTGHOST_SOCKET")));
+    if (qEnvironmentVariableIsSet("QTGHOST_PORT"))
+        port = static_cast<quint16>(qEnvironmentVariableIntValue("QTGHOST_PORT"));
+
     server = new Server(this, port);
-    connect(server, SIGNAL(dataReceived(QByteArray)), SLOT(processCMD(QByteArray)));
+    connect_server();
+
+    return 0;
+}
+
+int Qtghost::init(const QString &localName)
+{
+    QString name = localName;
+
+    if (qEnvironmentVariableIsSet("QTGHOST_SOCKET"))
+        name = QString::fromLocal8Bit(qgetenv("QTGHOST_SOCKET"));
+    else if (qEnvironmentVariableIsSet("QTGHOST_PORT"))
+        return init(static_cast<quint16>(qEnvironmentVariableIntValue("QTGHOST_PORT")));
+
+    server = new Server(this, name);
+    connect_server();
 
     return 0;
 }
 
-void Qtghost::processCMD(QByteArray data)
+void Qtghost::connect_server()
+{
+    connect(server, SIGNAL(dataReceived(QByteArray,int)), SLOT(processCMD(QByteArray,int)));
+    connect(server, SIGNAL(requestReceived(QByteArray,int)), SLOT(processRequest(QByteArray,int)));
+    connect(server, SIGNAL(clientDisconnected(int)), SLOT(client_disconnected(int)));
+}
+
+void Qtghost::send_screenshot(QString cmd, QByteArray data, replyTarget to)
+{
+    server->sendRec(cmd, data, to);
+}
+
+void Qtghost::send_frame(quint64 seq, int slot, int width, int height)
+{
+    QJsonObject frame;
+
+    frame.insert("seq", static_cast<double>(seq));
+    frame.insert("slot", slot);
+    frame.insert("width", width);
+    frame.insert("height", height);
+    server->sendRec("-m ", QJsonDocument(frame).toJson(QJsonDocument::Compact), frameTarget);
+}
+
+void Qtghost::client_disconnected(int client)
+{
+    if (frameExport && frameTarget.client == client)
+        frameExport->setStreaming(false);
+    if (subscribers.contains(client)) {
+        replyTarget previous = replyTo;
+        replyTo = replyTarget(client);
+        setSubscribed(false);
+        replyTo = previous;
+    }
+    screenshots->forget(client);
+    foreach (ConditionWaiter *waiter, liveWaits.keys()) {
+        if (liveWaits.value(waiter).client == client) {
+            liveWaits.remove(waiter);
+            waiter->deleteLater();
+        }
+    }
+    release_objects();
+}
+
+void Qtghost::setReference(int id, const QImage &image)
+{
+    if (image.isNull()) {
+        references.remove(id);
+        return;
+    }
+    references.insert(id, image.convertToFormat(QImage::Format_RGBA8888));
+}
+
+void Qtghost::processCMD(QByteArray data, int client)
 {
+    // replies of this command go back to its client
+    replyTo = replyTarget(client);
+    process_data(data);
+    replyTo = replyTarget();
+}
+
+void Qtghost::process_data(const QByteArray &data)
+{
+    // binary payloads can't go through QString
+    if (data.startsWith("-k ")) {
+        if (!setBinaryEvents(data.mid(3))) {
+            qDebug() << "Qtghost:" << "invalid binary recording received";
+        }
+        return;
+    }
+    // "-o <bytes>", echoed back as is (transport benchmarks)
+    if (data.startsWith("-o ")) {
+        server->sendRec("-o ", data.mid(3), replyTo);
+        return;
+    }
+    // "-n <id> <image file bytes>", reference image for visual assertions
+    if (data.startsWith("-n ")) {
+        int space = data.indexOf(' ', 3);
+        bool ok = false;
+        int id = data.mid(3, space - 3).toInt(&ok);
+        if (space < 0 || !ok) {
+            qDebug() << "Qtghost:" << "invalid reference image command";
+            return;
+        }
+        QImage image = QImage::fromData(data.mid(space + 1));
+        if (image.isNull() && space + 1 < data.size()) {
+            qDebug() << "Qtghost:" << "invalid reference image received:" << id;
+            return;
+        }
+        setReference(id, image);
+        return;
+    }
     processCMD(QString(data));
 }
 
@@ -296,72 +943,114 @@ void Qtghost::processCMD(QString cmd)
 {
     if (!cmd.startsWith("-j") && !cmd.startsWith("--JSON")) {
         QStringList arguments = QString("Qtghost "+cmd).split(" ");
-        QCommandLineParser parser;
-        parser.setApplicationDescription("Qtghost");
-        //parser.addHelpOption();
-        //parser.addVersionOption();
-        // A boolean option with multiple names (-r, --record)
-        QCommandLineOption recordOption(QStringList() << "r" << "record",
-                QCoreApplication::translate("record", "Start recording."));
-        parser.addOption(recordOption);
-        // A boolean option with multiple names (-s, --stop-recording)
-        QCommandLineOption stopRecordOption(QStringList() << "s" << "stop-recording",
-                QCoreApplication::translate("stop", "Stop recording."));
-        parser.addOption(stopRecordOption);
-        // A boolean option with multiple names (-p, --play)
-        QCommandLineOption playOption(QStringList() << "p" << "play",
-                QCoreApplication::translate("play", "Start playing."));
-        parser.addOption(playOption);
-        // A boolean option with multiple names (-e, --step)
-        QCommandLineOption stepOption(QStringList() << "e" << "step",
-                QCoreApplication::translate("step", "Pay one step."));
-        parser.addOption(stepOption);
-        // A boolean option with multiple names (-g, --get-rec)
-        QCommandLineOption getRecOption(QStringList() << "g" << "get-rec",
-                QCoreApplication::translate("get", "Get recorded ghost."));
-        parser.addOption(getRecOption);
-        QCommandLineOption getVerOption(QStringList() << "v" << "version",
-                QCoreApplication::translate("version", "send version."));
-        parser.addOption(getVerOption);
-        QCommandLineOption getScrOption(QStringList() << "c" << "screenshot",
-                QCoreApplication::translate("screenshot", "take screenshot."));
-        parser.addOption(getScrOption);
-
-        // Process the actual command line arguments given by the user
-        parser.process(arguments);
-        if (parser.isSet(recordOption))
+        QCommandLineParser &parser = commandLine.parser;
+        const CommandLine &opt = commandLine;
+
+        // Process the actual command line arguments given by the user,
+        // a bad one (unknown option, missing value) is the client's error, not a reason to exit the app
+        if (!parser.parse(arguments)) {
+            server->sendRec("-x ", parser.errorText().toUtf8(), replyTo);
+            return;
+        }
+        if (parser.isSet(opt.simplifyOption) || parser.isSet(opt.minDistanceOption) ||
+                parser.isSet(opt.minIntervalOption)) {
+            setPathSimplification(parser.value(opt.simplifyOption).toDouble(),
+                                  parser.value(opt.minDistanceOption).toDouble(),
+                                  parser.value(opt.minIntervalOption).toInt());
+        }
+        if (parser.isSet(opt.touchCoalesceOption))
+            setTouchCoalescing(parser.value(opt.touchCoalesceOption).toInt());
+        if (parser.isSet(opt.recordOption)) {
+            setCapture(parser.value(opt.captureOption),
+                       static_cast<qint64>(parser.value(opt.rotateOption).toDouble() * 1024 * 1024));
             record_start();
-        if (parser.isSet(stopRecordOption))
+        }
+        if (parser.isSet(opt.waitStepOption))
+            add_wait(parser.value(opt.waitStepOption), parser.value(opt.waitTimeoutOption).toInt());
+        if (parser.isSet(opt.stopRecordOption))
             record_stop();
-        if (parser.isSet(playOption))
+        if (parser.isSet(opt.loadOption))
+            load_events(parser.value(opt.loadOption));
+        if (parser.isSet(opt.playOption)) {
+            playOptions options;
+            if (parser.isSet(opt.speedOption))
+                options.speed = parser.value(opt.speedOption).toDouble();
+            if (parser.isSet(opt.maxGapOption))
+                options.maxGap = parser.value(opt.maxGapOption).toInt();
+            options.fast = parser.isSet(opt.fastOption);
+            if (parser.isSet(opt.fromOption))
+                options.from = parser.value(opt.fromOption).toInt();
+            if (parser.isSet(opt.toOption))
+                options.to = parser.value(opt.toOption).toInt();
+            options.checkpoint = parser.value(opt.checkpointOption).toInt();
+            options.forceFrames = parser.isSet(opt.forceFramesOption);
+            setPlayOptions(options);
             play();
-        if (parser.isSet(stepOption))
+        }
+        if (parser.isSet(opt.pauseOption))
+            pause();
+        if (parser.isSet(opt.seekOption))
+            seek_events(parser.value(opt.seekOption).toLongLong(), false);
+        if (parser.isSet(opt.seekTimeOption))
+            seek_events(parser.value(opt.seekTimeOption).toLongLong(), true);
+        if (parser.isSet(opt.resumeOption))
+            resume();
+        if (parser.isSet(opt.waitOption))
+            wait_for(parser.value(opt.waitOption), parser.value(opt.waitTimeoutOption).toInt());
+        if (parser.isSet(opt.playReportOption))
+            send_play_report(parser.isSet(opt.latenessOption));
+        if (parser.isSet(opt.stepOption))
             step();
-        if (parser.isSet(getRecOption))
-            server->sendRec("-j ", getJSONEvents().toJson());
-        if (parser.isSet(getVerOption))
-            server->sendRec("-v ", QString(VERSION).toUtf8());
-        if (parser.isSet(getScrOption)) {
-            QQuickWindow *view = qobject_cast<QQuickWindow*>(toWatch);
-            QString name = "qtghost_scr.png";
-            QImage img = view->grabWindow();
-            if (createScreenshotCache) {
-                QString path = QDir::tempPath();
-                QFile::remove(path+"/"+name);
-                if (img.save(path+"/_tmp_"+name)) {
-                    QFile::rename(path+"/_tmp_"+name, path+"/"+name);
-                    qDebug() << "Qtghost: new screenshot at: " << path+"/"+name;
-                }
-                else {
-                    qDebug() << "Qtghost: failed to create a file at: " << path+"/"+name;
-                }
-            }
-            QByteArray ba;
-            QBuffer buffer(&ba);
-            buffer.open(QIODevice::WriteOnly);
-            img.save(&buffer, "PNG");
-            server->sendRec("-c ", ba);
+        if (parser.isSet(opt.getRecOption))
+            server->sendStream("-j ", new JSONEventStream(events), replyTo);
+        if (parser.isSet(opt.getBinOption))
+            server->sendStream("-b ", new BinaryEventStream(events), replyTo);
+        if (parser.isSet(opt.subscribeOption))
+            setSubscribed(true, !parser.isSet(opt.liveOnlyOption));
+        if (parser.isSet(opt.unsubscribeOption))
+            setSubscribed(false);
+        if (parser.isSet(opt.getVerOption))
+            server->sendRec("-v ", QString(VERSION).toUtf8(), replyTo);
+        if (parser.isSet(opt.getScrOption)) {
+            screenshotRequest request;
+            QString format = parser.value(opt.scrFormatOption);
+            if (format == "raw")
+                request.format = SCR_RAW;
+            else if (format == "fast")
+                request.format = SCR_FAST;
+            else if (format == "diff")
+                request.format = SCR_DIFF;
+            request.keyframe = parser.isSet(opt.scrKeyframeOption);
+            if (parser.isSet(opt.scrLevelOption))
+                request.level = parser.value(opt.scrLevelOption).toInt();
+            if (parser.isSet(opt.scrRegionOption))
+                request.region = ScreenshotPipeline::parseRegion(parser.value(opt.scrRegionOption));
+            take_screenshot(request);
+        }
+        if (parser.isSet(opt.assertOption)) {
+            compareRequest request;
+            request.reference = parser.value(opt.assertOption).toInt();
+            if (parser.isSet(opt.scrRegionOption))
+                request.region = ScreenshotPipeline::parseRegion(parser.value(opt.scrRegionOption));
+            if (parser.isSet(opt.toleranceOption))
+                request.tolerance = parser.value(opt.toleranceOption).toInt();
+            if (parser.isSet(opt.maxDiffOption))
+                request.maxDiff = parser.value(opt.maxDiffOption).toDouble();
+            if (parser.isSet(opt.phashOption))
+                request.maxHashDistance = parser.value(opt.phashOption).toInt();
+            request.mask = parser.isSet(opt.maskOption);
+            assert_frame(request);
         }
+        if (parser.isSet(opt.shmOption)) {
+            open_frame_export(parser.value(opt.shmOption), parser.isSet(opt.shmSlotsOption) ?
+                                  parser.value(opt.shmSlotsOption).toInt() : frame_export_slots);
+        }
+        if (parser.isSet(opt.shmFrameOption))
+            export_frames(FRAMES_ONE);
+        if (parser.isSet(opt.shmStreamOption))
+            export_frames(FRAMES_STREAM);
+        if (parser.isSet(opt.shmStopOption))
+            export_frames(FRAMES_STOP);
     }
     else {
         bool isJSON = false;
@@ -380,20 +1069,294 @@ void Qtghost::processCMD(QString cmd)
     }
 }
 
+void Qtghost::take_screenshot(screenshotRequest request)
+{
+    QQuickWindow *view = qobject_cast<QQuickWindow*>(toWatch);
+
+    if (createScreenshotCache)
+        request.cachePath = QDir::tempPath()+"/qtghost_scr.png";
+    // only the grab runs on the GUI thread, the encoding is sent when ready
+    screenshots->encode(view->grabWindow(), request, replyTo);
+}
+
+void Qtghost::assert_frame(const compareRequest &request)
+{
+    QQuickWindow *view = qobject_cast<QQuickWindow*>(toWatch);
+
+    // a missing reference fails with a size mismatch
+    screenshots->compare(view->grabWindow(), references.value(request.reference), request, replyTo);
+}
+
+void Qtghost::open_frame_export(const QString &name, int count)
+{
+    QJsonObject description;
+
+    if (!frameExport) {
+        frameExport = new FrameExport(qobject_cast<QQuickWindow*>(toWatch), this);
+        connect(frameExport, SIGNAL(frameReady(quint64,int,int,int)), SLOT(send_frame(quint64,int,int,int)));
+    }
+    frameTarget = replyTo;
+    if (frameExport->open(name, count))
+        description = frameExport->describe();
+    else
+        description.insert("error", QString("unable to create the frame export file"));
+    server->sendRec("-m ", QJsonDocument(description).toJson(QJsonDocument::Compact), replyTo);
+}
+
+bool Qtghost::export_frames(frameAction action)
+{
+    if (!frameExport || !frameExport->isOpen()) {
+        server->sendRec("-x ", "frame export not open", replyTo);
+        return false;
+    }
+    frameTarget = replyTo;
+    if (action == FRAMES_ONE)
+        frameExport->publish(qobject_cast<QQuickWindow*>(toWatch)->grabWindow());
+    else
+        frameExport->setStreaming(action == FRAMES_STREAM);
+
+    return true;
+}
+
+void Qtghost::send_play_report(bool perEvent)
+{
+    QJsonObject report = getPlayReport();
+
+    if (perEvent) {
+        QJsonArray lateness;
+        foreach (qint32 us, playLateness.perEvent()) {
+            lateness.append(us);
+        }
+        report.insert("perEvent", lateness);
+    }
+    server->sendRec("-t ", QJsonDocument(report).toJson(QJsonDocument::Compact), replyTo);
+}
+
+/**
+  \brief reads an optional trailing argument, value is left untouched at the end of the arguments.
+  \param args arguments.
+  \param value argument, output.
+*/
+template <typename T> static void readArg(QDataStream &args, T *value)
+{
+    if (!args.atEnd())
+        args >> *value;
+}
+
+/**
+  \brief reads an optional x, y, w, h region, w 0 means no region.
+  \param args arguments.
+  \return region, null if not set.
+*/
+static QRect readRegion(QDataStream &args)
+{
+    qint32 x = 0, y = 0, w = 0, h = 0;
+
+    readArg(args, &x);
+    readArg(args, &y);
+    readArg(args, &w);
+    readArg(args, &h);
+
+    return w > 0 && h > 0 ? QRect(x, y, w, h) : QRect();
+}
+
+void Qtghost::processRequest(QByteArray data, int client)
+{
+    if (data.size() < rpc_request_head) {
+        server->sendRec("-x ", "truncated request", replyTarget(client));
+        return;
+    }
+
+    quint8 opcode = static_cast<quint8>(data.at(0));
+    QByteArray payload = data.mid(rpc_request_head);
+    QDataStream args(payload);
+    args.setByteOrder(QDataStream::LittleEndian);
+    bool ack = true;
+
+    replyTo = replyTarget(client, qFromLittleEndian<quint32>(reinterpret_cast<const uchar*>(data.constData() + 1)));
+    switch (opcode) {
+    case OP_TEXT:
+        // v1 command, only its own responses
+        process_data(payload);
+        ack = false;
+        break;
+    case OP_RECORD: {
+        quint32 rotate = 0;
+        readArg(args, &rotate);
+        setCapture(QString::fromUtf8(payload.mid(4)), static_cast<qint64>(rotate) * 1024 * 1024);
+        record_start();
+        break;
+    }
+    case OP_STOP_RECORD:
+        record_stop();
+        break;
+    case OP_PLAY: {
+        playOptions options;
+        quint8 fast = 0;
+        quint8 forceFrames = 0;
+        readArg(args, &options.speed);
+        readArg(args, &options.maxGap);
+        readArg(args, &fast);
+        readArg(args, &options.from);
+        readArg(args, &options.to);
+        readArg(args, &options.checkpoint);
+        readArg(args, &forceFrames);
+        options.fast = fast;
+        options.forceFrames = forceFrames;
+        setPlayOptions(options);
+        play();
+        break;
+    }
+    case OP_STEP:
+        step();
+        break;
+    case OP_GET_REC:
+        server->sendStream("-j ", new JSONEventStream(events), replyTo);
+        ack = false;
+        break;
+    case OP_SET_REC:
+        setJSONEvents(QJsonDocument::fromJson(payload));
+        break;
+    case OP_GET_BIN:
+        server->sendStream("-b ", new BinaryEventStream(events), replyTo);
+        ack = false;
+        break;
+    case OP_SET_BIN:
+        if (!setBinaryEvents(payload)) {
+            server->sendRec("-x ", "invalid binary recording", replyTo);
+            ack = false;
+        }
+        break;
+    case OP_SUBSCRIBE: {
+        quint8 live = 0;
+        readArg(args, &live);
+        setSubscribed(true, !live);
+        break;
+    }
+    case OP_UNSUBSCRIBE:
+        setSubscribed(false);
+        break;
+    case OP_PLAY_REPORT: {
+        quint8 perEvent = 0;
+        readArg(args, &perEvent);
+        send_play_report(perEvent);
+        ack = false;
+        break;
+    }
+    case OP_VERSION:
+        server->sendRec("-v ", QString(VERSION).toUtf8(), replyTo);
+        ack = false;
+        break;
+    case OP_SCREENSHOT: {
+        screenshotRequest request;
+        quint8 format = SCR_PNG, keyframe = 0;
+        qint8 level = -1;
+        readArg(args, &format);
+        readArg(args, &level);
+        readArg(args, &keyframe);
+        request.format = static_cast<screenshotFormat>(qMin<int>(format, SCR_DIFF));
+        request.level = level;
+        request.keyframe = keyframe;
+        request.region = readRegion(args);
+        take_screenshot(request);
+        ack = false;
+        break;
+    }
+    case OP_REFERENCE: {
+        quint32 id = 0;
+        readArg(args, &id);
+        QImage image = QImage::fromData(payload.mid(4));
+        if (image.isNull() && payload.size() > 4) {
+            server->sendRec("-x ", "invalid reference image", replyTo);
+            ack = false;
+            break;
+        }
+        setReference(static_cast<int>(id), image);
+        break;
+    }
+    case OP_ASSERT: {
+        compareRequest request;
+        quint32 id = 0;
+        quint8 tolerance = 0, mask = 0;
+        qint8 hashDistance = -1;
+        readArg(args, &id);
+        readArg(args, &tolerance);
+        readArg(args, &request.maxDiff);
+        readArg(args, &hashDistance);
+        readArg(args, &mask);
+        request.reference = static_cast<int>(id);
+        request.tolerance = tolerance;
+        request.maxHashDistance = hashDistance;
+        request.mask = mask;
+        request.region = readRegion(args);
+        assert_frame(request);
+        ack = false;
+        break;
+    }
+    case OP_ECHO:
+        server->sendRec("-o ", payload, replyTo);
+        ack = false;
+        break;
+    case OP_LOAD:
+        ack = load_events(QString::fromUtf8(payload));
+        break;
+    case OP_WAIT: {
+        quint32 timeout = 0;
+        readArg(args, &timeout);
+        wait_for(QString::fromUtf8(payload.mid(4)), static_cast<int>(timeout));
+        ack = false;
+        break;
+    }
+    case OP_SEEK: {
+        quint8 byTime = 0;
+        qint64 value = 0;
+        readArg(args, &byTime);
+        readArg(args, &value);
+        ack = seek_events(value, byTime);
+        break;
+    }
+    case OP_PAUSE: {
+        quint8 on = 1;
+        readArg(args, &on);
+        if (on)
+            pause();
+        else
+            resume();
+        break;
+    }
+    case OP_FRAMES: {
+        quint8 action = FRAMES_OPEN;
+        quint32 count = frame_export_slots;
+        readArg(args, &action);
+        if (action == FRAMES_OPEN) {
+            readArg(args, &count);
+            open_frame_export(QString::fromUtf8(payload.mid(5)), static_cast<int>(count));
+            ack = false;
+        }
+        else {
+            // a single frame is answered by its notification
+            ack = export_frames(static_cast<frameAction>(action)) && action != FRAMES_ONE;
+        }
+        break;
+    }
+    default:
+        server->sendRec("-x ", "unknown opcode", replyTo);
+        ack = false;
+        break;
+    }
+    if (ack)
+        server->sendRec("-ok ", QByteArray(), replyTo);
+    replyTo = replyTarget();
+}
+
 
 QJsonDocument Qtghost::getJSONEvents()
 {
     QJsonObject mainObj;
     QJsonArray array;
 
-    foreach(recEvent event, events) {
-        QJsonObject obj;
-        obj.insert("posX", QJsonValue(event.pos.x()).toDouble());
-        obj.insert("posY", QJsonValue(event.pos.y()).toDouble());
-        obj.insert("time", QJsonValue(event.time).toInt());
-        obj.insert("type", QJsonValue(event.type).toInt());
-
-        array.append(QJsonValue(obj));
+    for (int i = 0; i < events.size(); i++) {
+        array.append(recEventToJSON(events.at(i)));
     }
     mainObj.insert("events", array);
 
@@ -406,17 +1369,82 @@ void Qtghost::setJSONEvents(QJsonDocument doc)
     QJsonArray array = mainObj["events"].toArray();
 
     events.clear();
+    timeIndex.clear();
     for (int i=0; i < array.size(); i++) {
-        recEvent event;
-        event.pos = QPointF(array.at(i).toObject().value("posX").toDouble(),
-                            array.at(i).toObject().value("posY").toDouble());
-        event.time = array.at(i).toObject().value("time").toInt();
-        event.type = static_cast<QEvent::Type>(array.at(i).toObject().value("type").toInt());
-        events.append(event);
+        events.append(recEventFromJSON(array.at(i).toObject()));
     }
     qDebug() << "Qtghost:" << "New JSON set, size: " << events.size();
 }
 
+QByteArray Qtghost::getBinaryEvents()
+{
+    RecEncoder encoder;
+    QByteArray out;
+
+    out.reserve(rec_binary_header_size + events.size() * 5);
+    encoder.begin(&out);
+    for (int i = 0; i < events.size(); i++) {
+        encoder.encode(events.at(i), &out);
+    }
+
+    return out;
+}
+
+bool Qtghost::mapEvents(const QString &path)
+{
+    QString error;
+
+    if (recording) {
+        qDebug() << "Qtghost:" << "can't map a recording while recording:" << path;
+        return false;
+    }
+    if (!events.map(path, &error)) {
+        qDebug() << "Qtghost:" << "can't map recording:" << path << error;
+        return false;
+    }
+    timeIndex.clear();
+    qDebug() << "Qtghost:" << "Recording mapped, size: " << events.size();
+
+    return true;
+}
+
+bool Qtghost::load_events(const QString &path)
+{
+    if (recording) {
+        server->sendRec("-x ", QString("can't map a recording while recording: %1").arg(path).toUtf8(), replyTo);
+        return false;
+    }
+    if (!mapEvents(path)) {
+        server->sendRec("-x ", QString("can't map recording: %1").arg(path).toUtf8(), replyTo);
+        return false;
+    }
+
+    return true;
+}
+
+bool Qtghost::setBinaryEvents(QByteArray data)
+{
+    RecDecoder decoder(data);
+    EventStore decoded;
+    recEvent event;
+
+    while (decoder.next(&event)) {
+        decoded.append(event);
+    }
+    if (decoder.isTruncated()) {
+        // a cut upload keeps its complete records
+        qDebug() << "Qtghost:" << "binary recording truncated, dropped the last" << decoder.remaining() << "bytes";
+    }
+    else if (!decoder.isValid()) {
+        return false;
+    }
+    events = decoded;
+    timeIndex.clear();
+    qDebug() << "Qtghost:" << "New binary set, size: " << events.size();
+
+    return true;
+}
+
 void Qtghost::setStoreAllMouseMoves(bool flag)
 {
     allMouseMoves = flag;
@@ -28,18 +28,32 @@
 #include <QQmlApplicationEngine>
 #include <QGuiApplication>
 #include <QTimer>
-#include <QTime>
+#include <QElapsedTimer>
+#include <QPointer>
+#include <QHash>
+#include <QJsonArray>
+#include <QJsonDocument>
 #include "qtghost_global.h"
+#include "capture.h"
+#include "commandline.h"
+#include "eventstore.h"
+#include "frameexport.h"
+#include "framelatency.h"
+#include "pathsimplifier.h"
+#include "playback.h"
+#include "screenshot.h"
+#include "recevent.h"
 #include "server.h"
+#include "touchtrack.h"
+#include "waitcondition.h"
 
-///< \brief Stores a GUI event
-struct recEvent {
-    QPointF pos; ///< \brief position where the event occurred.
-    int time; ///< \brief QTime returns int for QTime::elapsed.
-    QEvent::Type type; ///< \brief mouse press, release, etc.
-    int argI; ///< \brief Integer argument.
-    QString argS; ///< \brief String argument.
-    QPointF pos2; ///< \brief position 2 where the event occurred.
+const int live_batch_size = 64; ///< \brief subscribed events pushed at most per batch.
+const int live_flush_interval = 50; ///< \brief ms a subscribed event may wait for its batch.
+
+///< \brief a client recorded events are pushed to.
+struct liveSubscriber {
+    replyTarget to; ///< \brief client and protocol v2 request id of the subscription.
+    bool liveOnly; ///< \brief doesn't need the events kept in memory.
 };
 
 class QtghostInterface: public QObject
@@ -54,11 +68,14 @@ public:
     virtual int step() = 0;
     virtual int record_start() = 0;
     virtual int record_stop() = 0;
-    virtual int add_event(QPointF p, QEvent::Type t, int argI = 0, QString argS = "", QPointF p2 = QPointF(0,0)) = 0;
+    virtual int add_event(QPointF p, QEvent::Type t, int argI = 0, const QString &argS = QString(), QPointF p2 = QPointF(0,0)) = 0;
     virtual int init(quint16 port=0) = 0;
+    virtual int init(const QString &localName) = 0;
     virtual void processCMD(QString cmd) = 0;
     virtual QJsonDocument getJSONEvents() = 0;
     virtual void setJSONEvents(QJsonDocument doc) = 0;
+    virtual QByteArray getBinaryEvents() = 0;
+    virtual bool setBinaryEvents(QByteArray data) = 0;
     virtual void setStoreAllMouseMoves(bool flag) = 0;
 };
 
@@ -72,16 +89,185 @@ class QTGHOSTSHARED_EXPORT Qtghost: public QtghostInterface
     bool allMouseMoves; ///< \brief flag to store all mouse moves.
     bool recording; ///< \brief if user events are being recorded.
     bool stepbystep; ///< \brief play just one event at time.
-    QList<recEvent> events; ///< \brief will hold user events.
-    QTime time; ///< \brief to get timestamps.
+    EventStore events; ///< \brief will hold user events.
+    bool reservePending; ///< \brief a reserve_events() call is queued.
+    QElapsedTimer recordClock; ///< \brief time since the recording started, to get timestamps.
+    qint64 lastEventTime; ///< \brief record clock time (ms) of the last stored event.
     QTimer playTimer; ///< \brief to trigger the next event while playing in ghost mode.
     QTimer updateRequestTimer; ///< \brief will force a screen refresh.
     int eventsIndex; ///< \brief to point to the current event into ghost mode play.
     Server *server; ///< \brief server to receive remote commands.
+    CommandLine commandLine; ///< \brief v1 text command options, built once.
     bool createScreenshotCache; ///< \brief will create a local temp file for debug. False by default.
+    ScreenshotPipeline *screenshots; ///< \brief encodes screenshots off the GUI thread.
+    QHash<int, QImage> references; ///< \brief reference images for visual assertions, by id.
+    FrameExport *frameExport; ///< \brief shared memory frame ring, created on demand.
+    replyTarget frameTarget; ///< \brief where "frame ready" notifications go.
     QObject *toWatch; ///< \brief object to have events recorded.
+    QPointer<QObject> filtered; ///< \brief object the event filter is installed on, null while dormant.
+    QHash<int, liveSubscriber> subscribers; ///< \brief clients recorded events are pushed to as they come, by client id.
+    bool subscribed; ///< \brief if there is any subscriber.
+    bool liveOnly; ///< \brief every subscriber is live only, events are not kept in memory.
+    replyTarget replyTo; ///< \brief client (and request) whose command is being processed, all_clients otherwise.
+    QJsonArray liveBatch; ///< \brief recorded events waiting to be pushed.
+    QTimer liveTimer; ///< \brief flushes liveBatch when it doesn't fill up.
+    PathSimplifier simplifier; ///< \brief optional record-time mouse path simplification.
+    QString capturePath; ///< \brief recordings go to this file instead of memory, empty for memory.
+    qint64 captureRotate; ///< \brief capture file size that starts a new file, 0 for none.
+    CaptureWriter *capture; ///< \brief background persistence of the current recording, null for memory.
+    QVector<recEvent> simplified; ///< \brief simplifier output waiting to be stored.
+    playOptions playOpts; ///< \brief speed, gap cap and fast mode of the next/current play.
+    QElapsedTimer playClock; ///< \brief time since play started.
+    qint64 playDeadline; ///< \brief offset (ms) from play start at which the next event is due.
+    LatenessStats playLateness; ///< \brief how late each event was injected.
+    QJsonObject playReport; ///< \brief timing report of the last play.
+    FrameLatency *frameLatency; ///< \brief input to frame latency, frame times and dropped frames of a play.
+    int playEnd; ///< \brief index of the event the current/last play stops at.
+    bool playing; ///< \brief a play is in progress, possibly paused.
+    bool paused; ///< \brief the play in progress is paused.
+    QElapsedTimer pauseClock; ///< \brief time since the play was paused.
+    qint64 pausedTime; ///< \brief total time (ms) of the previous pauses of the play.
+    TimeIndex timeIndex; ///< \brief recorded time to event index, built on the first seek by time.
+    QVector<playCheckpoint> checkpoints; ///< \brief checkpoints of the current/last play.
+    TouchRecorder touchRecorder; ///< \brief touch events to per point records, with coalescing.
+    QVector<recEvent> touchRecords; ///< \brief touch recorder output waiting to be stored.
+    QTimer touchTimer; ///< \brief stores coalesced touch moves when no touch event follows.
+    TouchPlayer touchPlayer; ///< \brief touch records back to touch events while playing.
+    QTouchDevice *touchDevice; ///< \brief device of the played touch events, created on demand.
+    ObjectIndex *objects; ///< \brief objectName index of the watched scene, for wait conditions.
+    ConditionWaiter *playWait; ///< \brief wait step the play is blocked on, null if none.
+    qint64 waitPausedTime; ///< \brief pausedTime when the current wait step started.
+    int waitedIndex; ///< \brief index of the wait step that just finished, the play goes on past it.
+    QJsonArray playWaits; ///< \brief wait steps of the current/last play (see ConditionWaiter::toJSON).
+    QHash<ConditionWaiter*, replyTarget> liveWaits; ///< \brief wait commands in progress and their client.
     Q_OBJECT
 
+    /**
+      \brief builds the timing report of the current/last play.
+      \return report: options, events played, requested and actual time, drift.
+    */
+    QJsonObject play_report();
+    /**
+      \brief play time so far, pauses excluded.
+      \return ms since play started.
+    */
+    qint64 play_time() const;
+    /**
+      \brief grabs the window and records its hash as a checkpoint of the events played so far.
+    */
+    void take_checkpoint();
+    /**
+      \brief seeks (see seek and seekTime), an error goes to replyTo.
+      \param value event index or recorded time (ms).
+      \param byTime value is a recorded time.
+      \return false if value is out of the recording.
+    */
+    bool seek_events(qint64 value, bool byTime);
+    /**
+      \brief handles a wait step while playing.
+      \param ev wait step (see waitcondition.h).
+      \return true if the play goes on, false if it waits for the condition (see play_wait_done).
+    */
+    bool wait_step(const recEvent &ev);
+    /**
+      \brief drops the wait step the play is blocked on, if any.
+    */
+    void cancel_wait();
+    /**
+      \brief releases the object index (see ObjectIndex::release) when no wait command, wait step or play is in progress.
+    */
+    void release_objects();
+    /**
+      \brief waits for a condition, the result (see ConditionWaiter::toJSON) goes to replyTo.
+      \param spec condition (see waitCondition::parse).
+      \param timeoutMs ms before giving up, 0 for wait_default_timeout.
+    */
+    void wait_for(const QString &spec, int timeoutMs);
+    /**
+      \brief connects the server signals, see init().
+    */
+    void connect_server();
+    /**
+      \brief processes a received command, text or binary, replies go to replyTo.
+      \param data command.
+    */
+    void process_data(const QByteArray &data);
+    /**
+      \brief grabs the window and queues it to be encoded, the screenshot goes to replyTo.
+      \param request encoding options.
+    */
+    void take_screenshot(screenshotRequest request);
+    /**
+      \brief grabs the window and queues it to be compared to a reference, the verdict goes to replyTo.
+      \param request comparison options.
+    */
+    void assert_frame(const compareRequest &request);
+    /**
+      \brief sends the play report to replyTo.
+      \param perEvent add the lateness of every event.
+    */
+    void send_play_report(bool perEvent);
+    /**
+      \brief (re)creates the shared memory frame ring, its description goes to replyTo.
+      \param name file name or path.
+      \param count number of slots.
+    */
+    void open_frame_export(const QString &name, int count);
+    /**
+      \brief exports frames to the shared memory ring, notifications go to replyTo.
+      \param action FRAMES_ONE, FRAMES_STREAM or FRAMES_STOP.
+      \return false if the ring isn't open (an error is sent).
+    */
+    bool export_frames(frameAction action);
+    /**
+      \brief installs the event filter on the watched object (recording) or removes it (dormant).
+
+      Nothing is filtered while dormant, so an app shipping with Qtghost loaded doesn't
+      pay for it until a record command arms it; playing doesn't need the filter.
+      \param on true: arm, false: back to dormant.
+    */
+    void arm(bool on);
+    /**
+      \brief maps an indexed recording (see mapEvents), an error goes to replyTo.
+      \param path recording file.
+      \return false on failure.
+    */
+    bool load_events(const QString &path);
+    /**
+      \brief stops the capture writer, if any, once the queued events are written.
+    */
+    void stop_capture();
+    /**
+      \brief sends a recorded event to the watched object.
+      \param ev event to be played.
+    */
+    void inject_event(const recEvent &ev);
+
+    /**
+      \brief stores a recorded event and pushes it to the subscribed clients.
+      \param p position where the event occurred.
+      \param delay delay since the previous stored event.
+      \param t event type.
+      \param argI integer argument.
+      \param argS string argument.
+      \param p2 position 2.
+    */
+    void store_event(QPointF p, int delay, QEvent::Type t, int argI, const QString &argS, QPointF p2);
+    /**
+      \brief stores the events output by the path simplifier.
+    */
+    void store_simplified();
+    /**
+      \brief stores the records output by the touch recorder, with the delays of the times they were observed at.
+    */
+    void store_touch();
+
+    /**
+      \brief queues a recorded event to be pushed to the subscribed clients.
+      \param rec recorded event.
+    */
+    void publish_event(const recEvent &rec);
+
 public:
     /**
       \brief class constructor.
@@ -89,7 +275,7 @@ public:
       \param engine pointer to QML engine.
     */
     Qtghost(QGuiApplication *app, QQmlApplicationEngine *engine);
-    //virtual ~Qtghost();
+    ~Qtghost();
     /**
      * \brief get Lib Version
      * \return QString library version
@@ -112,8 +298,46 @@ public:
       \return 0 on success.
     */
     int play();
+    /**
+     * \brief sets how recorded delays are played (see playOptions), used by the next play.
+     * @param options speed multiplier, gap cap and fast mode.
+     */
+    void setPlayOptions(const playOptions &options);
+    /**
+     * \brief timing report of the current or last play.
+     * @return JSON object: options, played events, requested/actual time (ms, pauses excluded), drift (ms),
+     * lateness, frames (input to frame latency, frame times, dropped frames, see FrameLatency),
+     * checkpoints (see playCheckpoint) and waits (see ConditionWaiter::toJSON).
+     */
+    QJsonObject getPlayReport();
+    /**
+     * \brief moves the play cursor to an event, the events in between are not injected.
+     * The app state is whatever the events played so far left, so this is meant to skip
+     * events known not to matter, or to go back after restoring the state; play a range
+     * (see playOptions) with fast to actually get to an event. The next play() starts at
+     * playOptions::from again, step() goes on from the cursor.
+     * @param index event index, events.size() to end the play.
+     * @return false if index is out of the recording.
+     */
+    bool seek(int index);
+    /**
+     * \brief moves the play cursor to the first event recorded at or after a time, see seek.
+     * @param ms recorded time since the recording started.
+     * @return false if ms is negative.
+     */
+    bool seekTime(qint64 ms);
+    /**
+     * \brief pauses the play in progress, pause time isn't counted by the play report.
+     */
+    void pause();
+    /**
+     * \brief resumes a paused play at the recorded pace from where it was paused (or seeked).
+     */
+    void resume();
     /**
       \brief will play just one user ghost recorded event.
+      Steps stay in the play range ([from, to) of the play options) and take its
+      checkpoints; past its last event, the next step goes back to its start.
       \return 0 on success.
     */
     int step();
@@ -135,15 +359,24 @@ public:
       \param argS string argument.
       \return 0 on success.
     */
-    int add_event(QPointF p, QEvent::Type t, int argI = 0, QString argS = "", QPointF p2 = QPointF(0,0));
+    int add_event(QPointF p, QEvent::Type t, int argI = 0, const QString &argS = QString(), QPointF p2 = QPointF(0,0));
     /**
       \brief Init the ghost mode, for now init the server.
+      QTGHOST_SOCKET (local socket name) or QTGHOST_PORT in the environment override the
+      endpoint, so an orchestrator can run several instances of an app side by side.
       \param port ghost server port number.
       \return 0 on success.
     */
     int init(quint16 port=0) override;
     /**
-      \brief process a received command.
+      \brief Init the ghost mode on a local socket (Unix domain socket, named pipe) instead of TCP.
+      The environment overrides the endpoint as for init(quint16).
+      \param localName socket name (created in the temp dir) or full path.
+      \return 0 on success.
+    */
+    int init(const QString &localName) override;
+    /**
+      \brief process a received command, replies "-x <error>" if its options can't be parsed.
       \param cmd command to be processed.
     */
     void processCMD(QString cmd);
@@ -157,11 +390,78 @@ public:
       \param doc JSON document to be inserted into ghost memory.
     */
     void setJSONEvents(QJsonDocument doc);
+    /**
+      \brief will convert in memory user events into a binary recording (see recbinary.h).
+      \return binary recording containing user events.
+    */
+    QByteArray getBinaryEvents();
+    /**
+      \brief having a binary recording this function will put it into app memory being ready for Ghost play.
+      \param data binary recording to be inserted into ghost memory.
+      \return false if data is not a valid binary recording, memory is left untouched. A recording cut
+      inside its last record (interrupted upload) is not rejected: the complete records are kept.
+    */
+    bool setBinaryEvents(QByteArray data);
+    /**
+      \brief plays an indexed recording file in place (see EventStore::map): it is mapped, not
+      loaded, so a recording of any size is ready at once and only played pages are read.
+      \param path indexed recording (see mappedrecording.h), on the app side.
+      \return false if the file can't be mapped or a recording is running, memory is left untouched.
+    */
+    bool mapEvents(const QString &path);
     /**
      * \brief configures ghost to register all mouse moves or only when a key is being pressed (touchscreen).
      * @param flag true: store all mouse movements, false: store mouse movements only when a key is being pressed.
      */
     void setStoreAllMouseMoves(bool flag);
+    /**
+     * \brief pushes every recorded event to the client whose command is being processed
+     * (every client when called directly), in batches, as it is recorded.
+     * @param flag true: subscribe, false: unsubscribe.
+     * @param keep false: events are only pushed, not kept for get-rec or play.
+     */
+    void setSubscribed(bool flag, bool keep = true);
+    /**
+     * \brief configures the record-time mouse path simplification (see PathSimplifier), all zero disables it.
+     * @param tolerance max distance (px) between a dropped move and the simplified path at the same time.
+     * @param minDistance moves closer (px) than this to the previous kept move are dropped.
+     * @param minInterval moves sooner (ms) than this after the previous kept move are dropped.
+     */
+    void setPathSimplification(qreal tolerance, qreal minDistance = 0, int minInterval = 0);
+    /**
+     * \brief configures the coalescing of recorded touch moves (see TouchRecorder).
+     * @param ms moves closer than this to the previous stored touch event are merged, 0 stores them all.
+     */
+    void setTouchCoalescing(int ms);
+    /**
+     * \brief records a wait step (see waitcondition.h): while playing, the next events wait for
+     * the condition instead of their recorded delays, so a fast play doesn't race slow screens.
+     * @param condition "name", "name.property" or "name.property=value" (see waitCondition::parse).
+     * @param timeoutMs ms the play waits at most, 0 for wait_default_timeout.
+     * @return 0 on success.
+     */
+    int add_wait(const QString &condition, int timeoutMs = 0);
+    /**
+     * \brief records the next recordings to disk (see CaptureWriter) instead of memory, for soak tests.
+     * add_event() then only queues fixed size records, a background thread encodes and appends them
+     * to the file, so memory stays constant. Simplification and subscriptions don't apply.
+     * @param path capture file (binary format), empty to record in memory again.
+     * @param rotateBytes file size that starts a new file (name.1.qgr...), 0 for none.
+     */
+    void setCapture(const QString &path, qint64 rotateBytes = 0);
+    /**
+     * \brief stores a reference image for visual assertions (see VisualAssert).
+     * @param id reference id, replaces a previous image with the same id.
+     * @param image reference image, a null image removes the reference.
+     */
+    void setReference(int id, const QImage &image);
+
+signals:
+    /**
+      \brief emitted when a play reaches the last event.
+      \param report timing report (see getPlayReport).
+    */
+    void playFinished(QJsonObject report);
 
 public slots:
     /**
@@ -170,8 +470,59 @@ public slots:
     void consume_event();
     /**
       \brief called when there is data ready to be converted into Ghost command.
+      \param data command.
+      \param client client that sent it, replies go there.
+    */
+    void processCMD(QByteArray data, int client = all_clients);
+    /**
+      \brief drops the subscription and screenshot state of a disconnected client.
+      \param client client id.
+    */
+    void client_disconnected(int client);
+    /**
+      \brief called when a protocol v2 request is received (see protocol.h).
+      \param data request: u8 opcode, u32 request id, arguments.
+      \param client client that sent it, replies go there with the request id.
+    */
+    void processRequest(QByteArray data, int client);
+    /**
+      \brief pushes the pending batch of recorded events to the subscribed clients.
+    */
+    void flush_live();
+    /**
+      \brief stores the coalesced touch moves still pending.
+    */
+    void flush_touch();
+    /**
+      \brief goes on playing after a wait step.
+      \param met the condition held, false if the wait timed out.
+      \param ms time waited.
+    */
+    void play_wait_done(bool met, qint64 ms);
+    /**
+      \brief sends the result of a wait command to its client.
+      \param met the condition held, false if the wait timed out.
+    */
+    void live_wait_done(bool met);
+    /**
+      \brief reserves event storage ahead, called outside of event delivery.
+    */
+    void reserve_events();
+    /**
+      \brief sends an encoded screenshot or a visual assertion result to the client.
+      \param cmd reply command.
+      \param data encoded screenshot or assertion result.
+      \param to client (and request) that asked for it.
+    */
+    void send_screenshot(QString cmd, QByteArray data, replyTarget to);
+    /**
+      \brief notifies that a frame was exported to the shared memory ring.
+      \param seq frame number.
+      \param slot slot index.
+      \param width frame width.
+      \param height frame height.
     */
-    void processCMD(QByteArray);
+    void send_frame(quint64 seq, int slot, int width, int height);
 };
 
 /**
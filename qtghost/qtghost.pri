@@ -0,0 +1,48 @@
+# library sources, shared by qtghost.pro and the targets building them in (qtghost_bench)
+
+INCLUDEPATH += $$PWD
+
+SOURCES += \
+    $$PWD/qtghost.cpp \
+    $$PWD/server.cpp \
+    $$PWD/recevent.cpp \
+    $$PWD/recbinary.cpp \
+    $$PWD/recstream.cpp \
+    $$PWD/eventstore.cpp \
+    $$PWD/pathsimplifier.cpp \
+    $$PWD/playback.cpp \
+    $$PWD/screenshot.cpp \
+    $$PWD/tilehash.cpp \
+    $$PWD/visualassert.cpp \
+    $$PWD/ringbuffer.cpp \
+    $$PWD/protocol.cpp \
+    $$PWD/commandline.cpp \
+    $$PWD/frameexport.cpp \
+    $$PWD/framelatency.cpp \
+    $$PWD/capture.cpp \
+    $$PWD/mappedrecording.cpp \
+    $$PWD/touchtrack.cpp \
+    $$PWD/waitcondition.cpp
+
+HEADERS += \
+    $$PWD/qtghost.h \
+    $$PWD/qtghost_global.h \
+    $$PWD/server.h \
+    $$PWD/recevent.h \
+    $$PWD/recbinary.h \
+    $$PWD/recstream.h \
+    $$PWD/eventstore.h \
+    $$PWD/pathsimplifier.h \
+    $$PWD/playback.h \
+    $$PWD/screenshot.h \
+    $$PWD/tilehash.h \
+    $$PWD/visualassert.h \
+    $$PWD/ringbuffer.h \
+    $$PWD/protocol.h \
+    $$PWD/commandline.h \
+    $$PWD/frameexport.h \
+    $$PWD/framelatency.h \
+    $$PWD/capture.h \
+    $$PWD/mappedrecording.h \
+    $$PWD/touchtrack.h \
+    $$PWD/waitcondition.h
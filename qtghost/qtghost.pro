@@ -4,7 +4,7 @@
 #
 #-------------------------------------------------
 
-QT += quick
+QT += quick concurrent
 CONFIG += c++11
 TARGET = qtghost
 TEMPLATE = lib
@@ -22,14 +22,7 @@ DEFINES += QT_DEPRECATED_WARNINGS
 # You can also select to disable deprecated APIs only up to a certain version of Qt.
 #DEFINES += QT_DISABLE_DEPRECATED_BEFORE=0x060000    # disables all the APIs deprecated before Qt 6.0.0
 
-SOURCES += \
-        qtghost.cpp \
-    server.cpp
-
-HEADERS += \
-        qtghost.h \
-        qtghost_global.h \ 
-    server.h
+include(qtghost.pri)
 
 unix {
     target.path = /usr/lib
@@ -0,0 +1,311 @@
+/*
+* MIT License
+*
+* Copyright (c) 2018 Antonio Alecrim Jr
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*/
+
+#include "recbinary.h"
+#include <QtEndian>
+#include <cmath>
+#include <cstring>
+
+static const double max_int_pos = 2147483647.0; ///< \brief larger coordinates are stored raw.
+
+static inline void putVarint(QByteArray *out, quint64 value)
+{
+    while (value >= 0x80) {
+        out->append(static_cast<char>((value & 0x7f) | 0x80));
+        value >>= 7;
+    }
+    out->append(static_cast<char>(value));
+}
+
+static inline quint64 zigzag(qint64 value)
+{
+    return (static_cast<quint64>(value) << 1) ^ static_cast<quint64>(value >> 63);
+}
+
+static inline qint64 unzigzag(quint64 value)
+{
+    return static_cast<qint64>(value >> 1) ^ -static_cast<qint64>(value & 1);
+}
+
+static inline void putDouble(QByteArray *out, double value)
+{
+    quint64 bits;
+    char raw[sizeof(bits)];
+
+    std::memcpy(&bits, &value, sizeof(bits));
+    qToLittleEndian<quint64>(bits, reinterpret_cast<uchar *>(raw));
+    out->append(raw, sizeof(raw));
+}
+
+static inline bool isIntegral(const QPointF &p)
+{
+    return std::floor(p.x()) == p.x() && std::fabs(p.x()) <= max_int_pos &&
+           std::floor(p.y()) == p.y() && std::fabs(p.y()) <= max_int_pos;
+}
+
+RecEncoder::RecEncoder()
+{
+    reset();
+}
+
+void RecEncoder::reset()
+{
+    prevX = 0;
+    prevY = 0;
+    prevType = -1;
+    strings.clear();
+}
+
+void RecEncoder::begin(QByteArray *out)
+{
+    reset();
+    out->append(rec_binary_magic, 4);
+    out->append(static_cast<char>(rec_binary_version));
+    out->append('\0');
+}
+
+void RecEncoder::encode(const recEvent &event, QByteArray *out)
+{
+    quint8 head = 0;
+    bool hasPos2 = !event.pos2.isNull();
+    bool raw = !isIntegral(event.pos) || (hasPos2 && !isIntegral(event.pos2));
+
+    if (event.type == prevType)
+        head |= REC_SAME_TYPE;
+    if (event.argI)
+        head |= REC_ARG_I;
+    if (!event.argS.isEmpty())
+        head |= REC_ARG_S;
+    if (hasPos2)
+        head |= REC_POS2;
+    if (raw)
+        head |= REC_RAW_POS;
+
+    out->append(static_cast<char>(head));
+    if (!(head & REC_SAME_TYPE))
+        putVarint(out, static_cast<quint64>(event.type));
+    putVarint(out, static_cast<quint64>(qMax(event.time, 0)));
+
+    qint64 x = qRound64(event.pos.x());
+    qint64 y = qRound64(event.pos.y());
+    if (raw) {
+        putDouble(out, event.pos.x());
+        putDouble(out, event.pos.y());
+    }
+    else {
+        putVarint(out, zigzag(x - prevX));
+        putVarint(out, zigzag(y - prevY));
+    }
+
+    if (head & REC_ARG_I)
+        putVarint(out, zigzag(event.argI));
+
+    if (head & REC_ARG_S) {
+        QHash<QString, int>::const_iterator it = strings.constFind(event.argS);
+        if (it != strings.constEnd()) {
+            putVarint(out, static_cast<quint64>(it.value()) + 1);
+        }
+        else {
+            QByteArray utf8 = event.argS.toUtf8();
+            putVarint(out, 0);
+            putVarint(out, static_cast<quint64>(utf8.size()));
+            out->append(utf8);
+            strings.insert(event.argS, strings.size());
+        }
+    }
+
+    if (hasPos2) {
+        if (raw) {
+            putDouble(out, event.pos2.x());
+            putDouble(out, event.pos2.y());
+        }
+        else {
+            putVarint(out, zigzag(qRound64(event.pos2.x()) - x));
+            putVarint(out, zigzag(qRound64(event.pos2.y()) - y));
+        }
+    }
+
+    prevX = x;
+    prevY = y;
+    prevType = event.type;
+}
+
+RecDecoder::RecDecoder(const QByteArray &stream) : data(stream)
+{
+    offset = rec_binary_header_size;
+    prevX = 0;
+    prevY = 0;
+    prevType = 0;
+    truncated = false;
+    valid = data.size() >= rec_binary_header_size &&
+            data.startsWith(rec_binary_magic) &&
+            static_cast<quint8>(data.at(4)) == rec_binary_version;
+}
+
+bool RecDecoder::readVarint(quint64 *value)
+{
+    const char *p = data.constData();
+    int shift = 0;
+
+    *value = 0;
+    while (offset < data.size() && shift < 64) {
+        quint8 byte = static_cast<quint8>(p[offset++]);
+        *value |= static_cast<quint64>(byte & 0x7f) << shift;
+        if (!(byte & 0x80))
+            return true;
+        shift += 7;
+    }
+    // out of data, rather than a varint running past 64 bits
+    if (shift < 64)
+        truncated = true;
+
+    return false;
+}
+
+bool RecDecoder::readDouble(double *value)
+{
+    quint64 bits;
+
+    if (data.size() - offset < static_cast<int>(sizeof(bits))) {
+        truncated = true;
+        return false;
+    }
+    bits = qFromLittleEndian<quint64>(reinterpret_cast<const uchar *>(data.constData() + offset));
+    std::memcpy(value, &bits, sizeof(bits));
+    offset += sizeof(bits);
+
+    return true;
+}
+
+bool RecDecoder::next(recEvent *event)
+{
+    quint64 value;
+    double x, y;
+
+    if (!valid || atEnd())
+        return false;
+
+    int start = offset;
+    quint8 head = static_cast<quint8>(data.at(offset++));
+    bool ok = true;
+
+    if (head & ~(REC_SAME_TYPE | REC_ARG_I | REC_ARG_S | REC_POS2 | REC_RAW_POS)) {
+        valid = false;
+        return false;
+    }
+
+    if (!(head & REC_SAME_TYPE)) {
+        ok = ok && readVarint(&value);
+        prevType = static_cast<int>(value);
+    }
+    event->type = static_cast<QEvent::Type>(prevType);
+    ok = ok && readVarint(&value);
+    event->time = static_cast<int>(value);
+
+    if (head & REC_RAW_POS) {
+        ok = ok && readDouble(&x) && readDouble(&y);
+        event->pos = QPointF(x, y);
+        prevX = qRound64(x);
+        prevY = qRound64(y);
+    }
+    else {
+        ok = ok && readVarint(&value);
+        prevX += unzigzag(value);
+        ok = ok && readVarint(&value);
+        prevY += unzigzag(value);
+        event->pos = QPointF(prevX, prevY);
+    }
+
+    event->argI = 0;
+    if (head & REC_ARG_I) {
+        ok = ok && readVarint(&value);
+        event->argI = static_cast<int>(unzigzag(value));
+    }
+
+    event->argS = QString();
+    if (head & REC_ARG_S) {
+        ok = ok && readVarint(&value);
+        if (ok && value == 0) {
+            quint64 length;
+            ok = readVarint(&length);
+            if (ok && length > static_cast<quint64>(data.size() - offset)) {
+                truncated = true;
+                ok = false;
+            }
+            if (ok) {
+                strings.append(QString::fromUtf8(data.constData() + offset, static_cast<int>(length)));
+                offset += static_cast<int>(length);
+                event->argS = strings.last();
+            }
+        }
+        else if (ok) {
+            ok = value <= static_cast<quint64>(strings.size());
+            if (ok)
+                event->argS = strings.at(static_cast<int>(value - 1));
+        }
+    }
+
+    event->pos2 = QPointF();
+    if (head & REC_POS2) {
+        if (head & REC_RAW_POS) {
+            ok = ok && readDouble(&x) && readDouble(&y);
+            event->pos2 = QPointF(x, y);
+        }
+        else {
+            ok = ok && readVarint(&value);
+            x = static_cast<double>(prevX + unzigzag(value));
+            ok = ok && readVarint(&value);
+            y = static_cast<double>(prevY + unzigzag(value));
+            event->pos2 = QPointF(x, y);
+        }
+    }
+
+    if (!ok) {
+        // truncated record: keep what was decoded so far
+        offset = start;
+        valid = false;
+    }
+
+    return ok;
+}
+
+bool RecDecoder::isValid() const
+{
+    return valid;
+}
+
+bool RecDecoder::isTruncated() const
+{
+    return !valid && truncated;
+}
+
+int RecDecoder::remaining() const
+{
+    return qMax(data.size() - offset, 0);
+}
+
+bool RecDecoder::atEnd() const
+{
+    return offset >= data.size();
+}
@@ -0,0 +1,135 @@
+/*
+* MIT License
+*
+* Copyright (c) 2018 Antonio Alecrim Jr
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*/
+
+#ifndef RECBINARY_H
+#define RECBINARY_H
+
+#include <QByteArray>
+#include <QHash>
+#include <QStringList>
+#include "recevent.h"
+
+/*
+ * Binary recording format (version 1), all integers are little endian:
+ *
+ *   header: "QGRB" magic, u8 version, u8 flags (reserved, 0)
+ *   record: u8 head, followed by the fields selected by head:
+ *     [varint type]            if !REC_SAME_TYPE
+ *     varint time              delay since previous event (ms)
+ *     pos                      zigzag varint delta from previous pos, or 2 raw doubles (REC_RAW_POS)
+ *     [zigzag varint argI]     if REC_ARG_I
+ *     [varint ref [string]]    if REC_ARG_S: ref 0 defines a new string (varint length + UTF-8),
+ *                              ref N > 0 reuses the (N-1)th defined string
+ *     [pos2]                   if REC_POS2: zigzag varint delta from pos, or 2 raw doubles
+ *
+ * Records have no count nor trailer, so a stream can be appended to and read up to its last
+ * complete record.
+ */
+
+const char rec_binary_magic[] = "QGRB";
+const quint8 rec_binary_version = 1;
+const int rec_binary_header_size = 6;
+
+enum recBinaryHead {
+    REC_SAME_TYPE = 0x01, ///< \brief same type as previous record, type is omitted.
+    REC_ARG_I = 0x02, ///< \brief argI is present.
+    REC_ARG_S = 0x04, ///< \brief argS is present.
+    REC_POS2 = 0x08, ///< \brief pos2 is present.
+    REC_RAW_POS = 0x10 ///< \brief positions are not integers, stored as raw doubles.
+};
+
+class RecEncoder
+{
+    qint64 prevX; ///< \brief previous event x (integer domain).
+    qint64 prevY; ///< \brief previous event y (integer domain).
+    int prevType; ///< \brief previous event type, -1 for none.
+    QHash<QString, int> strings; ///< \brief interned argS table.
+
+public:
+    RecEncoder();
+    /**
+      \brief forgets the encoding state, next encode will start a new stream.
+    */
+    void reset();
+    /**
+      \brief writes the stream header and resets the encoding state.
+      \param out buffer to append to.
+    */
+    void begin(QByteArray *out);
+    /**
+      \brief appends one event to a stream.
+      \param event event to be encoded.
+      \param out buffer to append to.
+    */
+    void encode(const recEvent &event, QByteArray *out);
+};
+
+class RecDecoder
+{
+    const QByteArray data; ///< \brief stream being decoded.
+    int offset; ///< \brief current read offset.
+    bool valid; ///< \brief false after a bad header or a truncated record.
+    bool truncated; ///< \brief the failed record is cut by the end of the data.
+    qint64 prevX; ///< \brief previous event x (integer domain).
+    qint64 prevY; ///< \brief previous event y (integer domain).
+    int prevType; ///< \brief previous event type.
+    QStringList strings; ///< \brief interned argS table.
+
+    bool readVarint(quint64 *value);
+    bool readDouble(double *value);
+
+public:
+    /**
+      \brief decoder constructor, checks the stream header.
+      \param stream binary recording.
+    */
+    explicit RecDecoder(const QByteArray &stream);
+    /**
+      \brief reads the next event.
+      \param event where to store the decoded event.
+      \return false at the end of data or on error.
+    */
+    bool next(recEvent *event);
+    /**
+      \brief tells if the stream was well formed up to the current record.
+      \return false on bad header or corrupted/truncated data.
+    */
+    bool isValid() const;
+    /**
+      \brief tells if decoding stopped at a record cut by the end of the data.
+      \return true if the records read so far are complete and only the last one is missing bytes.
+    */
+    bool isTruncated() const;
+    /**
+      \brief bytes not decoded yet, the truncated record after a failure.
+    */
+    int remaining() const;
+    /**
+      \brief tells if all the data was consumed.
+      \return true when there is no record left.
+    */
+    bool atEnd() const;
+};
+
+#endif // RECBINARY_H
@@ -0,0 +1,59 @@
+/*
+* MIT License
+*
+* Copyright (c) 2018 Antonio Alecrim Jr
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*/
+
+#include "recevent.h"
+
+QJsonObject recEventToJSON(const recEvent &event)
+{
+    QJsonObject obj;
+
+    obj.insert("posX", event.pos.x());
+    obj.insert("posY", event.pos.y());
+    obj.insert("time", event.time);
+    obj.insert("type", static_cast<int>(event.type));
+    if (event.argI)
+        obj.insert("argI", event.argI);
+    if (!event.argS.isEmpty())
+        obj.insert("argS", event.argS);
+    if (!event.pos2.isNull()) {
+        obj.insert("posX2", event.pos2.x());
+        obj.insert("posY2", event.pos2.y());
+    }
+
+    return obj;
+}
+
+recEvent recEventFromJSON(const QJsonObject &obj)
+{
+    recEvent event;
+
+    event.pos = QPointF(obj.value("posX").toDouble(), obj.value("posY").toDouble());
+    event.time = obj.value("time").toInt();
+    event.type = static_cast<QEvent::Type>(obj.value("type").toInt());
+    event.argI = obj.value("argI").toInt();
+    event.argS = obj.value("argS").toString();
+    event.pos2 = QPointF(obj.value("posX2").toDouble(), obj.value("posY2").toDouble());
+
+    return event;
+}
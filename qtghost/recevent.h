@@ -0,0 +1,56 @@
+/*
+* MIT License
+*
+* Copyright (c) 2018 Antonio Alecrim Jr
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*/
+
+#ifndef RECEVENT_H
+#define RECEVENT_H
+
+#include <QEvent>
+#include <QPointF>
+#include <QString>
+#include <QJsonObject>
+
+///< \brief Stores a GUI event
+struct recEvent {
+    QPointF pos; ///< \brief position where the event occurred.
+    int time; ///< \brief QTime returns int for QTime::elapsed.
+    QEvent::Type type; ///< \brief mouse press, release, etc.
+    int argI; ///< \brief Integer argument.
+    QString argS; ///< \brief String argument.
+    QPointF pos2; ///< \brief position 2 where the event occurred.
+};
+
+/**
+  \brief converts a recorded event into its JSON representation.
+  \param event event to be converted.
+  \return JSON object, optional fields (argI, argS, pos2) are only present when set.
+*/
+QJsonObject recEventToJSON(const recEvent &event);
+/**
+  \brief converts a JSON object (see recEventToJSON) into a recorded event.
+  \param obj JSON object to be converted.
+  \return recorded event, missing fields are zeroed.
+*/
+recEvent recEventFromJSON(const QJsonObject &obj);
+
+#endif // RECEVENT_H
@@ -0,0 +1,65 @@
+/*
+* MIT License
+*
+* Copyright (c) 2018 Antonio Alecrim Jr
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*/
+
+#include "recstream.h"
+#include <QJsonDocument>
+
+JSONEventStream::JSONEventStream(const EventStore &snapshot) : events(snapshot)
+{
+    index = 0;
+}
+
+bool JSONEventStream::next(QByteArray *chunk)
+{
+    if (!index)
+        chunk->append("{\"events\":[");
+    while (index < events.size() && chunk->size() < stream_chunk_size) {
+        if (index)
+            chunk->append(',');
+        chunk->append(QJsonDocument(recEventToJSON(events.at(index))).toJson(QJsonDocument::Compact));
+        index++;
+    }
+    if (index < events.size())
+        return true;
+    chunk->append("]}");
+
+    return false;
+}
+
+BinaryEventStream::BinaryEventStream(const EventStore &snapshot) : events(snapshot)
+{
+    index = 0;
+}
+
+bool BinaryEventStream::next(QByteArray *chunk)
+{
+    if (!index)
+        encoder.begin(chunk);
+    while (index < events.size() && chunk->size() < stream_chunk_size) {
+        encoder.encode(events.at(index), chunk);
+        index++;
+    }
+
+    return index < events.size();
+}
@@ -0,0 +1,61 @@
+/*
+* MIT License
+*
+* Copyright (c) 2018 Antonio Alecrim Jr
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*/
+
+#ifndef RECSTREAM_H
+#define RECSTREAM_H
+
+#include "eventstore.h"
+#include "recbinary.h"
+#include "server.h"
+
+const int stream_chunk_size = 64 * 1024; ///< \brief encoded bytes per streamed chunk.
+
+/**
+  \brief streams a recording as the JSON document returned by Qtghost::getJSONEvents.
+*/
+class JSONEventStream : public StreamSource
+{
+    const EventStore events; ///< \brief snapshot of the events to be sent.
+    int index; ///< \brief next event to be encoded.
+
+public:
+    explicit JSONEventStream(const EventStore &snapshot);
+    bool next(QByteArray *chunk) override;
+};
+
+/**
+  \brief streams a recording in binary format (see recbinary.h).
+*/
+class BinaryEventStream : public StreamSource
+{
+    const EventStore events; ///< \brief snapshot of the events to be sent.
+    int index; ///< \brief next event to be encoded.
+    RecEncoder encoder; ///< \brief keeps the delta/string state between chunks.
+
+public:
+    explicit BinaryEventStream(const EventStore &snapshot);
+    bool next(QByteArray *chunk) override;
+};
+
+#endif // RECSTREAM_H
@@ -0,0 +1,137 @@
+/*
+* MIT License
+*
+* Copyright (c) 2018 Antonio Alecrim Jr
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*/
+
+#include "ringbuffer.h"
+#include <cstring>
+
+RingBuffer::RingBuffer()
+{
+    ring.resize(ring_initial_size);
+    head = 0;
+    count = 0;
+}
+
+int RingBuffer::size() const
+{
+    return count;
+}
+
+int RingBuffer::capacity() const
+{
+    return ring.size();
+}
+
+void RingBuffer::reserve(int n)
+{
+    if (capacity() - count >= n)
+        return;
+
+    int grown = capacity();
+    while (grown - count < n) {
+        grown *= 2;
+    }
+    // unwrap into the new storage, head goes back to 0
+    QByteArray bigger(grown, Qt::Uninitialized);
+    peek(0, bigger.data(), count);
+    ring = bigger;
+    head = 0;
+}
+
+char *RingBuffer::writePointer(int *length)
+{
+    int tail = (head + count) & (capacity() - 1);
+
+    if (count == capacity())
+        *length = 0;
+    else if (tail >= head)
+        *length = capacity() - tail;
+    else
+        *length = head - tail;
+
+    return ring.data() + tail;
+}
+
+void RingBuffer::commit(int n)
+{
+    count += n;
+}
+
+void RingBuffer::append(const char *data, int n)
+{
+    reserve(n);
+    while (n > 0) {
+        int length;
+        char *to = writePointer(&length);
+        length = qMin(length, n);
+        memcpy(to, data, length);
+        commit(length);
+        data += length;
+        n -= length;
+    }
+}
+
+void RingBuffer::peek(int offset, char *to, int n) const
+{
+    int from = (head + offset) & (capacity() - 1);
+    int first = qMin(n, capacity() - from);
+
+    memcpy(to, ring.constData() + from, first);
+    memcpy(to + first, ring.constData(), n - first);
+}
+
+char RingBuffer::at(int offset) const
+{
+    return ring.at((head + offset) & (capacity() - 1));
+}
+
+QByteArray RingBuffer::mid(int offset, int n) const
+{
+    QByteArray data(n, Qt::Uninitialized);
+
+    peek(offset, data.data(), n);
+
+    return data;
+}
+
+void RingBuffer::consume(int n)
+{
+    head = (head + n) & (capacity() - 1);
+    count -= n;
+    if (!count)
+        head = 0;
+}
+
+void RingBuffer::clear()
+{
+    head = 0;
+    count = 0;
+}
+
+void RingBuffer::squeeze()
+{
+    if (!count && capacity() > ring_initial_size) {
+        ring = QByteArray(ring_initial_size, Qt::Uninitialized);
+        head = 0;
+    }
+}
@@ -0,0 +1,113 @@
+/*
+* MIT License
+*
+* Copyright (c) 2018 Antonio Alecrim Jr
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*/
+
+#ifndef RINGBUFFER_H
+#define RINGBUFFER_H
+
+#include <QByteArray>
+
+const int ring_initial_size = 64 * 1024; ///< \brief initial ring capacity, it grows for bigger packets.
+
+/**
+  \brief byte ring buffer, data is parsed at an offset and consumed without moving it.
+
+  The capacity is a power of two and only grows when a packet doesn't fit,
+  squeeze() gives the memory back once it is empty.
+*/
+class RingBuffer
+{
+    QByteArray ring; ///< \brief storage, capacity bytes.
+    int head; ///< \brief index of the first byte.
+    int count; ///< \brief bytes stored.
+
+public:
+    RingBuffer();
+    /**
+      \brief bytes stored.
+      \return size.
+    */
+    int size() const;
+    /**
+      \brief storage size.
+      \return capacity.
+    */
+    int capacity() const;
+    /**
+      \brief makes room for at least n more bytes, growing the ring if needed.
+      \param n bytes.
+    */
+    void reserve(int n);
+    /**
+      \brief contiguous free space after the last byte, see commit().
+      \param length free bytes at the returned pointer, output.
+      \return where to write.
+    */
+    char *writePointer(int *length);
+    /**
+      \brief appends n bytes written at writePointer().
+      \param n bytes written.
+    */
+    void commit(int n);
+    /**
+      \brief appends data.
+      \param data data.
+      \param n bytes.
+    */
+    void append(const char *data, int n);
+    /**
+      \brief copies bytes without consuming them.
+      \param offset offset from the first byte.
+      \param to destination.
+      \param n bytes, offset + n must not exceed size().
+    */
+    void peek(int offset, char *to, int n) const;
+    /**
+      \brief byte at offset.
+      \param offset offset from the first byte, lower than size().
+      \return byte.
+    */
+    char at(int offset) const;
+    /**
+      \brief copies bytes into a new array without consuming them.
+      \param offset offset from the first byte.
+      \param n bytes.
+      \return copied bytes.
+    */
+    QByteArray mid(int offset, int n) const;
+    /**
+      \brief drops the first n bytes.
+      \param n bytes.
+    */
+    void consume(int n);
+    /**
+      \brief drops every byte.
+    */
+    void clear();
+    /**
+      \brief shrinks an empty ring back to ring_initial_size.
+    */
+    void squeeze();
+};
+
+#endif // RINGBUFFER_H
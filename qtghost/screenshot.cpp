@@ -0,0 +1,213 @@
+/*
+* MIT License
+*
+* Copyright (c) 2018 Antonio Alecrim Jr
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*/
+
+#include "screenshot.h"
+#include "tilehash.h"
+#include <QBuffer>
+#include <QDebug>
+#include <QFile>
+#include <QtConcurrent>
+#include <QtEndian>
+
+screenshotRequest::screenshotRequest()
+{
+    format = SCR_PNG;
+    level = -1;
+    keyframe = false;
+}
+
+ScreenshotPipeline::ScreenshotPipeline(QObject *parent) : QObject(parent)
+{
+    diffPool.setMaxThreadCount(1);
+}
+
+ScreenshotPipeline::~ScreenshotPipeline()
+{
+    foreach (const pendingFrame &job, pending) {
+        job.watcher->waitForFinished();
+        delete job.watcher;
+    }
+}
+
+void ScreenshotPipeline::encode(const QImage &frame, const screenshotRequest &request, const replyTarget &to)
+{
+    QFutureWatcher<QByteArray> *watcher = new QFutureWatcher<QByteArray>(this);
+    pendingFrame job = {"-c ", to, watcher, QSharedPointer<tileState>()};
+
+    connect(watcher, SIGNAL(finished()), SLOT(deliver()));
+    if (request.format == SCR_DIFF) {
+        job.state = diffStates.value(to.client);
+        if (!job.state) {
+            job.state = QSharedPointer<tileState>::create();
+            diffStates.insert(to.client, job.state);
+        }
+        watcher->setFuture(QtConcurrent::run(&diffPool, &ScreenshotPipeline::encodeDiff,
+                                             frame, request, job.state.data()));
+    }
+    else {
+        watcher->setFuture(QtConcurrent::run(&ScreenshotPipeline::encodeFrame, frame, request));
+    }
+    pending.append(job);
+}
+
+void ScreenshotPipeline::compare(const QImage &frame, const QImage &reference, const compareRequest &request, const replyTarget &to)
+{
+    QFutureWatcher<QByteArray> *watcher = new QFutureWatcher<QByteArray>(this);
+    pendingFrame job = {"-a ", to, watcher, QSharedPointer<tileState>()};
+
+    connect(watcher, SIGNAL(finished()), SLOT(deliver()));
+    pending.append(job);
+    watcher->setFuture(QtConcurrent::run(&VisualAssert::compare, frame, reference, request));
+}
+
+void ScreenshotPipeline::deliver()
+{
+    while (!pending.isEmpty() && pending.first().watcher->isFinished()) {
+        pendingFrame job = pending.takeFirst();
+        emit ready(job.cmd, job.watcher->result(), job.to);
+        job.watcher->deleteLater();
+    }
+}
+
+void ScreenshotPipeline::forget(int client)
+{
+    // a diff still being encoded keeps its own reference
+    diffStates.remove(client);
+}
+
+static QByteArray rawHeader(const char *magic, const QImage &image)
+{
+    QByteArray header(magic, 4);
+    uchar size[8];
+
+    qToLittleEndian<quint32>(static_cast<quint32>(image.width()), size);
+    qToLittleEndian<quint32>(static_cast<quint32>(image.height()), size + 4);
+    header.append(reinterpret_cast<const char *>(size), sizeof(size));
+
+    return header;
+}
+
+QByteArray ScreenshotPipeline::encodeFrame(QImage frame, screenshotRequest request)
+{
+    QByteArray ba;
+
+    if (!request.region.isNull()) {
+        frame = frame.copy(request.region.intersected(frame.rect()));
+    }
+
+    if (request.format == SCR_PNG || !request.cachePath.isEmpty()) {
+        // Qt maps PNG quality 0-100 to compression 9-0
+        int quality = request.level < 0 ? -1 : 100 - (qMin(request.level, 9) * 91 + 8) / 9;
+        QBuffer buffer(&ba);
+        buffer.open(QIODevice::WriteOnly);
+        frame.save(&buffer, "PNG", quality);
+
+        if (!request.cachePath.isEmpty()) {
+            QString tmp = request.cachePath+".tmp";
+            QFile file(tmp);
+            QFile::remove(request.cachePath);
+            if (file.open(QIODevice::WriteOnly) && file.write(ba) == ba.size()) {
+                file.close();
+                QFile::rename(tmp, request.cachePath);
+                qDebug() << "Qtghost: new screenshot at: " << request.cachePath;
+            }
+            else {
+                qDebug() << "Qtghost: failed to create a file at: " << request.cachePath;
+            }
+        }
+        if (request.format == SCR_PNG)
+            return ba;
+    }
+
+    QImage rgba = frame.convertToFormat(QImage::Format_RGBA8888);
+    QByteArray pixels;
+    pixels.reserve(rgba.width() * rgba.height() * 4);
+    for (int y = 0; y < rgba.height(); y++) {
+        pixels.append(reinterpret_cast<const char *>(rgba.constScanLine(y)), rgba.width() * 4);
+    }
+
+    if (request.format == SCR_FAST) {
+        return rawHeader("QGRZ", rgba) + qCompress(pixels, 1);
+    }
+
+    return rawHeader("QGRW", rgba) + pixels;
+}
+
+QByteArray ScreenshotPipeline::encodeDiff(QImage frame, screenshotRequest request, tileState *state)
+{
+    if (!request.region.isNull()) {
+        frame = frame.copy(request.region.intersected(frame.rect()));
+    }
+
+    QImage rgba = frame.convertToFormat(QImage::Format_RGBA8888);
+    QVector<quint64> hashes = hashTiles(rgba);
+    bool keyframe = request.keyframe || state->size != rgba.size();
+    int columns = (rgba.width() + tile_size - 1) / tile_size;
+    QByteArray index;
+    QByteArray pixels;
+    quint32 count = 0;
+    uchar value[4];
+
+    for (int i = 0; i < hashes.size(); i++) {
+        if (!keyframe && hashes.at(i) == state->hashes.at(i))
+            continue;
+        int tx = i % columns;
+        int ty = i / columns;
+        QRect tile = QRect(tx * tile_size, ty * tile_size, tile_size, tile_size).intersected(rgba.rect());
+        qToLittleEndian<quint16>(static_cast<quint16>(tx), value);
+        qToLittleEndian<quint16>(static_cast<quint16>(ty), value + 2);
+        index.append(reinterpret_cast<const char *>(value), 4);
+        for (int y = tile.top(); y <= tile.bottom(); y++) {
+            pixels.append(reinterpret_cast<const char *>(rgba.constScanLine(y)) + tile.left() * 4,
+                          tile.width() * 4);
+        }
+        count++;
+    }
+    state->size = rgba.size();
+    state->hashes = hashes;
+
+    QByteArray ba = rawHeader("QGTD", rgba);
+    qToLittleEndian<quint16>(static_cast<quint16>(tile_size), value);
+    value[2] = keyframe ? 1 : 0;
+    ba.append(reinterpret_cast<const char *>(value), 3);
+    qToLittleEndian<quint32>(count, value);
+    ba.append(reinterpret_cast<const char *>(value), 4);
+    ba.append(index);
+    ba.append(qCompress(pixels, 1));
+
+    return ba;
+}
+
+QRect ScreenshotPipeline::parseRegion(const QString &text)
+{
+    QStringList values = text.split(",");
+    bool ok = values.size() == 4;
+    int v[4] = {0, 0, 0, 0};
+
+    for (int i = 0; ok && i < 4; i++) {
+        v[i] = values.at(i).toInt(&ok);
+    }
+
+    return ok ? QRect(v[0], v[1], v[2], v[3]) : QRect();
+}
@@ -0,0 +1,153 @@
+/*
+* MIT License
+*
+* Copyright (c) 2018 Antonio Alecrim Jr
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*/
+
+#ifndef SCREENSHOT_H
+#define SCREENSHOT_H
+
+#include <QObject>
+#include <QImage>
+#include <QFutureWatcher>
+#include <QHash>
+#include <QList>
+#include <QRect>
+#include <QSharedPointer>
+#include <QThreadPool>
+#include <QVector>
+#include "protocol.h"
+#include "visualassert.h"
+
+///< \brief screenshot encodings.
+enum screenshotFormat {
+    SCR_PNG, ///< \brief PNG, see screenshotRequest::level.
+    SCR_RAW, ///< \brief "QGRW", u32 width, u32 height (little endian), RGBA8888 pixels.
+    SCR_FAST, ///< \brief "QGRZ", u32 width, u32 height, qCompress (u32 big endian size + zlib level 1) of RGBA8888 pixels.
+    SCR_DIFF ///< \brief "QGTD", only the tiles changed since the previous SCR_DIFF frame (see encodeDiff).
+};
+
+///< \brief how a screenshot is to be encoded.
+struct screenshotRequest {
+    screenshotFormat format; ///< \brief encoding.
+    int level; ///< \brief PNG compression level 0-9, negative for the default one.
+    QRect region; ///< \brief sub-rectangle to be sent, null for the whole frame.
+    QString cachePath; ///< \brief if not empty, the PNG is also saved there (debug).
+    bool keyframe; ///< \brief SCR_DIFF: send every tile.
+
+    screenshotRequest();
+};
+
+///< \brief what the client got from the previous SCR_DIFF frame.
+struct tileState {
+    QSize size; ///< \brief frame size.
+    QVector<quint64> hashes; ///< \brief tile hashes (see tilehash.h).
+};
+
+///< \brief a frame being encoded or compared.
+struct pendingFrame {
+    QString cmd; ///< \brief reply command.
+    replyTarget to; ///< \brief where the reply goes.
+    QFutureWatcher<QByteArray> *watcher; ///< \brief worker result.
+    QSharedPointer<tileState> state; ///< \brief SCR_DIFF: client tiles, kept alive while encoding.
+};
+
+/**
+  \brief encodes or compares grabbed frames on worker threads.
+
+  Frames must be grabbed on the GUI thread, everything else (crop, conversion,
+  encoding, comparison, cache file) runs on the global thread pool. Results are
+  delivered in request order through ready().
+*/
+class ScreenshotPipeline : public QObject
+{
+    Q_OBJECT
+
+    QList<pendingFrame> pending; ///< \brief requests being processed, in request order.
+    QThreadPool diffPool; ///< \brief one thread, SCR_DIFF frames depend on the previous one.
+    QHash<int, QSharedPointer<tileState> > diffStates; ///< \brief per client, the states are only accessed from diffPool.
+
+public:
+    explicit ScreenshotPipeline(QObject *parent = nullptr);
+    ~ScreenshotPipeline();
+    /**
+      \brief queues a grabbed frame to be encoded.
+      \param frame grabbed frame.
+      \param request encoding options.
+      \param to where the screenshot goes, SCR_DIFF frames are diffed per client.
+    */
+    void encode(const QImage &frame, const screenshotRequest &request, const replyTarget &to);
+    /**
+      \brief queues a grabbed frame to be compared to a reference image (see VisualAssert).
+      \param frame grabbed frame.
+      \param reference reference image.
+      \param request comparison options.
+      \param to where the result goes.
+    */
+    void compare(const QImage &frame, const QImage &reference, const compareRequest &request, const replyTarget &to);
+    /**
+      \brief drops the SCR_DIFF state of a client, its next diff frame is a keyframe.
+      \param client client id.
+    */
+    void forget(int client);
+    /**
+      \brief encodes a frame, runs on a worker thread.
+      \param frame grabbed frame.
+      \param request encoding options.
+      \return encoded screenshot.
+    */
+    static QByteArray encodeFrame(QImage frame, screenshotRequest request);
+    /**
+      \brief encodes the tiles changed since the previous frame, runs on diffPool.
+
+      "QGTD", u32 width, u32 height, u16 tile size, u8 flags (1: keyframe), u32 tile count,
+      tile count times (u16 column, u16 row), then qCompress'ed RGBA8888 pixels of those
+      tiles, one after the other (tiles on the right/bottom edges may be smaller).
+      \param frame grabbed frame.
+      \param request encoding options.
+      \param state tiles of the previous frame, updated.
+      \return encoded screenshot.
+    */
+    static QByteArray encodeDiff(QImage frame, screenshotRequest request, tileState *state);
+    /**
+      \brief parses a "x,y,w,h" region.
+      \param text region text.
+      \return region, null if text is not valid.
+    */
+    static QRect parseRegion(const QString &text);
+
+signals:
+    /**
+      \brief emitted when a frame is processed, in request order.
+      \param cmd reply command, "-c " for screenshots and "-a " for comparisons.
+      \param data encoded screenshot or comparison result.
+      \param to where the reply goes.
+    */
+    void ready(QString cmd, QByteArray data, replyTarget to);
+
+private slots:
+    /**
+      \brief delivers the finished results at the head of the queue.
+    */
+    void deliver();
+};
+
+#endif // SCREENSHOT_H
@@ -25,11 +25,13 @@
 #include "server.h"
 #include <QtNetwork>
 #include <QtCore>
+#include <QtEndian>
+#include <QLocalSocket>
 
 Server::Server(QObject *parent, quint16 port) : QObject(parent)
 {
-    bLength = 0;
     portI = port;
+    nextClientId = 1;
     QNetworkConfigurationManager manager;
 
     if (manager.capabilities() & QNetworkConfigurationManager::NetworkSessionRequired) {
@@ -54,10 +56,25 @@ Server::Server(QObject *parent, quint16 port) : QObject(parent)
     } else {
         sessionOpened();
     }
-    tcpServer->setMaxPendingConnections(1); //by design: one client
     connect(tcpServer, &QTcpServer::newConnection, this, &Server::newConnection);
 }
 
+Server::Server(QObject *parent, const QString &name) : QObject(parent)
+{
+    portI = 0;
+    nextClientId = 1;
+    localServer = new QLocalServer(this);
+    // only the user running the app can connect
+    localServer->setSocketOptions(QLocalServer::UserAccessOption);
+    QLocalServer::removeServer(name);
+    if (!localServer->listen(name)) {
+        qDebug() << "Qtghost:" << "Unable to start the local server: "+localServer->errorString();
+
+        exit(1);
+    }
+    connect(localServer, &QLocalServer::newConnection, this, &Server::newLocalConnection);
+    qDebug() << "Qtghost:" << tr("server is running on local socket: %1").arg(localServer->fullServerName());
+}
 
 void Server::sessionOpened()
 {
@@ -114,82 +131,319 @@ void Server::sessionOpened()
 void Server::newConnection()
 {
     while (tcpServer->hasPendingConnections()) {
-        socket = tcpServer->nextPendingConnection();
-        connect(socket, SIGNAL(readyRead()), SLOT(readyRead()));
-        connect(socket, SIGNAL(disconnected()), SLOT(disconnected()));
+        addClient(tcpServer->nextPendingConnection());
     }
 }
 
-int Server::getPacketLength(QByteArray *buffer)
+void Server::newLocalConnection()
+{
+    while (localServer->hasPendingConnections()) {
+        addClient(localServer->nextPendingConnection());
+    }
+}
+
+void Server::addClient(QIODevice *socket)
+{
+    int id = nextClientId++;
+    Connection *client = new Connection(id, socket, this);
+
+    clients.insert(id, client);
+    connect(client, SIGNAL(dataReceived(QByteArray,int)), SIGNAL(dataReceived(QByteArray,int)));
+    connect(client, SIGNAL(requestReceived(QByteArray,int)), SIGNAL(requestReceived(QByteArray,int)));
+    connect(client, SIGNAL(closed(int)), SLOT(closed(int)));
+    qDebug() << "Qtghost:" << "client" << id << "connected," << clients.size() << "connected";
+}
+
+void Server::closed(int client)
 {
-    int length = 0;
-    int index = buffer->indexOf(":");
+    Connection *connection = clients.take(client);
 
-    if (index > 0) {
-        length = QString(buffer->left(index)).toInt();
-        buffer->remove(0, index+1);
+    if (connection) {
+        connection->deleteLater();
+        emit clientDisconnected(client);
     }
+}
 
-    return length;
+int Server::clientCount() const
+{
+    return clients.size();
 }
 
-void Server::readyRead()
+void Server::sendRec(QString cmd, QByteArray data, const replyTarget &to)
 {
-    while (socket->bytesAvailable() > 0)
-    {
-        QByteArray tmpBuffer;
-        do {
-            tmpBuffer = socket->readAll();
-            if (!buffer.length()) {
-                bLength = getPacketLength(&tmpBuffer);
-            }
-            buffer.append(tmpBuffer);
-
-            if (buffer.length() > 0 && buffer.length() >= bLength) {
-                qDebug() << "Qtghost:" << "received length: " << buffer.length();
-                emit dataReceived(buffer.left(bLength));
-                buffer.remove(0, bLength);
-                if (buffer.length() > 0) {
-                    bLength = getPacketLength(&buffer);
-                }
-            }
+    outFrame frame;
+    frame.cmd = cmd;
+    frame.data = data;
+    frame.source = nullptr;
+    frame.request = to.request;
 
-        } while(tmpBuffer.size() > 0);
+    if (to.client == all_clients) {
+        // QByteArray is implicitly shared, data is not copied per client
+        foreach (Connection *connection, clients) {
+            connection->send(frame);
+        }
+    }
+    else if (clients.contains(to.client)) {
+        clients.value(to.client)->send(frame);
     }
 }
 
-void Server::disconnected()
+void Server::sendStream(QString cmd, StreamSource *source, const replyTarget &to)
 {
-    //qDebug() << "Qtghost:" << "client disconnected";
-    bLength = 0;
-    buffer.clear();
+    if (!clients.contains(to.client)) {
+        delete source;
+        return;
+    }
+
+    outFrame frame;
+    frame.cmd = cmd;
+    frame.source = source;
+    frame.request = to.request;
+    clients.value(to.client)->send(frame);
 }
 
-void Server::sendRec(QString cmd, QByteArray data)
+Connection::Connection(int id, QIODevice *client, QObject *parent) : QObject(parent)
 {
-    qint64 xfered = 0;
-    int dLength =  data.length();
-    qint64 status;
-    QString header = QString::number(dLength)+":"+cmd;
+    socket = client;
+    socket->setParent(this);
+    clientId = id;
+    framing = FRAMING_UNKNOWN;
+    paused = false;
+    outOffset = 0;
+    outBytes = 0;
+    // don't let Qt buffer unboundedly while commands are paused
+    if (QAbstractSocket *tcp = qobject_cast<QAbstractSocket*>(socket))
+        tcp->setReadBufferSize(socket_read_buffer);
+    else if (QLocalSocket *local = qobject_cast<QLocalSocket*>(socket))
+        local->setReadBufferSize(socket_read_buffer);
+    connect(socket, SIGNAL(readyRead()), SLOT(readyRead()));
+    connect(socket, SIGNAL(disconnected()), SLOT(disconnected()));
+    connect(socket, SIGNAL(bytesWritten(qint64)), SLOT(pump()));
+}
+
+Connection::~Connection()
+{
+    clearOutQueue();
+}
 
-    data.prepend(header.toStdString().c_str()); //adding header
+int Connection::id() const
+{
+    return clientId;
+}
 
-    while (data.size()) {
-        if (data.size() >= buffer_size)
-            status = socket->write(data, buffer_size);
+void Connection::readyRead()
+{
+    QByteArray packet;
+
+    if (paused)
+        return;
+    while (socket->bytesAvailable() > 0) {
+        int length;
+        if (in.size() == in.capacity())
+            in.reserve(ring_initial_size);
+        char *to = in.writePointer(&length);
+        qint64 status = socket->read(to, length);
+        if (status <= 0)
+            break;
+        in.commit(static_cast<int>(status));
+    }
+    while (nextPacket(&packet)) {
+        if (framing == FRAMING_RPC)
+            emit requestReceived(packet, clientId);
         else
-            status = socket->write(data, data.size());
-        if (status >= 0) {
-            xfered += status;
-            data.remove(0, status);
+            emit dataReceived(packet, clientId);
+        packet.clear();
+        if (outBytes > read_pause_watermark) {
+            // the client doesn't read its responses, stop taking commands
+            paused = true;
+            return;
+        }
+    }
+    if (!in.size())
+        in.squeeze();
+}
+
+qint64 Connection::packetLength(int *headSize) const
+{
+    if (framing == FRAMING_BINARY || framing == FRAMING_RPC) {
+        uchar size[4];
+        if (in.size() < 4)
+            return -1;
+        in.peek(0, reinterpret_cast<char*>(size), 4);
+        *headSize = 4;
+        return qFromLittleEndian<quint32>(size);
+    }
+
+    // "<length>:", parsed in place
+    qint64 length = 0;
+    for (int i = 0; i < in.size(); i++) {
+        char c = in.at(i);
+        if (c == ':' && i > 0) {
+            *headSize = i + 1;
+            return length;
+        }
+        if (c < '0' || c > '9' || i >= 10)
+            return -2;
+        length = length * 10 + (c - '0');
+    }
+
+    return -1;
+}
+
+bool Connection::nextPacket(QByteArray *packet)
+{
+    int magicSize = sizeof(binary_framing_magic) - 1;
+    int headSize = 0;
+
+    if (framing == FRAMING_UNKNOWN) {
+        // the magics can't be mistaken for a text length, they only differ by their last byte
+        int i = 0;
+        while (i < in.size() && i < magicSize - 1 && in.at(i) == binary_framing_magic[i]) {
+            i++;
+        }
+        if (i == in.size())
+            return false;
+        if (i == magicSize - 1 && (in.at(i) == binary_framing_magic[i] || in.at(i) == rpc_magic[i])) {
+            framing = in.at(i) == rpc_magic[i] ? FRAMING_RPC : FRAMING_BINARY;
+            socket->write(framing == FRAMING_RPC ? rpc_magic : binary_framing_magic, magicSize);
+            in.consume(magicSize);
         }
         else {
+            framing = FRAMING_TEXT;
+        }
+    }
+
+    qint64 length = packetLength(&headSize);
+    if (length == -1)
+        return false;
+    if (length < 0 || length > max_packet_size) {
+        qDebug() << "Qtghost:" << "invalid packet from client" << clientId << ", disconnecting";
+        in.clear();
+        if (QAbstractSocket *tcp = qobject_cast<QAbstractSocket*>(socket))
+            tcp->abort();
+        else if (QLocalSocket *local = qobject_cast<QLocalSocket*>(socket))
+            local->abort();
+        return false;
+    }
+    // make room for the whole packet, the ring grows at most once per big packet
+    in.reserve(static_cast<int>(headSize + length - in.size()));
+    if (in.size() < headSize + length)
+        return false;
+
+    if (length >= buffer_size) {
+        qDebug() << "Qtghost:" << "received length: " << length << "from client" << clientId;
+    }
+    *packet = in.mid(headSize, static_cast<int>(length));
+    in.consume(static_cast<int>(headSize + length));
+
+    return true;
+}
+
+void Connection::disconnected()
+{
+    //qDebug() << "Qtghost:" << "client disconnected";
+    in.clear();
+    clearOutQueue();
+    emit closed(clientId);
+}
+
+QByteArray Connection::header(QString cmd, int length, quint32 request) const
+{
+    if (framing == FRAMING_RPC) {
+        QByteArray head(10, Qt::Uninitialized);
+        uchar *to = reinterpret_cast<uchar*>(head.data());
+        qToLittleEndian<quint32>(static_cast<quint32>(6 + length), to);
+        qToLittleEndian<quint32>(request, to + 4);
+        to[8] = opcodeForCommand(cmd);
+        to[9] = cmd.trimmed().endsWith('+') ? RPC_MORE : 0;
+        return head;
+    }
+    if (framing == FRAMING_BINARY) {
+        QByteArray command = cmd.toUtf8();
+        QByteArray head(4, Qt::Uninitialized);
+        qToLittleEndian<quint32>(static_cast<quint32>(command.size() + length),
+                                 reinterpret_cast<uchar*>(head.data()));
+        return head + command;
+    }
+
+    return (QString::number(length)+":"+cmd).toUtf8();
+}
+
+void Connection::clearOutQueue()
+{
+    foreach (const outFrame &frame, outQueue) {
+        delete frame.source;
+    }
+    outQueue.clear();
+    outOffset = 0;
+    outBytes = 0;
+}
+
+void Connection::send(outFrame frame)
+{
+    if (!frame.source) {
+        frame.head = header(frame.cmd, frame.data.length(), frame.request);
+        outBytes += frame.head.size() + frame.data.size();
+    }
+    outQueue.append(frame);
+    pump();
+}
+
+void Connection::pump()
+{
+    while (!outQueue.isEmpty() &&
+           socket->bytesToWrite() < write_high_watermark) {
+        outFrame &frame = outQueue.first();
+        int headSize = frame.head.size();
+        int frameSize = headSize + frame.data.size();
+
+        if (outOffset >= frameSize) {
+            outBytes -= frameSize;
+            if (!frame.source) {
+                if (frame.data.size() >= buffer_size) {
+                    qDebug() << "Qtghost:" << frameSize << "transfered from data length " << frame.data.size();
+                }
+                outQueue.removeFirst();
+                outOffset = 0;
+                continue;
+            }
+            // previous chunk is on its way, produce the next one
+            QString cmd = frame.cmd;
+            frame.data.clear();
+            if (frame.source->next(&frame.data)) {
+                cmd = cmd.trimmed()+"+ ";
+            }
+            else {
+                delete frame.source;
+                frame.source = nullptr;
+            }
+            frame.head = header(cmd, frame.data.length(), frame.request);
+            outBytes += frame.head.size() + frame.data.size();
+            outOffset = 0;
+            continue;
+        }
+
+        const char *from;
+        qint64 length;
+        if (outOffset < headSize) {
+            from = frame.head.constData() + outOffset;
+            length = headSize - outOffset;
+        }
+        else {
+            from = frame.data.constData() + (outOffset - headSize);
+            length = frameSize - outOffset;
+        }
+        qint64 status = socket->write(from, qMin(length, write_high_watermark));
+        if (status < 0) {
             qDebug() << "Qtghost:" << "error during " << __FUNCTION__;
+            clearOutQueue();
 
             return;
         }
+        outOffset += static_cast<int>(status);
     }
-    if (xfered) {
-        qDebug() << "Qtghost:" << xfered << "transfered from data length " << dLength;
+    if (paused && outBytes <= read_pause_watermark / 2) {
+        paused = false;
+        QMetaObject::invokeMethod(this, "readyRead", Qt::QueuedConnection);
     }
 }
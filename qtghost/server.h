@@ -27,20 +27,161 @@
 
 #include <QObject>
 #include <QTcpServer>
+#include <QLocalServer>
 #include <QNetworkSession>
+#include <QHash>
 #include <QDebug>
+#include "ringbuffer.h"
+#include "protocol.h"
 
 const short buffer_size = 4096;
+const qint64 write_high_watermark = 256 * 1024; ///< \brief stop feeding the socket above this.
+const qint64 socket_read_buffer = 1024 * 1024; ///< \brief bytes Qt buffers per socket, socket flow control does the rest.
+const qint64 read_pause_watermark = 8 * 1024 * 1024; ///< \brief stop processing commands while more than this is queued for the client.
+const int max_packet_size = 256 * 1024 * 1024; ///< \brief bigger packets drop the connection.
+const char binary_framing_magic[] = "QGB\x01"; ///< \brief sent first by a client to use binary framing, echoed back (see also rpc_magic).
+
+///< \brief how packets are delimited on a connection.
+enum framingMode {
+    FRAMING_UNKNOWN, ///< \brief nothing received yet.
+    FRAMING_TEXT, ///< \brief "<length>:<payload>" requests, "<length>:<cmd> <data>" responses (length of data).
+    FRAMING_BINARY, ///< \brief u32 little endian length then payload, both ways ("<cmd> <data>" for responses).
+    FRAMING_RPC ///< \brief protocol v2, binary framing with opcodes and request ids (see protocol.h).
+};
+
+/**
+  \brief produces a response in chunks, so it never has to be fully in memory.
+*/
+class StreamSource
+{
+public:
+    virtual ~StreamSource(){}
+    /**
+      \brief appends the next chunk of data.
+      \param chunk buffer to append to.
+      \return true if more chunks follow, false if this was the last one.
+    */
+    virtual bool next(QByteArray *chunk) = 0;
+};
+
+///< \brief a response waiting to be written.
+struct outFrame {
+    QString cmd; ///< \brief packet command.
+    QByteArray head; ///< \brief packet header of data, set by the connection.
+    QByteArray data; ///< \brief packet data (current chunk for streamed responses).
+    StreamSource *source; ///< \brief chunk producer for streamed responses.
+    quint32 request; ///< \brief protocol v2 request id.
+};
+
+/**
+  \brief one connected client: its socket (TCP or local), framing state and response queue.
+*/
+class Connection : public QObject
+{
+    QIODevice *socket; ///< \brief QTcpSocket or QLocalSocket, owned.
+    int clientId; ///< \brief client id, unique for the server lifetime.
+    RingBuffer in; ///< \brief received data, parsed in place.
+    framingMode framing; ///< \brief negotiated from the first received bytes.
+    bool paused; ///< \brief commands are not processed until outQueue drains.
+    QList<outFrame> outQueue; ///< \brief responses waiting for the socket to drain.
+    int outOffset; ///< \brief bytes of outQueue head already written.
+    qint64 outBytes; ///< \brief bytes queued in outQueue (not counting streams).
+
+    /**
+      \brief drops every pending response.
+    */
+    void clearOutQueue();
+    /**
+      \brief takes the next complete packet out of the receive ring.
+      \param packet packet payload, output.
+      \return false if no complete packet is buffered, or on a framing error (connection aborted).
+    */
+    bool nextPacket(QByteArray *packet);
+    /**
+      \brief parses a packet header at the start of the receive ring.
+      \param headSize header length, output.
+      \return payload length, -1 if the header is incomplete, -2 if it is invalid.
+    */
+    qint64 packetLength(int *headSize) const;
+    /**
+      \brief builds a packet header for this connection framing.
+      \param cmd packet command.
+      \param length data length.
+      \param request protocol v2 request id.
+      \return header bytes.
+    */
+    QByteArray header(QString cmd, int length, quint32 request) const;
+
+    Q_OBJECT
+public:
+    /**
+      \brief Connection Class constructor.
+      \param id client id.
+      \param client connected socket, ownership is taken.
+      \param parent object parent.
+    */
+    Connection(int id, QIODevice *client, QObject *parent = nullptr);
+    ~Connection();
+    /**
+      \brief client id.
+      \return id.
+    */
+    int id() const;
+    /**
+      \brief queues a response to this client.
+      \param frame response, ownership of frame.source is taken.
+    */
+    void send(outFrame frame);
+
+signals:
+    /**
+     \brief when a complete packet is received.
+     \param data packet data.
+     \param client id of the client that sent it.
+    !*/
+    void dataReceived(QByteArray data, int client);
+    /**
+     \brief when a complete protocol v2 request is received.
+     \param data request: u8 opcode, u32 request id, arguments.
+     \param client id of the client that sent it.
+    !*/
+    void requestReceived(QByteArray data, int client);
+    /**
+      \brief when the client disconnects.
+      \param client client id.
+    */
+    void closed(int client);
+
+private slots:
+    /**
+      \brief when there's new data to be read from the client, also called to resume after a pause.
+    */
+    void readyRead();
+    /**
+      \brief when the client disconnects.
+    */
+    void disconnected();
+    /**
+      \brief writes queued responses while the socket is below write_high_watermark.
+    */
+    void pump();
+};
 
 class Server : public QObject
 {
     QTcpServer *tcpServer = nullptr; ///< \brief tcp server class.
-    QTcpSocket *socket; ///< \brief tcp socket.
+    QLocalServer *localServer = nullptr; ///< \brief local (Unix domain socket, named pipe) server, instead of tcpServer.
     QNetworkSession *networkSession = nullptr; ///< \brief if a networkSession is required.
 
-    QByteArray buffer; ///< \brief to store received data until is complete.
-    qint64 bLength; ///< \brief current transfer size.
     quint16 portI; ///< \brief server port
+    QHash<int, Connection*> clients; ///< \brief connected clients by id.
+    int nextClientId; ///< \brief id of the next connected client.
+
+    /**
+      \brief starts serving a newly connected socket.
+      \param socket QTcpSocket or QLocalSocket, ownership is taken.
+    */
+    void addClient(QIODevice *socket);
 
     Q_OBJECT
 public:
@@ -51,24 +192,51 @@ public:
     */
     explicit Server(QObject *parent = nullptr, quint16 port = 0);
     /**
-      \brief to send data to connected client.
+      \brief Server Class constructor, local transport: same framing and commands, no TCP.
+      \param parent object parent.
+      \param name local socket name (created in the temp dir) or full path, a stale socket is removed.
+    */
+    Server(QObject *parent, const QString &name);
+    /**
+      \brief to send data to connected clients.
       \param data data to send.
       \param cmd packet command.
+      \param to client id (all_clients to send it to every connected client) and request id.
     */
-    void sendRec(QString cmd, QByteArray data);
+    void sendRec(QString cmd, QByteArray data, const replyTarget &to = replyTarget());
     /**
-      \brief get packet length
-      \param buffer buffer pointer
-      \return packet length
+      \brief to send a response produced in chunks (see StreamSource).
+      Each chunk is sent as a packet whose command has a '+' appended
+      ("-j+ ") while more chunks follow; the last chunk uses cmd as is.
+      \param cmd packet command.
+      \param source chunk producer, ownership is taken.
+      \param to client id and request id, a stream goes to one client only.
     */
-    int getPacketLength(QByteArray *buffer);
+    void sendStream(QString cmd, StreamSource *source, const replyTarget &to);
+    /**
+      \brief number of connected clients.
+      \return client count.
+    */
+    int clientCount() const;
 
 signals:
     /**
-     \brief when a new data is received from a socket.
+     \brief when a new data is received from a client.
      \param QByteArray data that was received.
+     \param int id of the client that sent it.
+    !*/
+    void dataReceived(QByteArray, int);
+    /**
+     \brief when a protocol v2 request is received from a client.
+     \param QByteArray request: u8 opcode, u32 request id, arguments.
+     \param int id of the client that sent it.
     !*/
-    void dataReceived(QByteArray);
+    void requestReceived(QByteArray, int);
+    /**
+      \brief when a client disconnects, its pending responses are dropped.
+      \param client client id.
+    */
+    void clientDisconnected(int client);
 
 private slots:
     /**
@@ -80,13 +248,14 @@ private slots:
     */
     void newConnection();
     /**
-      \brief when there's new data to be read from a client.
+      \brief when a new local connection is received.
     */
-    void readyRead();
+    void newLocalConnection();
     /**
       \brief when a client disconnects.
+      \param client client id.
     */
-    void disconnected();
+    void closed(int client);
 };
 
 #endif // SERVER_H
@@ -0,0 +1,113 @@
+/*
+* MIT License
+*
+* Copyright (c) 2018 Antonio Alecrim Jr
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*/
+
+#include "tilehash.h"
+#include <cstring>
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define TILEHASH_SSE2
+#endif
+
+static const quint64 key_lo = 0x9e3779b185ebca87ULL;
+static const quint64 key_hi = 0xc2b2ae3d27d4eb4fULL;
+
+static inline quint64 mix(quint64 h)
+{
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ULL;
+    h ^= h >> 33;
+
+    return h;
+}
+
+// one 16 bytes step on two 64 bits lanes (xxh3 style accumulate)
+static inline void accumulate(quint64 acc[2], quint64 lo, quint64 hi)
+{
+    quint64 klo = lo ^ key_lo;
+    quint64 khi = hi ^ key_hi;
+
+    acc[0] += hi + (klo & 0xffffffffULL) * (klo >> 32);
+    acc[1] += lo + (khi & 0xffffffffULL) * (khi >> 32);
+}
+
+quint64 hashRect(const uchar *bits, int stride, const QRect &rect)
+{
+    quint64 acc[2] = {key_hi, key_lo};
+    int rowBytes = rect.width() * 4;
+    int blocks = rowBytes / 16;
+
+    for (int y = rect.top(); y <= rect.bottom(); y++) {
+        const uchar *line = bits + static_cast<qptrdiff>(y) * stride + rect.left() * 4;
+        int b = 0;
+#ifdef TILEHASH_SSE2
+        __m128i vacc = _mm_set_epi64x(static_cast<qint64>(acc[1]), static_cast<qint64>(acc[0]));
+        const __m128i key = _mm_set_epi64x(static_cast<qint64>(key_hi), static_cast<qint64>(key_lo));
+        for (; b < blocks; b++) {
+            __m128i data = _mm_loadu_si128(reinterpret_cast<const __m128i *>(line + b * 16));
+            __m128i keyed = _mm_xor_si128(data, key);
+            __m128i product = _mm_mul_epu32(keyed, _mm_shuffle_epi32(keyed, _MM_SHUFFLE(3, 3, 1, 1)));
+            __m128i swapped = _mm_shuffle_epi32(data, _MM_SHUFFLE(1, 0, 3, 2));
+            vacc = _mm_add_epi64(vacc, _mm_add_epi64(product, swapped));
+        }
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(acc), vacc);
+#endif
+        for (; b < blocks; b++) {
+            quint64 lo, hi;
+            std::memcpy(&lo, line + b * 16, 8);
+            std::memcpy(&hi, line + b * 16 + 8, 8);
+            accumulate(acc, lo, hi);
+        }
+        // remaining pixels (rows not multiple of 4 pixels)
+        for (int x = blocks * 16; x < rowBytes; x += 4) {
+            quint32 pixel;
+            std::memcpy(&pixel, line + x, 4);
+            accumulate(acc, pixel, static_cast<quint64>(x));
+        }
+    }
+
+    return mix(acc[0] ^ mix(acc[1] + static_cast<quint64>(rect.width()) * rect.height()));
+}
+
+QVector<quint64> hashTiles(const QImage &image)
+{
+    int columns = (image.width() + tile_size - 1) / tile_size;
+    int rows = (image.height() + tile_size - 1) / tile_size;
+    QVector<quint64> hashes(columns * rows);
+
+    for (int ty = 0; ty < rows; ty++) {
+        for (int tx = 0; tx < columns; tx++) {
+            QRect tile = QRect(tx * tile_size, ty * tile_size, tile_size, tile_size).intersected(image.rect());
+            hashes[ty * columns + tx] = hashRect(image.constBits(), image.bytesPerLine(), tile);
+        }
+    }
+
+    return hashes;
+}
+
+quint64 hashImage(const QImage &image)
+{
+    return hashRect(image.constBits(), image.bytesPerLine(), image.rect());
+}
@@ -0,0 +1,57 @@
+/*
+* MIT License
+*
+* Copyright (c) 2018 Antonio Alecrim Jr
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*/
+
+#ifndef TILEHASH_H
+#define TILEHASH_H
+
+#include <QImage>
+#include <QVector>
+
+const int tile_size = 64; ///< \brief tile width and height in pixels.
+
+/**
+  \brief 64 bits hash of a rectangle of 32 bits pixels.
+
+  Uses SSE2 (16 bytes per step) when available, with a scalar fallback; both
+  give the same result. Meant for change detection, not cryptography.
+  \param bits first pixel of the image.
+  \param stride bytes per image line.
+  \param rect rectangle to be hashed, in pixels.
+  \return hash.
+*/
+quint64 hashRect(const uchar *bits, int stride, const QRect &rect);
+/**
+  \brief hashes every tile_size x tile_size tile of a 32 bits image.
+  \param image image (RGBA8888, ARGB32...).
+  \return hashes, row by row.
+*/
+QVector<quint64> hashTiles(const QImage &image);
+/**
+  \brief hashes a whole 32 bits image.
+  \param image image.
+  \return hash.
+*/
+quint64 hashImage(const QImage &image);
+
+#endif // TILEHASH_H
@@ -0,0 +1,271 @@
+/*
+* MIT License
+*
+* Copyright (c) 2018 Antonio Alecrim Jr
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*/
+
+#include "touchtrack.h"
+#include <QWindow>
+
+/**
+  \brief builds a touch record.
+  \param type TouchBegin, TouchUpdate, TouchEnd or TouchCancel.
+  \param slot point slot.
+  \param pos point position.
+  \param time time the point was observed (ms).
+  \return record.
+*/
+static recEvent touch_record(QEvent::Type type, int slot, const QPointF &pos, qint64 time)
+{
+    recEvent rec;
+
+    rec.pos = pos;
+    rec.time = static_cast<int>(time);
+    rec.type = type;
+    rec.argI = slot;
+
+    return rec;
+}
+
+/**
+  \brief flags all records of a touch event but the last one and moves them out.
+  \param frame records of one touch event, cleared.
+  \param out records to be stored, appended.
+*/
+static void store_frame(QVector<recEvent> *frame, QVector<recEvent> *out)
+{
+    for (int i = 0; i < frame->size() - 1; i++) {
+        (*frame)[i].argI |= touch_frame_more;
+    }
+    *out += *frame;
+    frame->clear();
+}
+
+TouchRecorder::TouchRecorder()
+{
+    interval = 0;
+    pendingTime = 0;
+    lastFrame = 0;
+}
+
+void TouchRecorder::setCoalescing(int ms)
+{
+    interval = qMax(ms, 0);
+}
+
+int TouchRecorder::coalescing() const
+{
+    return interval;
+}
+
+void TouchRecorder::reset()
+{
+    slots.clear();
+    positions.clear();
+    pending.clear();
+    pendingTime = 0;
+    lastFrame = 0;
+}
+
+int TouchRecorder::free_slot() const
+{
+    int slot = 0;
+
+    while (positions.contains(slot) && slot < touch_slot_mask)
+        slot++;
+
+    return slot;
+}
+
+bool TouchRecorder::add(const QTouchEvent *event, qint64 now, QVector<recEvent> *out)
+{
+    QVector<recEvent> frame;
+    bool movesOnly = true;
+
+    if (event->type() == QEvent::TouchCancel) {
+        pending.clear();
+        slots.clear();
+        positions.clear();
+        frame.append(touch_record(QEvent::TouchCancel, 0, QPointF(), now));
+        store_frame(&frame, out);
+        lastFrame = now;
+        return false;
+    }
+
+    foreach (const QTouchEvent::TouchPoint &point, event->touchPoints()) {
+        if (point.state() & (Qt::TouchPointPressed | Qt::TouchPointReleased))
+            movesOnly = false;
+    }
+    // presses and releases are stored as they come, after the moves they follow
+    if (!movesOnly)
+        flush(out);
+
+    foreach (const QTouchEvent::TouchPoint &point, event->touchPoints()) {
+        QPointF pos(qRound(point.pos().x()), qRound(point.pos().y()));
+        int slot = slots.value(point.id(), -1);
+
+        switch (point.state()) {
+        case Qt::TouchPointPressed:
+            if (slot < 0) {
+                slot = free_slot();
+                slots.insert(point.id(), slot);
+            }
+            positions.insert(slot, pos);
+            frame.append(touch_record(QEvent::TouchBegin, slot, pos, now));
+            break;
+        case Qt::TouchPointMoved:
+            // points pressed before the recording started are ignored, so are sub pixel moves
+            if (slot < 0 || pending.value(slot, positions.value(slot)) == pos)
+                break;
+            if (interval && movesOnly) {
+                pending.insert(slot, pos);
+                pendingTime = now;
+            }
+            else {
+                positions.insert(slot, pos);
+                frame.append(touch_record(QEvent::TouchUpdate, slot, pos, now));
+            }
+            break;
+        case Qt::TouchPointReleased:
+            if (slot < 0)
+                break;
+            slots.remove(point.id());
+            positions.remove(slot);
+            frame.append(touch_record(QEvent::TouchEnd, slot, pos, now));
+            break;
+        default:
+            // stationary, the player keeps it
+            break;
+        }
+    }
+
+    if (!frame.isEmpty()) {
+        store_frame(&frame, out);
+        lastFrame = now;
+    }
+    if (!pending.isEmpty() && now - lastFrame >= interval)
+        flush(out);
+
+    return !pending.isEmpty();
+}
+
+void TouchRecorder::flush(QVector<recEvent> *out)
+{
+    QVector<recEvent> frame;
+
+    if (pending.isEmpty())
+        return;
+    for (QMap<int, QPointF>::const_iterator it = pending.constBegin(); it != pending.constEnd(); ++it) {
+        positions.insert(it.key(), it.value());
+        frame.append(touch_record(QEvent::TouchUpdate, it.key(), it.value(), pendingTime));
+    }
+    pending.clear();
+    store_frame(&frame, out);
+    lastFrame = pendingTime;
+}
+
+TouchPlayer::TouchPlayer()
+{
+    cancelled = false;
+}
+
+void TouchPlayer::reset()
+{
+    points.clear();
+    cancelled = false;
+}
+
+bool TouchPlayer::add(const recEvent &ev)
+{
+    if (ev.type == QEvent::TouchCancel) {
+        cancelled = true;
+        return true;
+    }
+
+    int slot = ev.argI & touch_slot_mask;
+    bool known = points.contains(slot);
+    QTouchEvent::TouchPoint point = known ? points.value(slot) : QTouchEvent::TouchPoint(slot);
+    Qt::TouchPointState state = Qt::TouchPointMoved;
+
+    if (ev.type == QEvent::TouchEnd)
+        state = Qt::TouchPointReleased;
+    else if (ev.type == QEvent::TouchBegin || !known) // a play can start in the middle of a gesture
+        state = Qt::TouchPointPressed;
+
+    if (state == Qt::TouchPointPressed) {
+        point.setStartPos(ev.pos);
+        point.setStartScenePos(ev.pos);
+        point.setLastPos(ev.pos);
+        point.setLastScenePos(ev.pos);
+    }
+    else {
+        point.setLastPos(point.pos());
+        point.setLastScenePos(point.scenePos());
+    }
+    point.setPos(ev.pos);
+    point.setScenePos(ev.pos);
+    point.setState(state);
+    point.setPressure(state == Qt::TouchPointReleased ? 0 : 1);
+    points.insert(slot, point);
+
+    return !(ev.argI & touch_frame_more);
+}
+
+QTouchEvent *TouchPlayer::take(QTouchDevice *device, QWindow *window, ulong timestamp)
+{
+    QList<QTouchEvent::TouchPoint> list;
+    Qt::TouchPointStates states;
+    QEvent::Type type = QEvent::TouchCancel;
+    QPointF origin = window ? QPointF(window->mapToGlobal(QPoint(0, 0))) : QPointF();
+
+    if (cancelled) {
+        points.clear();
+        cancelled = false;
+    }
+    else {
+        bool begin = true, end = true;
+        for (QMap<int, QTouchEvent::TouchPoint>::iterator it = points.begin(); it != points.end(); ++it) {
+            QTouchEvent::TouchPoint &point = it.value();
+            point.setScreenPos(origin + point.pos());
+            states |= point.state();
+            begin = begin && point.state() == Qt::TouchPointPressed;
+            end = end && point.state() == Qt::TouchPointReleased;
+            list.append(point);
+        }
+        type = begin ? QEvent::TouchBegin : end ? QEvent::TouchEnd : QEvent::TouchUpdate;
+        // released points are gone, the others are stationary until they change
+        for (QMap<int, QTouchEvent::TouchPoint>::iterator it = points.begin(); it != points.end(); ) {
+            if (it.value().state() == Qt::TouchPointReleased) {
+                it = points.erase(it);
+            }
+            else {
+                it.value().setState(Qt::TouchPointStationary);
+                ++it;
+            }
+        }
+    }
+
+    QTouchEvent *event = new QTouchEvent(type, device, Qt::NoModifier, states, list);
+    event->setWindow(window);
+    event->setTimestamp(timestamp);
+
+    return event;
+}
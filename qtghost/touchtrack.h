@@ -0,0 +1,137 @@
+/*
+* MIT License
+*
+* Copyright (c) 2018 Antonio Alecrim Jr
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*/
+
+#ifndef TOUCHTRACK_H
+#define TOUCHTRACK_H
+
+#include <QHash>
+#include <QMap>
+#include <QTouchEvent>
+#include <QVector>
+#include "recevent.h"
+
+const int touch_slot_mask = 0xff; ///< \brief argI bits of a touch record holding the point slot.
+const int touch_frame_more = 0x100; ///< \brief argI flag: the next record belongs to the same touch event.
+
+/*
+  Touch recordings are per point tracks: one event per point that changed, in
+  the usual event fields, so every recording format stores them as is.
+    type: TouchBegin (point pressed), TouchUpdate (moved), TouchEnd (released),
+          TouchCancel (whole sequence cancelled, no point).
+    pos: point position, whole pixels.
+    argI: point slot (lowest free one when pressed, so ids stay small whatever
+          the device reports) | touch_frame_more on all but the last point of
+          a touch event.
+  Stationary points are not stored, the player remembers them.
+*/
+
+/**
+  \brief turns touch events into touch records, optionally coalescing moves.
+
+  With coalescing, move-only touch events closer than the interval to the
+  previous stored touch event are merged, per point, into one touch event
+  holding the latest position of every point moved meanwhile. Presses and
+  releases are never coalesced (pending moves are stored first), so taps and
+  multi-finger gestures keep their shape at a fraction of the device rate.
+  Records carry the time (ms, caller's recording clock) their touch event was
+  observed in recEvent::time: for coalesced moves, the time of the last move
+  merged, not the time they are flushed at.
+*/
+class TouchRecorder
+{
+    QHash<int, int> slots; ///< \brief device touch point id to slot.
+    QMap<int, QPointF> positions; ///< \brief last stored position by slot.
+    QMap<int, QPointF> pending; ///< \brief coalesced moves not stored yet, by slot.
+    qint64 pendingTime; ///< \brief time of the last coalesced move (ms).
+    qint64 lastFrame; ///< \brief time of the last stored touch event (ms).
+    int interval; ///< \brief coalescing interval (ms), 0 for none.
+
+    /**
+      \brief lowest slot not used by a pressed point.
+    */
+    int free_slot() const;
+
+public:
+    TouchRecorder();
+    /**
+      \brief sets the coalescing interval.
+      \param ms moves closer than this to the previous stored touch event are merged, 0 stores them all.
+    */
+    void setCoalescing(int ms);
+    int coalescing() const;
+    /**
+      \brief forgets the pressed points and pending moves, to be called when a recording starts.
+    */
+    void reset();
+    /**
+      \brief converts a touch event into records.
+      \param event touch event (begin, update, end or cancel).
+      \param now time the event was observed (ms).
+      \param out records to be stored, appended.
+      \return true if moves are pending: flush() must be called within coalescing() ms.
+    */
+    bool add(const QTouchEvent *event, qint64 now, QVector<recEvent> *out);
+    /**
+      \brief stores the pending moves as one touch event, at the time of the last one.
+      \param out records to be stored, appended.
+    */
+    void flush(QVector<recEvent> *out);
+};
+
+/**
+  \brief rebuilds touch events from touch records.
+
+  Records are added one by one; once the last record of a touch event is in,
+  the event is built with every pressed point (stationary ones included), its
+  type following Qt's rules: TouchBegin when no point was pressed before,
+  TouchEnd when every point is released, TouchUpdate otherwise.
+*/
+class TouchPlayer
+{
+    QMap<int, QTouchEvent::TouchPoint> points; ///< \brief pressed points by slot, states of the event being built.
+    bool cancelled; ///< \brief the event being built is a TouchCancel.
+
+public:
+    TouchPlayer();
+    /**
+      \brief forgets the pressed points, to be called when a play starts.
+    */
+    void reset();
+    /**
+      \brief adds a touch record.
+      \param ev touch record.
+      \return true if the touch event is complete, take it with take().
+    */
+    bool add(const recEvent &ev);
+    /**
+      \brief builds the complete touch event, released points are forgotten.
+      \param device touch device of the event.
+      \param window window the points are relative to, for screen positions (may be null).
+      \param timestamp event time stamp (ms).
+      \return touch event, to be deleted by the caller.
+    */
+    QTouchEvent *take(QTouchDevice *device, QWindow *window, ulong timestamp);
+};
+
+#endif // TOUCHTRACK_H
@@ -0,0 +1,174 @@
+/*
+* MIT License
+*
+* Copyright (c) 2018 Antonio Alecrim Jr
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*/
+
+#include "visualassert.h"
+#include <QBuffer>
+#include <QJsonDocument>
+#include <QJsonObject>
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define VISUALASSERT_SSE2
+#endif
+
+compareRequest::compareRequest()
+{
+    reference = 0;
+    tolerance = 0;
+    maxDiff = 0;
+    maxHashDistance = -1;
+    mask = false;
+}
+
+static inline bool pixelDiffers(const uchar *a, const uchar *b, int tolerance, quint64 *sad)
+{
+    bool differs = false;
+
+    for (int c = 0; c < 4; c++) {
+        int d = qAbs(a[c] - b[c]);
+        *sad += d;
+        differs |= d > tolerance;
+    }
+
+    return differs;
+}
+
+qint64 VisualAssert::diffPixels(const QImage &a, const QImage &b, int tolerance, quint64 *sad, QImage *mask)
+{
+    qint64 count = 0;
+    int width = a.width();
+
+    *sad = 0;
+    for (int y = 0; y < a.height(); y++) {
+        const uchar *la = a.constScanLine(y);
+        const uchar *lb = b.constScanLine(y);
+        uchar *lm = mask ? mask->scanLine(y) : nullptr;
+        int x = 0;
+#ifdef VISUALASSERT_SSE2
+        // 4 pixels per step: saturated |a - b| per channel, then any channel over tolerance
+        const __m128i tol = _mm_set1_epi8(static_cast<char>(qBound(0, tolerance, 255)));
+        const __m128i zero = _mm_setzero_si128();
+        __m128i vsad = zero;
+        for (; x + 4 <= width; x += 4) {
+            __m128i va = _mm_loadu_si128(reinterpret_cast<const __m128i *>(la + x * 4));
+            __m128i vb = _mm_loadu_si128(reinterpret_cast<const __m128i *>(lb + x * 4));
+            __m128i diff = _mm_or_si128(_mm_subs_epu8(va, vb), _mm_subs_epu8(vb, va));
+            __m128i over = _mm_subs_epu8(diff, tol);
+            __m128i same = _mm_cmpeq_epi32(_mm_cmpeq_epi8(over, zero), _mm_set1_epi32(-1));
+            int bits = _mm_movemask_ps(_mm_castsi128_ps(same));
+            vsad = _mm_add_epi64(vsad, _mm_sad_epu8(va, vb));
+            if (bits != 0xf) {
+                for (int p = 0; p < 4; p++) {
+                    if (!(bits & (1 << p))) {
+                        count++;
+                        if (lm)
+                            lm[x + p] = 255;
+                    }
+                }
+            }
+        }
+        quint64 lanes[2];
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(lanes), vsad);
+        *sad += lanes[0] + lanes[1];
+#endif
+        for (; x < width; x++) {
+            if (pixelDiffers(la + x * 4, lb + x * 4, tolerance, sad)) {
+                count++;
+                if (lm)
+                    lm[x] = 255;
+            }
+        }
+    }
+
+    return count;
+}
+
+quint64 VisualAssert::perceptualHash(const QImage &image)
+{
+    // dHash: 9x8 grayscale thumbnail, one bit per horizontal gradient sign
+    QImage small = image.convertToFormat(QImage::Format_RGB32)
+            .scaled(9, 8, Qt::IgnoreAspectRatio, Qt::SmoothTransformation)
+            .convertToFormat(QImage::Format_Grayscale8);
+    quint64 hash = 0;
+
+    for (int y = 0; y < 8; y++) {
+        const uchar *line = small.constScanLine(y);
+        for (int x = 0; x < 8; x++) {
+            hash = (hash << 1) | (line[x] > line[x + 1] ? 1 : 0);
+        }
+    }
+
+    return hash;
+}
+
+QByteArray VisualAssert::compare(QImage frame, QImage reference, compareRequest request)
+{
+    QJsonObject result;
+
+    result.insert("reference", request.reference);
+    if (!request.region.isNull()) {
+        QRect region = request.region.intersected(frame.rect());
+        if (reference.size() != region.size())
+            reference = reference.copy(region);
+        frame = frame.copy(region);
+    }
+    frame = frame.convertToFormat(QImage::Format_RGBA8888);
+    reference = reference.convertToFormat(QImage::Format_RGBA8888);
+
+    if (frame.isNull() || frame.size() != reference.size()) {
+        result.insert("pass", false);
+        result.insert("error", QString("size mismatch: frame %1x%2, reference %3x%4")
+                      .arg(frame.width()).arg(frame.height())
+                      .arg(reference.width()).arg(reference.height()));
+        return QJsonDocument(result).toJson(QJsonDocument::Compact);
+    }
+
+    QImage mask;
+    if (request.mask) {
+        mask = QImage(frame.size(), QImage::Format_Grayscale8);
+        mask.fill(0);
+    }
+    quint64 sad;
+    qint64 pixels = static_cast<qint64>(frame.width()) * frame.height();
+    qint64 differing = diffPixels(frame, reference, request.tolerance, &sad,
+                                  request.mask ? &mask : nullptr);
+    double ratio = pixels ? static_cast<double>(differing) / pixels : 0;
+    int distance = qPopulationCount(perceptualHash(frame) ^ perceptualHash(reference));
+    bool pass = request.maxHashDistance >= 0 ? distance <= request.maxHashDistance
+                                             : ratio <= request.maxDiff;
+
+    result.insert("pass", pass);
+    result.insert("diffPixels", static_cast<double>(differing));
+    result.insert("diffRatio", ratio);
+    result.insert("diffScore", pixels ? static_cast<double>(sad) / (pixels * 4 * 255.0) : 0);
+    result.insert("hashDistance", distance);
+    if (request.mask) {
+        QByteArray png;
+        QBuffer buffer(&png);
+        buffer.open(QIODevice::WriteOnly);
+        mask.save(&buffer, "PNG");
+        result.insert("mask", QString::fromLatin1(png.toBase64()));
+    }
+
+    return QJsonDocument(result).toJson(QJsonDocument::Compact);
+}
@@ -0,0 +1,77 @@
+/*
+* MIT License
+*
+* Copyright (c) 2018 Antonio Alecrim Jr
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*/
+
+#ifndef VISUALASSERT_H
+#define VISUALASSERT_H
+
+#include <QByteArray>
+#include <QImage>
+#include <QRect>
+
+///< \brief how a frame is compared to a reference image.
+struct compareRequest {
+    int reference; ///< \brief reference image id.
+    QRect region; ///< \brief frame sub-rectangle to be compared, null for the whole frame.
+    int tolerance; ///< \brief per channel difference (0-255) still counted as equal.
+    double maxDiff; ///< \brief fraction (0-1) of differing pixels still passing.
+    int maxHashDistance; ///< \brief if >= 0, pass on perceptual hash distance (0-64) instead.
+    bool mask; ///< \brief add a PNG diff mask (base64) to the result.
+
+    compareRequest();
+};
+
+class VisualAssert
+{
+public:
+    /**
+      \brief compares a frame to a reference image, runs on a worker thread.
+
+      If the reference has the size of the region it is compared to the region of the frame,
+      otherwise the same region of both is compared.
+      \param frame grabbed frame.
+      \param reference reference image.
+      \param request comparison options.
+      \return JSON verdict: pass, reference, diffPixels, diffRatio, diffScore (mean absolute
+      channel difference, 0-1), hashDistance, optional mask or error.
+    */
+    static QByteArray compare(QImage frame, QImage reference, compareRequest request);
+    /**
+      \brief counts the pixels differing by more than tolerance in any channel (RGBA8888 images).
+      \param a first image.
+      \param b second image, same size as a.
+      \param tolerance per channel tolerance.
+      \param sad sum of absolute channel differences, output.
+      \param mask if not null, a Grayscale8 image of a's size where differing pixels are set to 255.
+      \return number of differing pixels.
+    */
+    static qint64 diffPixels(const QImage &a, const QImage &b, int tolerance, quint64 *sad, QImage *mask);
+    /**
+      \brief 64 bits perceptual (difference) hash of an image.
+      \param image image.
+      \return hash, compare with the number of differing bits.
+    */
+    static quint64 perceptualHash(const QImage &image);
+};
+
+#endif // VISUALASSERT_H
@@ -0,0 +1,255 @@
+/*
+* MIT License
+*
+* Copyright (c) 2018 Antonio Alecrim Jr
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*/
+
+#include "waitcondition.h"
+#include <QMetaProperty>
+#include <QQuickItem>
+#include <QQuickWindow>
+#include <QVariant>
+
+waitCondition waitCondition::parse(const QString &spec)
+{
+    waitCondition condition;
+    QString text = spec.trimmed();
+    int equal = text.indexOf('=');
+    int dot = text.indexOf('.');
+
+    condition.compare = equal >= 0;
+    if (condition.compare) {
+        condition.value = text.mid(equal + 1);
+        text.truncate(equal);
+    }
+    if (dot >= 0 && (equal < 0 || dot < equal)) {
+        condition.property = text.mid(dot + 1).trimmed();
+        text.truncate(dot);
+    }
+    condition.name = text.trimmed();
+    // a value needs a property
+    if (condition.compare && condition.property.isEmpty())
+        condition.name.clear();
+
+    return condition;
+}
+
+QString waitCondition::toString() const
+{
+    QString spec = name;
+
+    if (!property.isEmpty())
+        spec += "." + property;
+    if (compare)
+        spec += "=" + value;
+
+    return spec;
+}
+
+bool waitCondition::isMet(const QObject *object) const
+{
+    if (!object)
+        return false;
+    if (property.isEmpty())
+        return true;
+
+    QVariant current = object->property(property.toUtf8().constData());
+    if (!current.isValid())
+        return false;
+
+    return compare ? current.toString() == value : current.toBool();
+}
+
+ObjectIndex::ObjectIndex(QObject *parent) : QObject(parent)
+{
+    stale = true;
+    walkCount = 0;
+}
+
+void ObjectIndex::setRoot(QObject *root)
+{
+    this->root = root;
+    unwatch();
+    names.clear();
+    invalidate();
+}
+
+void ObjectIndex::add(QObject *object)
+{
+    QQuickItem *item = qobject_cast<QQuickItem*>(object);
+    QQuickWindow *window = qobject_cast<QQuickWindow*>(object);
+    QString name = object->objectName();
+
+    if (!name.isEmpty() && !names.value(name))
+        names.insert(name, object);
+    connect(object, SIGNAL(objectNameChanged(QString)), SLOT(invalidate()), Qt::UniqueConnection);
+    watched.append(object);
+    if (item) {
+        connect(item, SIGNAL(childrenChanged()), SLOT(invalidate()), Qt::UniqueConnection);
+        foreach (QQuickItem *child, item->childItems()) {
+            add(child);
+        }
+    }
+    if (window)
+        add(window->contentItem());
+    // items are walked through their visual parent
+    foreach (QObject *child, object->children()) {
+        if (!qobject_cast<QQuickItem*>(child))
+            add(child);
+    }
+}
+
+QObject *ObjectIndex::find(const QString &name)
+{
+    QObject *object = names.value(name);
+
+    if (stale && (!object || object->objectName() != name)) {
+        // objects removed from the scene since the last walk are not watched any more
+        unwatch();
+        names.clear();
+        stale = false;
+        walkCount++;
+        if (root)
+            add(root);
+        object = names.value(name);
+    }
+
+    return object;
+}
+
+void ObjectIndex::release()
+{
+    unwatch();
+    names.clear();
+    stale = true;
+}
+
+void ObjectIndex::unwatch()
+{
+    foreach (const QPointer<QObject> &object, watched) {
+        if (object)
+            disconnect(object, nullptr, this, nullptr);
+    }
+    watched.clear();
+}
+
+int ObjectIndex::walks() const
+{
+    return walkCount;
+}
+
+void ObjectIndex::invalidate()
+{
+    stale = true;
+    emit changed();
+}
+
+ConditionWaiter::ConditionWaiter(ObjectIndex *index, const waitCondition &condition, int timeoutMs, QObject *parent) :
+    QObject(parent),
+    index(index),
+    condition(condition)
+{
+    scheduled = false;
+    done = false;
+    timeout.setSingleShot(true);
+    timeout.setInterval(timeoutMs > 0 ? timeoutMs : wait_default_timeout);
+    connect(&timeout, SIGNAL(timeout()), SLOT(expire()));
+}
+
+bool ConditionWaiter::start()
+{
+    QObject *object = index->find(condition.name);
+
+    clock.start();
+    if (condition.isMet(object)) {
+        done = true;
+        return true;
+    }
+    watch(object);
+    // the object may appear, or be replaced, with the scene
+    connect(index, SIGNAL(changed()), SLOT(schedule()));
+    timeout.start();
+
+    return false;
+}
+
+void ConditionWaiter::watch(QObject *object)
+{
+    if (object == target)
+        return;
+    if (target)
+        disconnect(target, nullptr, this, nullptr);
+    target = object;
+    if (!object)
+        return;
+
+    connect(object, SIGNAL(destroyed()), SLOT(schedule()));
+    if (condition.property.isEmpty())
+        return;
+    const QMetaObject *meta = object->metaObject();
+    QMetaProperty property = meta->property(meta->indexOfProperty(condition.property.toUtf8().constData()));
+    if (property.isValid() && property.hasNotifySignal()) {
+        connect(object, property.notifySignal(),
+                this, metaObject()->method(metaObject()->indexOfSlot("schedule()")));
+    }
+}
+
+void ConditionWaiter::schedule()
+{
+    if (scheduled || done)
+        return;
+    scheduled = true;
+    QMetaObject::invokeMethod(this, "check", Qt::QueuedConnection);
+}
+
+void ConditionWaiter::check()
+{
+    QObject *object = index->find(condition.name);
+
+    scheduled = false;
+    if (done)
+        return;
+    watch(object);
+    if (condition.isMet(object)) {
+        done = true;
+        timeout.stop();
+        emit finished(true, clock.elapsed());
+    }
+}
+
+void ConditionWaiter::expire()
+{
+    if (done)
+        return;
+    done = true;
+    emit finished(false, clock.elapsed());
+}
+
+QJsonObject ConditionWaiter::toJSON(bool met) const
+{
+    QJsonObject obj;
+
+    obj.insert("condition", condition.toString());
+    obj.insert("met", met);
+    obj.insert("ms", static_cast<double>(clock.elapsed()));
+
+    return obj;
+}
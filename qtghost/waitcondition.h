@@ -0,0 +1,209 @@
+/*
+* MIT License
+*
+* Copyright (c) 2018 Antonio Alecrim Jr
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*/
+
+#ifndef WAITCONDITION_H
+#define WAITCONDITION_H
+
+#include <QElapsedTimer>
+#include <QHash>
+#include <QJsonObject>
+#include <QObject>
+#include <QPointer>
+#include <QTimer>
+#include <QVector>
+#include "recevent.h"
+
+/*
+  Wait steps are recorded events too, so every recording format stores them:
+    type: wait_event.
+    argS: condition (see waitCondition::parse).
+    argI: timeout (ms), 0 for wait_default_timeout.
+  While playing, events after a wait step are only injected once its condition
+  holds (or its timeout expired), whatever the recorded delays say.
+*/
+const QEvent::Type wait_event = static_cast<QEvent::Type>(QEvent::User + 0x100); ///< \brief wait step event type (1256).
+const int wait_default_timeout = 10000; ///< \brief ms a wait step gives up after, unless it says otherwise.
+
+///< \brief what a wait step waits for.
+struct waitCondition {
+    QString name; ///< \brief objectName of the object.
+    QString property; ///< \brief property to be checked, empty: the object exists.
+    QString value; ///< \brief expected value, as a string.
+    bool compare; ///< \brief the property is compared to value, otherwise it must be true.
+
+    /**
+      \brief parses "name", "name.property" or "name.property=value".
+      "dialog" waits for an object named dialog to exist, "dialog.visible" for it to
+      be visible (any property converting to true), "list.count=3" for a value.
+      \param spec condition.
+      \return condition, an empty name if spec is invalid.
+    */
+    static waitCondition parse(const QString &spec);
+    /**
+      \brief condition in the parse() syntax.
+    */
+    QString toString() const;
+    /**
+      \brief tells if an object satisfies the condition.
+      \param object object found by name, may be null.
+    */
+    bool isMet(const QObject *object) const;
+};
+
+/**
+  \brief cached objectName to object index of a QML scene.
+
+  Built on the first lookup by walking the item tree (and QObject children) of
+  the root. Items signal when their children change and objects when their name
+  changes: the index is then marked stale and only walked again when a lookup
+  misses (or finds an object renamed meanwhile), so lookups are hash hits while
+  the scene is stable. The first object found by a name wins. Watching costs a
+  connection per object of the scene: release() drops them when nothing waits,
+  the next lookup walks the scene again.
+*/
+class ObjectIndex : public QObject
+{
+    Q_OBJECT
+
+    QPointer<QObject> root; ///< \brief scene root, usually the window.
+    QHash<QString, QPointer<QObject> > names; ///< \brief objects by name.
+    QVector<QPointer<QObject> > watched; ///< \brief objects connected to invalidate().
+    bool stale; ///< \brief the scene changed since the last walk.
+    int walkCount; ///< \brief see walks().
+
+    /**
+      \brief indexes an object and its descendants, watching them for changes.
+      \param object object.
+    */
+    void add(QObject *object);
+    /**
+      \brief disconnects the watched objects.
+    */
+    void unwatch();
+
+public:
+    explicit ObjectIndex(QObject *parent = nullptr);
+    /**
+      \brief sets the scene root, the index is walked again on the next lookup.
+      \param root scene root.
+    */
+    void setRoot(QObject *root);
+    /**
+      \brief finds an object by name.
+      \param name objectName.
+      \return object, null if there is none.
+    */
+    QObject *find(const QString &name);
+    /**
+      \brief stops watching the scene and forgets the index, to be called when nothing waits.
+    */
+    void release();
+    /**
+      \brief number of walks of the scene so far.
+    */
+    int walks() const;
+
+signals:
+    /**
+      \brief emitted when the scene changed: an item got or lost children, an object was renamed.
+    */
+    void changed();
+
+private slots:
+    /**
+      \brief marks the index stale.
+    */
+    void invalidate();
+};
+
+/**
+  \brief waits for a condition, driven by notifications.
+
+  The checked object is watched through its property notify signal and its
+  destroyed() signal, and the index through changed() while the object is
+  missing, so the condition is only checked again when something it depends
+  on changed. Properties without a notify signal are constant.
+*/
+class ConditionWaiter : public QObject
+{
+    Q_OBJECT
+
+    ObjectIndex *index; ///< \brief where the object is looked for.
+    waitCondition condition; ///< \brief condition.
+    QPointer<QObject> target; ///< \brief object currently watched, null while missing.
+    QTimer timeout; ///< \brief gives up.
+    QElapsedTimer clock; ///< \brief time since the wait started.
+    bool scheduled; ///< \brief a check is queued.
+    bool done; ///< \brief finished() was emitted.
+
+    /**
+      \brief watches the object of the condition, if it changed.
+      \param object object found by name, may be null.
+    */
+    void watch(QObject *object);
+
+public:
+    /**
+      \brief class constructor, see start().
+      \param index object index.
+      \param condition condition.
+      \param timeoutMs ms before giving up, 0 for wait_default_timeout.
+      \param parent parent object.
+    */
+    ConditionWaiter(ObjectIndex *index, const waitCondition &condition, int timeoutMs, QObject *parent = nullptr);
+    /**
+      \brief checks the condition and, if it doesn't hold yet, starts waiting for it.
+      \return true if it already holds: finished() is not emitted.
+    */
+    bool start();
+    /**
+      \brief result as JSON: condition, met, ms.
+      \param met the condition held.
+    */
+    QJsonObject toJSON(bool met) const;
+
+signals:
+    /**
+      \brief emitted once, when the condition holds or the timeout expired.
+      \param met the condition held.
+      \param ms time waited.
+    */
+    void finished(bool met, qint64 ms);
+
+private slots:
+    /**
+      \brief queues a check, notifications coming in bursts are checked once.
+    */
+    void schedule();
+    /**
+      \brief checks the condition, emits finished() if it holds.
+    */
+    void check();
+    /**
+      \brief gives up.
+    */
+    void expire();
+};
+
+#endif // WAITCONDITION_H
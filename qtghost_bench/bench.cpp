@@ -0,0 +1,446 @@
+/*
+* MIT License
+*
+* Copyright (c) 2018 Antonio Alecrim Jr
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*/
+
+/*
+ * qtghost_bench: microbenchmarks of the library's own hot paths (QtTest QBENCHMARK).
+ *
+ * Results are machine readable with the QtTest loggers, e.g.
+ *   qtghost_bench -platform offscreen -o bench.xml,xml
+ *   qtghost_bench -platform offscreen -o bench.csv,csv
+ * Times are per call (walltime), serverEcho reports bytes/s.
+ */
+
+#include <QtTest>
+#include <QGuiApplication>
+#include <QLocalSocket>
+#include <QLoggingCategory>
+#include <QPainter>
+#include <QQmlApplicationEngine>
+#include <QTouchDevice>
+#include <QtEndian>
+#include "capture.h"
+#include "qtghost.h"
+#include "screenshot.h"
+#include "server.h"
+
+const int synthetic_events = 1000000; ///< \brief size of the synthetic recording.
+const int echo_bytes = 4 << 20; ///< \brief bytes sent per serverEcho round (packets * size).
+const qint64 echo_min_time = 500; ///< \brief serverEcho measures rounds for at least that (ms).
+
+class QtghostBench : public QObject
+{
+    Q_OBJECT
+
+    QQmlApplicationEngine *engine; ///< \brief engine holding the watched window.
+    Qtghost *ghost; ///< \brief measured instance, serving on a local socket.
+    QString serverName; ///< \brief local socket name.
+    QByteArray shipped; ///< \brief ghoststream.json.
+    QByteArray synthetic; ///< \brief synthetic_events recording, JSON.
+    QImage frame; ///< \brief screenshot source, 1280x720.
+
+    /**
+      \brief sends packets echo requests and waits for every reply.
+      \param client connected client, binary framing.
+      \param packets number of requests.
+      \param size payload size.
+      \return false on timeout.
+    */
+    bool echo_round(QLocalSocket *client, int packets, int size);
+
+private slots:
+    void initTestCase();
+    void cleanupTestCase();
+    void dispatch_data();
+    void dispatch();
+    void eventFilter_data();
+    void eventFilter();
+    void addEvent();
+    void capturePush();
+    void touchRecord_data();
+    void touchRecord();
+    void getJSONEvents_data();
+    void getJSONEvents();
+    void setJSONEvents_data();
+    void setJSONEvents();
+    void getBinaryEvents_data();
+    void getBinaryEvents();
+    void setBinaryEvents_data();
+    void setBinaryEvents();
+    void serverEcho_data();
+    void serverEcho();
+    void encodeFrame_data();
+    void encodeFrame();
+    void encodeDiff_data();
+    void encodeDiff();
+};
+
+void QtghostBench::initTestCase()
+{
+    // library logs would drown the results
+    QLoggingCategory::setFilterRules("*.debug=false");
+
+    engine = new QQmlApplicationEngine(this);
+    engine->loadData("import QtQuick 2.0\nimport QtQuick.Window 2.0\nWindow { width: 1280; height: 720 }");
+    QVERIFY(!engine->rootObjects().isEmpty());
+    ghost = new Qtghost(qobject_cast<QGuiApplication*>(qApp), engine);
+    serverName = QString("qtghost-bench-%1").arg(QCoreApplication::applicationPid());
+    ghost->init(serverName);
+
+    QFile file(SRCDIR "../qtghost_pyinterface/ghoststream.json");
+    QVERIFY(file.open(QIODevice::ReadOnly));
+    shipped = file.readAll();
+
+    // mouse paths with a press/release every 16 events and some keys
+    ghost->record_start();
+    for (int i = 0; i < synthetic_events; i++) {
+        QPointF p(i % 1280, (i / 1280) % 720);
+        if (i % 256 == 255)
+            ghost->add_event(QPointF(), QEvent::KeyPress, Qt::Key_A, "a");
+        else if (i % 16 == 0)
+            ghost->add_event(p, QEvent::MouseButtonPress);
+        else if (i % 16 == 15)
+            ghost->add_event(p, QEvent::MouseButtonRelease);
+        else
+            ghost->add_event(p, QEvent::MouseMove);
+    }
+    ghost->record_stop();
+    synthetic = ghost->getJSONEvents().toJson(QJsonDocument::Compact);
+
+    frame = QImage(1280, 720, QImage::Format_ARGB32_Premultiplied);
+    QPainter painter(&frame);
+    QLinearGradient gradient(0, 0, 1280, 720);
+    gradient.setColorAt(0, Qt::darkBlue);
+    gradient.setColorAt(1, Qt::white);
+    painter.fillRect(frame.rect(), gradient);
+    for (int i = 0; i < 40; i++) {
+        painter.fillRect(QRect((i * 97) % 1200, (i * 53) % 680, 80, 40), QColor::fromHsv(i * 9, 200, 220));
+        painter.drawText(QPoint((i * 131) % 1200, (i * 71) % 700 + 12), QString("qtghost %1").arg(i));
+    }
+}
+
+void QtghostBench::cleanupTestCase()
+{
+    delete ghost;
+    delete engine;
+}
+
+void QtghostBench::dispatch_data()
+{
+    QTest::addColumn<bool>("recording");
+    QTest::addColumn<bool>("watched");
+
+    QTest::newRow("dormant, window") << false << true;
+    QTest::newRow("dormant, other object") << false << false;
+    QTest::newRow("recording, window") << true << true;
+    QTest::newRow("recording, other object") << true << false;
+}
+
+void QtghostBench::dispatch()
+{
+    QFETCH(bool, recording);
+    QFETCH(bool, watched);
+    QObject other;
+    QObject *target = watched ? engine->rootObjects().first() : &other;
+    QEvent event(QEvent::User);
+
+    // what any event sent in the app pays for Qtghost: nothing while dormant, and only
+    // the watched window pays while recording
+    if (recording)
+        ghost->record_start();
+    QBENCHMARK {
+        QCoreApplication::sendEvent(target, &event);
+    }
+    ghost->record_stop();
+}
+
+void QtghostBench::eventFilter_data()
+{
+    QTest::addColumn<bool>("recording");
+    QTest::addColumn<bool>("watched");
+
+    QTest::newRow("recording on") << true << true;
+    QTest::newRow("recording off") << false << true;
+    QTest::newRow("not watched") << true << false;
+}
+
+void QtghostBench::eventFilter()
+{
+    QFETCH(bool, recording);
+    QFETCH(bool, watched);
+    QObject other;
+    QObject *target = watched ? engine->rootObjects().first() : &other;
+    QMouseEvent event(QEvent::MouseMove, QPointF(10, 20), Qt::NoButton, Qt::NoButton, Qt::NoModifier);
+
+    ghost->setStoreAllMouseMoves(true);
+    if (recording)
+        ghost->record_start();
+    QBENCHMARK {
+        ghost->eventFilter(target, &event);
+    }
+    ghost->record_stop();
+    ghost->setStoreAllMouseMoves(false);
+}
+
+void QtghostBench::addEvent()
+{
+    ghost->record_start();
+    QBENCHMARK {
+        ghost->add_event(QPointF(10, 20), QEvent::MouseMove);
+    }
+    ghost->record_stop();
+}
+
+void QtghostBench::touchRecord_data()
+{
+    QTest::addColumn<int>("coalesce");
+
+    QTest::newRow("every move") << 0;
+    QTest::newRow("coalesce 16 ms") << 16;
+}
+
+void QtghostBench::touchRecord()
+{
+    QFETCH(int, coalesce);
+    TouchRecorder recorder;
+    QTouchDevice device;
+    QVector<recEvent> out;
+    QList<QTouchEvent::TouchPoint> points;
+    int step = 0;
+
+    for (int id = 0; id < 2; id++) {
+        QTouchEvent::TouchPoint point(id);
+        point.setState(Qt::TouchPointPressed);
+        point.setPos(QPointF(400 + id * 200, 300));
+        points.append(point);
+    }
+    recorder.setCoalescing(coalesce);
+    QTouchEvent press(QEvent::TouchBegin, &device, Qt::NoModifier, Qt::TouchPointPressed, points);
+    recorder.add(&press, 0, &out);
+    QBENCHMARK {
+        // two finger pinch, both points move on every update, a 250 Hz device
+        step++;
+        for (int id = 0; id < 2; id++) {
+            points[id].setState(Qt::TouchPointMoved);
+            points[id].setPos(QPointF(400 + id * 200 + (id ? 1 : -1) * (step % 200), 300));
+        }
+        QTouchEvent update(QEvent::TouchUpdate, &device, Qt::NoModifier, Qt::TouchPointMoved, points);
+        recorder.add(&update, 4 * step, &out);
+        if (out.size() > event_chunk_size)
+            out.clear();
+    }
+}
+
+void QtghostBench::capturePush()
+{
+    CaptureQueue queue;
+    QVector<recEvent> out;
+    QString text("a");
+    int queued = 0;
+
+    // GUI thread cost of a captured event, the queue is drained inline when full
+    // (the writer thread does it in the app), so this is an upper bound
+    QBENCHMARK {
+        queue.push(QPointF(10, 20), 16, QEvent::KeyPress, Qt::Key_A, text, QPointF());
+        if (++queued == capture_queue_size) {
+            out.resize(0);
+            queue.drain(&out);
+            queued = 0;
+        }
+    }
+    QCOMPARE(queue.droppedCount(), quint32(0));
+}
+
+void QtghostBench::getJSONEvents_data()
+{
+    QTest::addColumn<QByteArray>("recording");
+
+    QTest::newRow("ghoststream.json") << shipped;
+    QTest::newRow("1M events") << synthetic;
+}
+
+void QtghostBench::getJSONEvents()
+{
+    QFETCH(QByteArray, recording);
+
+    ghost->setJSONEvents(QJsonDocument::fromJson(recording));
+    QBENCHMARK {
+        ghost->getJSONEvents();
+    }
+}
+
+void QtghostBench::setJSONEvents_data()
+{
+    getJSONEvents_data();
+}
+
+void QtghostBench::setJSONEvents()
+{
+    QFETCH(QByteArray, recording);
+    QJsonDocument doc = QJsonDocument::fromJson(recording);
+
+    QVERIFY(!doc.isNull());
+    QBENCHMARK {
+        ghost->setJSONEvents(doc);
+    }
+}
+
+void QtghostBench::getBinaryEvents_data()
+{
+    getJSONEvents_data();
+}
+
+void QtghostBench::getBinaryEvents()
+{
+    QFETCH(QByteArray, recording);
+
+    // same recordings as getJSONEvents, for the binary/JSON ratio
+    ghost->setJSONEvents(QJsonDocument::fromJson(recording));
+    QBENCHMARK {
+        ghost->getBinaryEvents();
+    }
+}
+
+void QtghostBench::setBinaryEvents_data()
+{
+    getJSONEvents_data();
+}
+
+void QtghostBench::setBinaryEvents()
+{
+    QFETCH(QByteArray, recording);
+
+    ghost->setJSONEvents(QJsonDocument::fromJson(recording));
+    QByteArray data = ghost->getBinaryEvents();
+    QVERIFY(!data.isEmpty());
+    QBENCHMARK {
+        ghost->setBinaryEvents(data);
+    }
+}
+
+bool QtghostBench::echo_round(QLocalSocket *client, int packets, int size)
+{
+    QByteArray packet(4 + 3 + size, 'x');
+    qint64 expected = static_cast<qint64>(packets) * packet.size();
+    qint64 received = 0;
+    QElapsedTimer timeout;
+
+    qToLittleEndian<quint32>(3 + size, reinterpret_cast<uchar*>(packet.data()));
+    memcpy(packet.data() + 4, "-o ", 3);
+    for (int i = 0; i < packets; i++) {
+        client->write(packet);
+    }
+    timeout.start();
+    while (received < expected) {
+        if (timeout.elapsed() > 10000)
+            return false;
+        QCoreApplication::processEvents(QEventLoop::WaitForMoreEvents, 100);
+        received += client->readAll().size();
+    }
+
+    return true;
+}
+
+void QtghostBench::serverEcho_data()
+{
+    QTest::addColumn<int>("size");
+
+    QTest::newRow("16 B") << 16;
+    QTest::newRow("1 KB") << 1024;
+    QTest::newRow("64 KB") << 65536;
+    QTest::newRow("1 MB") << (1 << 20);
+}
+
+void QtghostBench::serverEcho()
+{
+    QFETCH(int, size);
+    QLocalSocket client;
+    int packets = qMin(echo_bytes / size, 4096);
+    qint64 bytes = 0;
+    QElapsedTimer timer;
+
+    client.connectToServer(serverName);
+    QVERIFY(client.waitForConnected(5000));
+    client.write(binary_framing_magic, 4);
+    QTRY_COMPARE(client.bytesAvailable(), qint64(4));
+    QCOMPARE(client.readAll(), QByteArray(binary_framing_magic, 4));
+
+    timer.start();
+    while (timer.elapsed() < echo_min_time) {
+        QVERIFY2(echo_round(&client, packets, size), "echo timed out");
+        bytes += static_cast<qint64>(packets) * size;
+    }
+    // payload bytes echoed per second (they went both ways)
+    QTest::setBenchmarkResult(bytes * 1000.0 / timer.elapsed(), QTest::BytesPerSecond);
+    client.disconnectFromServer();
+}
+
+void QtghostBench::encodeFrame_data()
+{
+    QTest::addColumn<int>("format");
+    QTest::addColumn<int>("level");
+
+    QTest::newRow("png") << static_cast<int>(SCR_PNG) << -1;
+    QTest::newRow("png level 1") << static_cast<int>(SCR_PNG) << 1;
+    QTest::newRow("raw") << static_cast<int>(SCR_RAW) << -1;
+    QTest::newRow("fast") << static_cast<int>(SCR_FAST) << -1;
+}
+
+void QtghostBench::encodeFrame()
+{
+    QFETCH(int, format);
+    QFETCH(int, level);
+    screenshotRequest request;
+
+    request.format = static_cast<screenshotFormat>(format);
+    request.level = level;
+    QBENCHMARK {
+        ScreenshotPipeline::encodeFrame(frame, request);
+    }
+}
+
+void QtghostBench::encodeDiff_data()
+{
+    QTest::addColumn<bool>("keyframe");
+
+    QTest::newRow("keyframe") << true;
+    QTest::newRow("unchanged") << false;
+}
+
+void QtghostBench::encodeDiff()
+{
+    QFETCH(bool, keyframe);
+    screenshotRequest request;
+    tileState state;
+
+    request.format = SCR_DIFF;
+    request.keyframe = keyframe;
+    ScreenshotPipeline::encodeDiff(frame, request, &state);
+    QBENCHMARK {
+        ScreenshotPipeline::encodeDiff(frame, request, &state);
+    }
+}
+
+QTEST_MAIN(QtghostBench)
+
+#include "bench.moc"
@@ -0,0 +1,14 @@
+QT += quick concurrent testlib
+CONFIG += c++11 console testcase
+CONFIG -= app_bundle
+TARGET = qtghost_bench
+
+# the library is built in, so internals (Server, ScreenshotPipeline) can be measured directly
+DEFINES += QTGHOST_LIBRARY
+DEFINES += QT_DEPRECATED_WARNINGS
+DEFINES += SRCDIR=\\\"$$PWD/\\\"
+
+include(../qtghost/qtghost.pri)
+
+SOURCES += \
+        bench.cpp
@@ -0,0 +1,75 @@
+import sys, time, qtghost3
+from qtghost3.qtghost import OP_VERSION
+
+# transport throughput: payloads of 1 KB to 100 MB echoed by the app ("-o"),
+# with text and binary framing, then the cost of many small commands, over
+# TCP loopback (PORT) or a local socket (local:NAME)
+SIZES = [1 << 10, 16 << 10, 256 << 10, 1 << 20, 16 << 20, 100 << 20]
+COMMANDS = 1000
+
+def human(size):
+	for unit in ['B', 'KB', 'MB']:
+		if (size < 1024):
+			return str(size) + ' ' + unit
+		size //= 1024
+	return str(size) + ' GB'
+
+def open_ghost(target, binary=False, rpc=False):
+	ghost = qtghost3.Qtghost()
+	if (target.startswith('local:')):
+		ghost.connect_local(target[6:], binary, rpc)
+	else:
+		ghost.connect('localhost', int(target), binary, rpc)
+	return ghost
+
+def run(target, binary):
+	ghost = open_ghost(target, binary)
+	print('framing:', 'binary' if ghost.binary else 'text')
+	for size in SIZES:
+		payload = bytes(size)
+		repeat = max(1, (64 << 20) // size)
+		start = time.perf_counter()
+		for i in range(repeat):
+			if (len(ghost.echo(payload)) != size):
+				sys.exit('error: echo length mismatch')
+		elapsed = time.perf_counter() - start
+		# bytes went both ways
+		rate = 2 * size * repeat / elapsed / (1 << 20)
+		print('%8s x %6d: %9.1f us/round trip %9.1f MB/s' % (human(size), repeat, elapsed / repeat * 1e6, rate))
+	ghost.disconnect()
+
+def run_commands(target):
+	text = open_ghost(target)
+	start = time.perf_counter()
+	for i in range(COMMANDS):
+		text.send_raw(b'-v')
+		text.recvall()
+	report('text, one at a time', start)
+	text.disconnect()
+
+	ghost = open_ghost(target, rpc=True)
+	if (not ghost.rpc):
+		sys.exit('error: protocol v2 not supported')
+	start = time.perf_counter()
+	for i in range(COMMANDS):
+		ghost.call(OP_VERSION)
+	report('v2, one at a time', start)
+	start = time.perf_counter()
+	ids = [ghost.request(OP_VERSION) for i in range(COMMANDS)]
+	for req_id in ids:
+		ghost.response(req_id)
+	report('v2, pipelined', start)
+	ghost.disconnect()
+
+def report(name, start):
+	elapsed = time.perf_counter() - start
+	print('%d commands, %-20s %9.1f us/command' % (COMMANDS, name + ':', elapsed / COMMANDS * 1e6))
+
+if (len(sys.argv) < 2):
+	sys.exit("usage: benchmark.py PORT|local:NAME ...")
+
+for target in sys.argv[1:]:
+	print('transport:', 'local socket' if target.startswith('local:') else 'TCP loopback', target)
+	run(target, False)
+	run(target, True)
+	run_commands(target)
@@ -1,4 +1,5 @@
-import sys, qtghost3
+import sys, json, qtghost3
+from qtghost3 import ghostbin
 
 def getArgs():
 	val = ''
@@ -7,43 +8,130 @@ def getArgs():
 	return val[:-1] #just to remove the last empty byte, not needed
 
 
-TCP_IP = 'localhost'
-try:
-	TCP_PORT = int(sys.argv[1])
-except:
-	sys.exit("error: can't find TCP_PORT as argument #1")
+# offline converters, no connection needed (any recording format as input)
+if (len(sys.argv) > 3 and sys.argv[1] in ("tobin", "tojson", "toidx")):
+	with open(sys.argv[2], 'rb') as f:
+		doc = ghostbin.load_json(f.read())
+	if (sys.argv[1] == "tobin"):
+		with open(sys.argv[3], 'wb') as f:
+			f.write(ghostbin.json_to_bin(doc))
+	elif (sys.argv[1] == "toidx"):
+		with open(sys.argv[3], 'wb') as f:
+			f.write(ghostbin.json_to_indexed(doc))
+	else:
+		with open(sys.argv[3], 'w') as f:
+			json.dump(doc, f, indent=4)
+	sys.exit(0)
 
+# inserts a wait step into a recording: addwait IN OUT INDEX CONDITION [TIMEOUT] (JSON out)
+if (len(sys.argv) > 5 and sys.argv[1] == "addwait"):
+	with open(sys.argv[2], 'rb') as f:
+		doc = ghostbin.load_json(f.read())
+	ghostbin.insert_wait(doc, int(sys.argv[4]), sys.argv[5], int(sys.argv[6]) if len(sys.argv) > 6 else 0)
+	with open(sys.argv[3], 'w') as f:
+		json.dump(doc, f, indent=4)
+	sys.exit(0)
+
+# compares the checkpoints of two saved play reports (ghost.py PORT report FILE)
+if (len(sys.argv) > 3 and sys.argv[1] == "diverge"):
+	with open(sys.argv[2]) as f:
+		good = json.load(f)
+	with open(sys.argv[3]) as f:
+		bad = json.load(f)
+	found = qtghost3.qtghost.first_divergence(good, bad)
+	if (found is None):
+		print('no divergence')
+	else:
+		print('diverges between events %d and %d' % found)
+	sys.exit(1 if found else 0)
+
+TCP_IP = 'localhost'
 ghost = qtghost3.Qtghost()
-ghost.connect(TCP_IP, TCP_PORT)
+if (len(sys.argv) > 1 and sys.argv[1].startswith('local:')):
+	# same host app served on a local socket
+	ghost.connect_local(sys.argv[1][6:])
+else:
+	try:
+		TCP_PORT = int(sys.argv[1])
+	except:
+		sys.exit("error: can't find TCP_PORT (or local:NAME) as argument #1")
+	ghost.connect(TCP_IP, TCP_PORT)
 
 get = False
 set = False
+getbin = False
+setbin = False
 ver = False
 scr = False
+sub = False
 
 try:
 	if (sys.argv[2] == "get"):
 		get = True
 	elif (sys.argv[2] == "set"):
 		set = True
+	elif (sys.argv[2] == "getbin"):
+		getbin = True
+	elif (sys.argv[2] == "setbin"):
+		setbin = True
 	elif (sys.argv[2] == "play"):
-		ghost.play()
+		# optional play options: --speed x --max-gap ms --fast --from n --to n --checkpoint n --force-frames
+		ghost.send_pkt(' '.join(['-p'] + sys.argv[3:]))
+	elif (sys.argv[2] == "report"):
+		# optional file the report is saved to (see diverge)
+		report = ghost.play_report()
+		if (len(sys.argv) > 3):
+			with open(sys.argv[3], 'w') as f:
+				json.dump(report, f, indent=4)
+		else:
+			print(report)
+	elif (sys.argv[2] == "seek"):
+		# seek <event index> or seek <ms>ms (recorded time)
+		if (sys.argv[3].endswith('ms')):
+			ghost.seek(time=int(sys.argv[3][:-2]))
+		else:
+			ghost.seek(int(sys.argv[3]))
+	elif (sys.argv[2] == "wait"):
+		# wait <condition> [timeout ms]
+		print(ghost.wait_until(sys.argv[3], int(sys.argv[4]) if len(sys.argv) > 4 else None))
+	elif (sys.argv[2] == "waitstep"):
+		# waitstep <condition> [timeout ms], while recording
+		ghost.wait_step(sys.argv[3], int(sys.argv[4]) if len(sys.argv) > 4 else None)
+	elif (sys.argv[2] == "pause"):
+		ghost.pause()
+	elif (sys.argv[2] == "resume"):
+		ghost.resume()
 	elif (sys.argv[2] == "step"):
 		ghost.step()
 	elif (sys.argv[2] == "rec"):
-		ghost.rec()
+		# optional capture file (app side): records to disk instead of memory
+		ghost.rec(sys.argv[3] if len(sys.argv) > 3 else None)
 	elif (sys.argv[2] == "stop"):
 		ghost.stop_rec()
+	elif (sys.argv[2] == "load"):
+		# load <indexed recording path, app side>
+		ghost.load(sys.argv[3])
 	elif (sys.argv[2] == "ver"):
 		ver = True
 	elif (sys.argv[2] == "scr"):
 		scr = True
+	elif (sys.argv[2] == "sub"):
+		sub = True
+	elif (sys.argv[2] == "ref"):
+		# ref <id> <image file>
+		ghost.setReference(int(sys.argv[3]), sys.argv[4])
+	elif (sys.argv[2] == "assert"):
+		# assert <id> [--tolerance n --max-diff r --phash bits --region x,y,w,h]
+		ghost.send_pkt(' '.join(['-a'] + sys.argv[3:]))
+		print(ghost.recvall().decode())
 except:
 	sys.exit("error: can't find command as argument #2")
 
 filename = 'ghoststream.json'
+if (getbin or setbin):
+	filename = 'ghoststream.qgr'
 try:
-	if (get or set):
+	if (get or set or getbin or setbin):
 		filename = sys.argv[3]
 except:
 	print("using default filename: ",filename)
@@ -52,7 +140,20 @@ if (get):
 	ghost.getJSON(filename)
 if (set):
 	ghost.setJSON(filename)
+if (getbin):
+	ghost.getBin(filename)
+if (setbin):
+	ghost.setBin(filename)
 if (ver):
 	print('version: local: ', ghost.version(), ' remote:', ghost.get_ver())
 if (scr):
-	ghost.getScreenshot()
+	# optional: png|raw|fast
+	ghost.getScreenshot(sys.argv[3] if len(sys.argv) > 3 else 'png')
+if (sub):
+	def show(batch):
+		for event in batch:
+			print(event)
+	try:
+		ghost.subscribe(show)
+	except KeyboardInterrupt:
+		pass
@@ -0,0 +1,275 @@
+import sys, os, time, json, glob, socket, argparse, subprocess, tempfile, threading, queue, shlex, qtghost3
+
+# runs many recordings over N isolated app instances, work-queue style, and
+# writes one combined report. Each worker either owns a long-lived app
+# (--app, endpoint given through QTGHOST_SOCKET / QTGHOST_PORT) or runs
+# qtghost_runner once per recording (--runner, headless, no network)
+
+STARTUP_TIMEOUT = 30 # s, app launch until its server accepts connections
+POLL_INTERVAL = 0.02 # s, play report polling while a recording plays
+
+def free_port():
+	"""Ask the OS for an unused TCP port (it may be taken again before the app binds it)."""
+	s = socket.socket(socket.AF_INET, socket.SOCK_STREAM)
+	s.bind(('localhost', 0))
+	port = s.getsockname()[1]
+	s.close()
+	return port
+
+def find_recordings(paths):
+	"""Expand directories into their recordings (*.json, *.qgr), sorted."""
+	found = []
+	for path in paths:
+		if (os.path.isdir(path)):
+			found += sorted(glob.glob(os.path.join(path, '*.json')) + glob.glob(os.path.join(path, '*.qgr')))
+		else:
+			found.append(path)
+	return found
+
+def is_binary(filename):
+	"""True for a binary recording ("QGRB" magic), False for JSON."""
+	with open(filename, 'rb') as f:
+		return f.read(4) == b'QGRB'
+
+class AppWorker:
+	"""
+	One app instance driven through its Qtghost server.
+
+	Parameters
+	----------
+	index : int
+		worker number, used for its endpoint and log file
+	command : list
+		app command line
+	transport : str
+		'local' (Unix domain socket / named pipe) or 'tcp'
+	options : argparse.Namespace
+		play options, screenshots directory, restart flag, timeout
+
+	"""
+	def __init__(self, index, command, transport, options):
+		self.index = index
+		self.command = command
+		self.transport = transport
+		self.options = options
+		self.process = None
+		self.ghost = None
+
+	def start(self):
+		"""Launch the app on a fresh endpoint and connect to it."""
+		env = dict(os.environ)
+		env.pop('QTGHOST_SOCKET', None)
+		env.pop('QTGHOST_PORT', None)
+		if (self.transport == 'local'):
+			endpoint = 'qtghost-%d-%d' % (os.getpid(), self.index)
+			env['QTGHOST_SOCKET'] = endpoint
+		else:
+			endpoint = free_port()
+			env['QTGHOST_PORT'] = str(endpoint)
+		self.log = open(os.path.join(tempfile.gettempdir(), 'qtghost-%d-%d.log' % (os.getpid(), self.index)), 'w')
+		self.process = subprocess.Popen(self.command, env=env, stdout=self.log, stderr=subprocess.STDOUT)
+		deadline = time.monotonic() + STARTUP_TIMEOUT
+		while True:
+			ghost = qtghost3.Qtghost()
+			try:
+				if (self.transport == 'local'):
+					ghost.connect_local(endpoint, binary=True)
+				else:
+					ghost.connect('localhost', endpoint, binary=True)
+				self.ghost = ghost
+				return
+			except OSError:
+				ghost.disconnect()
+				if (self.process.poll() is not None):
+					raise RuntimeError('app exited with code %d' % self.process.returncode)
+				if (time.monotonic() > deadline):
+					raise RuntimeError('app server not reachable')
+				time.sleep(0.1)
+
+	def stop(self):
+		"""Disconnect and terminate the app."""
+		if (self.ghost is not None):
+			self.ghost.disconnect()
+			self.ghost = None
+		if (self.process is not None):
+			self.process.terminate()
+			try:
+				self.process.wait(5)
+			except subprocess.TimeoutExpired:
+				self.process.kill()
+				self.process.wait()
+			self.process = None
+			self.log.close()
+
+	def run(self, recording):
+		"""
+		Replay one recording.
+
+		Returns
+		-------
+		dict
+			play report (see Qtghost.play_report) and screenshot filename
+
+		"""
+		if (self.process is None or self.options.restart):
+			self.stop()
+			self.start()
+		if (is_binary(recording)):
+			self.ghost.setBin(recording)
+		else:
+			self.ghost.setJSON(recording)
+		self.ghost.play(self.options.speed, self.options.max_gap, self.options.fast)
+		deadline = time.monotonic() + self.options.timeout if self.options.timeout else None
+		while True:
+			report = self.ghost.play_report()
+			if (report['events'] >= report.get('end', report['total'])):
+				break
+			if (deadline is not None and time.monotonic() > deadline):
+				# leave the app in a known state for the next recording
+				self.stop()
+				raise RuntimeError('timeout')
+			time.sleep(POLL_INTERVAL)
+		result = {'report': report}
+		if (self.options.screenshots):
+			name = os.path.splitext(os.path.basename(recording))[0] + '.png'
+			result['screenshot'] = os.path.join(self.options.screenshots, name)
+			self.ghost.getScreenshot(filename=result['screenshot'])
+		return result
+
+class RunnerWorker:
+	"""
+	Runs qtghost_runner once per recording (a fresh headless app every time).
+
+	Parameters
+	----------
+	index : int
+		worker number
+	runner : str
+		qtghost_runner executable
+	qml : str
+		QML file to load
+	options : argparse.Namespace
+		play options, screenshots directory, timeout
+
+	"""
+	def __init__(self, index, runner, qml, options):
+		self.index = index
+		self.runner = runner
+		self.qml = qml
+		self.options = options
+
+	def start(self):
+		pass
+
+	def stop(self):
+		pass
+
+	def run(self, recording):
+		"""Replay one recording, returns the runner result (see qtghost_runner)."""
+		cmd = [self.runner, self.qml, recording, '-o', '-']
+		if (self.options.fast):
+			cmd.append('--fast')
+		if (self.options.speed is not None):
+			cmd += ['--speed', str(self.options.speed)]
+		if (self.options.max_gap is not None):
+			cmd += ['--max-gap', str(self.options.max_gap)]
+		if (self.options.timeout):
+			cmd += ['--timeout', str(int(self.options.timeout * 1000))]
+		if (self.options.screenshots):
+			name = os.path.splitext(os.path.basename(recording))[0] + '.png'
+			cmd += ['-s', os.path.join(self.options.screenshots, name)]
+		proc = subprocess.run(cmd, stdout=subprocess.PIPE, stderr=subprocess.DEVNULL)
+		if (proc.returncode != 0):
+			raise RuntimeError('runner exited with code %d' % proc.returncode)
+		result = json.loads(proc.stdout.decode())
+		result['report'] = result['runs'][-1]
+		return result
+
+def work(worker, jobs, results, lock):
+	"""Worker thread: takes recordings from the queue until it is empty."""
+	try:
+		while True:
+			try:
+				recording = jobs.get_nowait()
+			except queue.Empty:
+				break
+			start = time.perf_counter()
+			try:
+				entry = worker.run(recording)
+				entry['ok'] = True
+			except Exception as e:
+				entry = {'ok': False, 'error': str(e)}
+			entry['recording'] = recording
+			entry['worker'] = worker.index
+			entry['wall'] = time.perf_counter() - start
+			with lock:
+				results.append(entry)
+				print('[%d] %-40s %s %.3f s' % (worker.index, recording,
+					'ok  ' if entry['ok'] else 'FAIL', entry['wall']))
+	finally:
+		worker.stop()
+
+def main():
+	parser = argparse.ArgumentParser(description='Replays recordings in parallel over several app instances.')
+	parser.add_argument('recordings', nargs='+', help='recording files or directories (*.json, *.qgr)')
+	parser.add_argument('-j', '--jobs', type=int, default=os.cpu_count(), help='app instances (default: cores)')
+	group = parser.add_mutually_exclusive_group(required=True)
+	group.add_argument('--app', help='app command line, it must call Qtghost::init()')
+	group.add_argument('--runner', nargs=2, metavar=('RUNNER', 'QML'), help='qtghost_runner executable and QML file')
+	parser.add_argument('--transport', choices=['local', 'tcp'],
+		default='local' if hasattr(socket, 'AF_UNIX') else 'tcp', help='app endpoint kind (--app)')
+	parser.add_argument('--restart', action='store_true', help='fresh app for every recording (--app)')
+	parser.add_argument('--speed', type=float, help='speed multiplier')
+	parser.add_argument('--max-gap', type=int, help='cap (ms) on any single delay')
+	parser.add_argument('--fast', action='store_true', help='ignore recorded delays')
+	parser.add_argument('--timeout', type=float, default=0, help='per recording timeout (s)')
+	parser.add_argument('--screenshots', help='directory for the final frame of every recording')
+	parser.add_argument('-o', '--output', default='report.json', help='combined report (default report.json)')
+	args = parser.parse_args()
+
+	recordings = find_recordings(args.recordings)
+	if (not recordings):
+		sys.exit('error: no recordings found')
+	if (args.screenshots):
+		os.makedirs(args.screenshots, exist_ok=True)
+	jobs = queue.Queue()
+	for recording in recordings:
+		jobs.put(recording)
+	count = max(1, min(args.jobs, len(recordings)))
+	if (args.app):
+		workers = [AppWorker(i, shlex.split(args.app), args.transport, args) for i in range(count)]
+	else:
+		workers = [RunnerWorker(i, args.runner[0], args.runner[1], args) for i in range(count)]
+
+	results = []
+	lock = threading.Lock()
+	start = time.perf_counter()
+	threads = [threading.Thread(target=work, args=(w, jobs, results, lock)) for w in workers]
+	for t in threads:
+		t.start()
+	for t in threads:
+		t.join()
+	elapsed = time.perf_counter() - start
+
+	results.sort(key=lambda r: recordings.index(r['recording']))
+	failed = sum(1 for r in results if not r['ok'])
+	busy = sum(r['wall'] for r in results)
+	report = {
+		'workers': count,
+		'recordings': len(results),
+		'passed': len(results) - failed,
+		'failed': failed,
+		'wall': elapsed,
+		# sum of per recording wall times over elapsed time: close to workers when scaling linearly
+		'parallelism': busy / elapsed if elapsed else 0,
+		'throughput': len(results) / elapsed if elapsed else 0,
+		'results': results,
+	}
+	with open(args.output, 'w') as f:
+		json.dump(report, f, indent=4)
+	print('%d recordings, %d failed, %d workers, %.2f s (%.2f recordings/s, parallelism %.2f)' % (
+		len(results), failed, count, elapsed, report['throughput'], report['parallelism']))
+	sys.exit(1 if failed else 0)
+
+if __name__ == '__main__':
+	main()
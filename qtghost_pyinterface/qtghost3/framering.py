@@ -0,0 +1,64 @@
+# framering.py
+import mmap, struct
+
+MAGIC = b'QGFB'
+HEADER = struct.Struct('<4sIIIIIQ')  # magic, version, slotCount, slotSize, headerSize, reserved, sequence
+SLOT = struct.Struct('<QIIIIq')  # sequence, width, height, stride, flags, timestamp
+BOTTOM_UP = 1
+
+
+class FrameRing:
+	"""Reads frames exported by remote Qtghost into a shared memory ring (-m)."""
+
+	def __init__(self, path):
+		"""
+		Map the ring file.
+
+		Parameters
+		----------
+		path : string
+			ring file path, as returned when the ring is opened
+
+		"""
+		with open(path, 'rb') as f:
+			self.map = mmap.mmap(f.fileno(), 0, access=mmap.ACCESS_READ)
+		magic, version, self.slots, self.slotSize, self.headerSize, reserved, seq = HEADER.unpack_from(self.map)
+		if (magic != MAGIC):
+			raise ValueError('not a Qtghost frame ring')
+
+	def close(self):
+		"""Unmap the ring file."""
+		self.map.close()
+
+	def last(self):
+		"""Returns the number of the last published frame, 0 if none."""
+		return HEADER.unpack_from(self.map)[6]
+
+	def read(self, seq):
+		"""
+		Copy a frame out of the ring.
+
+		Parameters
+		----------
+		seq : int
+			frame number (from a "-m" notification or last())
+
+		Returns
+		-------
+		tuple
+			(width, height, pixels) RGBA8888 top to bottom, timestamp (ms)
+			or None if the frame was already overwritten
+
+		"""
+		offset = self.headerSize + (seq % self.slots) * self.slotSize
+		sequence, width, height, stride, flags, timestamp = SLOT.unpack_from(self.map, offset)
+		if (sequence != seq):
+			return None
+		start = offset + SLOT.size
+		pixels = self.map[start:start + stride * height]
+		# the writer may have reused the slot while it was copied
+		if (SLOT.unpack_from(self.map, offset)[0] != seq):
+			return None
+		if (flags & BOTTOM_UP):
+			pixels = b''.join(pixels[y * stride:(y + 1) * stride] for y in range(height - 1, -1, -1))
+		return width, height, pixels, timestamp
@@ -0,0 +1,323 @@
+# ghostbin.py
+import struct, json
+
+MAGIC = b'QGRB'
+VERSION = 1
+
+SAME_TYPE = 0x01
+ARG_I = 0x02
+ARG_S = 0x04
+POS2 = 0x08
+RAW_POS = 0x10
+
+MAX_INT_POS = 2147483647
+
+# indexed format (see qtghost/mappedrecording.h), mapped and played in place by the app
+INDEXED_MAGIC = b'QGRX'
+INDEXED_VERSION = 1
+INDEXED_HEADER = struct.Struct('<4sIIIQII')
+INDEXED_RECORD = struct.Struct('<ddddiiiHH')
+
+WAIT_EVENT = 1256 # wait step event type (QEvent::User + 0x100, see qtghost/waitcondition.h)
+
+
+def _put_varint(out, value):
+	while value >= 0x80:
+		out.append((value & 0x7f) | 0x80)
+		value >>= 7
+	out.append(value)
+
+
+def _zigzag(value):
+	return (value << 1) if value >= 0 else ((-value) << 1) - 1
+
+
+def _unzigzag(value):
+	return (value >> 1) ^ -(value & 1)
+
+
+def _integral(value):
+	return float(value).is_integer() and abs(value) <= MAX_INT_POS
+
+
+def encode(events):
+	"""
+	Encode events into a binary recording.
+
+	Parameters
+	----------
+	events : list
+		events as found in the JSON recording 'events' array
+
+	Returns
+	-------
+	bytes
+		binary recording (see qtghost/recbinary.h for the format)
+
+	"""
+	out = bytearray(MAGIC)
+	out += bytes([VERSION, 0])
+	strings = {}
+	prev_x = prev_y = 0
+	prev_type = -1
+	for event in events:
+		x = event.get('posX', 0)
+		y = event.get('posY', 0)
+		x2 = event.get('posX2', 0)
+		y2 = event.get('posY2', 0)
+		etype = event.get('type', 0)
+		arg_i = event.get('argI', 0)
+		arg_s = event.get('argS', '')
+		has_pos2 = x2 != 0 or y2 != 0
+		raw = not (_integral(x) and _integral(y)) or \
+			(has_pos2 and not (_integral(x2) and _integral(y2)))
+		head = 0
+		if etype == prev_type:
+			head |= SAME_TYPE
+		if arg_i:
+			head |= ARG_I
+		if arg_s:
+			head |= ARG_S
+		if has_pos2:
+			head |= POS2
+		if raw:
+			head |= RAW_POS
+		out.append(head)
+		if not head & SAME_TYPE:
+			_put_varint(out, etype)
+		_put_varint(out, max(int(event.get('time', 0)), 0))
+		ix = int(round(x))
+		iy = int(round(y))
+		if raw:
+			out += struct.pack('<dd', x, y)
+		else:
+			_put_varint(out, _zigzag(ix - prev_x))
+			_put_varint(out, _zigzag(iy - prev_y))
+		if arg_i:
+			_put_varint(out, _zigzag(arg_i))
+		if arg_s:
+			if arg_s in strings:
+				_put_varint(out, strings[arg_s] + 1)
+			else:
+				utf8 = arg_s.encode('utf-8')
+				_put_varint(out, 0)
+				_put_varint(out, len(utf8))
+				out += utf8
+				strings[arg_s] = len(strings)
+		if has_pos2:
+			if raw:
+				out += struct.pack('<dd', x2, y2)
+			else:
+				_put_varint(out, _zigzag(int(round(x2)) - ix))
+				_put_varint(out, _zigzag(int(round(y2)) - iy))
+		prev_x, prev_y, prev_type = ix, iy, etype
+	return bytes(out)
+
+
+def decode(data):
+	"""
+	Decode a binary recording.
+
+	A truncated last record (e.g. from an interrupted on-disk recording) is ignored.
+
+	Parameters
+	----------
+	data : bytes
+		binary recording
+
+	Returns
+	-------
+	list
+		events in the JSON recording format
+
+	"""
+	if data[0:4] != MAGIC or len(data) < 6 or data[4] != VERSION:
+		raise ValueError('not a qtghost binary recording')
+	events = []
+	strings = []
+	prev_x = prev_y = prev_type = 0
+	offset = 6
+	size = len(data)
+
+	def varint():
+		nonlocal offset
+		value = 0
+		shift = 0
+		while True:
+			byte = data[offset]
+			offset += 1
+			value |= (byte & 0x7f) << shift
+			if not byte & 0x80:
+				return value
+			shift += 7
+
+	def double2():
+		nonlocal offset
+		values = struct.unpack_from('<dd', data, offset)
+		offset += 16
+		return values
+
+	while offset < size:
+		start = offset
+		try:
+			head = data[offset]
+			offset += 1
+			if not head & SAME_TYPE:
+				prev_type = varint()
+			event = {'posX': 0, 'posY': 0, 'time': varint(), 'type': prev_type}
+			if head & RAW_POS:
+				x, y = double2()
+				prev_x, prev_y = int(round(x)), int(round(y))
+			else:
+				prev_x += _unzigzag(varint())
+				prev_y += _unzigzag(varint())
+				x, y = prev_x, prev_y
+			event['posX'], event['posY'] = x, y
+			if head & ARG_I:
+				event['argI'] = _unzigzag(varint())
+			if head & ARG_S:
+				ref = varint()
+				if ref == 0:
+					length = varint()
+					if offset + length > size:
+						raise IndexError
+					strings.append(data[offset:offset + length].decode('utf-8'))
+					offset += length
+					event['argS'] = strings[-1]
+				else:
+					event['argS'] = strings[ref - 1]
+			if head & POS2:
+				if head & RAW_POS:
+					event['posX2'], event['posY2'] = double2()
+				else:
+					event['posX2'] = prev_x + _unzigzag(varint())
+					event['posY2'] = prev_y + _unzigzag(varint())
+		except (IndexError, struct.error):
+			offset = start
+			break
+		events.append(event)
+	return events
+
+
+def json_to_bin(json_doc):
+	"""Convert a JSON recording (dict) into a binary recording."""
+	return encode(json_doc.get('events', []))
+
+
+def bin_to_json(data):
+	"""Convert a binary recording into a JSON recording (dict)."""
+	return {'events': decode(data)}
+
+
+def encode_indexed(events):
+	"""
+	Encode events into an indexed recording: fixed width records, so the app
+	can map the file and reach any event in O(1) (see Qtghost.load).
+
+	Parameters
+	----------
+	events : list
+		events as found in the JSON recording 'events' array
+
+	Returns
+	-------
+	bytes
+		indexed recording (see qtghost/mappedrecording.h for the format)
+
+	"""
+	strings = {}
+	table = bytearray()
+	records = bytearray(INDEXED_RECORD.size * len(events))
+	for i, event in enumerate(events):
+		arg_s = event.get('argS', '')
+		ref = 0
+		if arg_s:
+			if arg_s not in strings:
+				utf8 = arg_s.encode('utf-8')
+				table += struct.pack('<I', len(utf8)) + utf8
+				strings[arg_s] = len(strings) + 1
+			ref = strings[arg_s]
+		INDEXED_RECORD.pack_into(records, i * INDEXED_RECORD.size,
+			event.get('posX', 0), event.get('posY', 0),
+			event.get('posX2', 0), event.get('posY2', 0),
+			int(event.get('time', 0)), event.get('argI', 0), ref, event.get('type', 0), 0)
+	header = INDEXED_HEADER.pack(INDEXED_MAGIC, INDEXED_VERSION, len(events), INDEXED_RECORD.size,
+		INDEXED_HEADER.size + len(records), len(strings), INDEXED_HEADER.size)
+	return header + bytes(records) + bytes(table)
+
+
+def decode_indexed(data):
+	"""
+	Decode an indexed recording.
+
+	Parameters
+	----------
+	data : bytes
+		indexed recording
+
+	Returns
+	-------
+	list
+		events in the JSON recording format
+
+	"""
+	if data[0:4] != INDEXED_MAGIC or len(data) < INDEXED_HEADER.size:
+		raise ValueError('not a qtghost indexed recording')
+	magic, version, count, record_size, strings_offset, string_count, header_size = \
+		INDEXED_HEADER.unpack_from(data)
+	if version != INDEXED_VERSION:
+		raise ValueError('unsupported indexed recording version')
+	strings = ['']
+	offset = strings_offset
+	for i in range(string_count):
+		length = struct.unpack_from('<I', data, offset)[0]
+		strings.append(data[offset + 4:offset + 4 + length].decode('utf-8'))
+		offset += 4 + length
+	events = []
+	for i in range(count):
+		x, y, x2, y2, time, arg_i, ref, etype, _ = \
+			INDEXED_RECORD.unpack_from(data, header_size + i * record_size)
+		event = {'posX': x, 'posY': y, 'time': time, 'type': etype}
+		if arg_i:
+			event['argI'] = arg_i
+		if ref:
+			event['argS'] = strings[ref]
+		if x2 != 0 or y2 != 0:
+			event['posX2'], event['posY2'] = x2, y2
+		events.append(event)
+	return events
+
+
+def json_to_indexed(json_doc):
+	"""Convert a JSON recording (dict) into an indexed recording."""
+	return encode_indexed(json_doc.get('events', []))
+
+
+def insert_wait(json_doc, index, condition, timeout=0):
+	"""
+	Insert a wait step into a JSON recording (dict), in place.
+
+	Parameters
+	----------
+	index : int
+		the step goes before this event
+	condition : str
+		"name", "name.property" or "name.property=value" (see Qtghost.wait_until)
+	timeout : int
+		ms the play waits at most, 0 for the default (10000)
+
+	"""
+	step = {'posX': 0, 'posY': 0, 'time': 0, 'type': WAIT_EVENT, 'argS': condition}
+	if (timeout):
+		step['argI'] = timeout
+	json_doc['events'].insert(index, step)
+	return json_doc
+
+
+def load_json(data):
+	"""Any recording (JSON, binary or indexed bytes) as a JSON recording (dict)."""
+	if data[0:4] == MAGIC:
+		return bin_to_json(data)
+	if data[0:4] == INDEXED_MAGIC:
+		return {'events': decode_indexed(data)}
+	return json.loads(data.decode('utf-8'))
@@ -1,14 +1,48 @@
 # qtghost.py
-import socket, time, sys, os, struct
+import socket, time, sys, os, struct, json, zlib, base64
+from qtghost3.framering import FrameRing
+
+BINARY_MAGIC = b'QGB\x01' # asks the server for binary framing
+RPC_MAGIC = b'QGB\x02' # asks the server for protocol v2 (see qtghost/protocol.h)
+
+# protocol v2 opcodes
+OP_ACK = 0
+OP_TEXT = 1
+OP_RECORD = 2
+OP_STOP_RECORD = 3
+OP_PLAY = 4
+OP_STEP = 5
+OP_GET_REC = 6
+OP_SET_REC = 7
+OP_GET_BIN = 8
+OP_SET_BIN = 9
+OP_SUBSCRIBE = 10
+OP_UNSUBSCRIBE = 11
+OP_PLAY_REPORT = 12
+OP_VERSION = 13
+OP_SCREENSHOT = 14
+OP_REFERENCE = 15
+OP_ASSERT = 16
+OP_ECHO = 17
+OP_LOAD = 19
+OP_SEEK = 20
+OP_PAUSE = 21
+OP_WAIT = 22
+OP_ERROR = 255
+RPC_MORE = 1
+
+# v1 response command of each v2 response opcode
+RPC_COMMANDS = {OP_ACK: b'-ok', OP_GET_REC: b'-j', OP_GET_BIN: b'-b', OP_SUBSCRIBE: b'-u',
+	OP_PLAY_REPORT: b'-t', OP_VERSION: b'-v', OP_SCREENSHOT: b'-c', OP_ASSERT: b'-a',
+	OP_ECHO: b'-o', OP_WAIT: b'-w', OP_ERROR: b'-x'}
 
 class Qtghost:
 	"""Qtghost provides an interface to a remote QML to record and play events."""
 	lversion = "0.0.1"
 	message = ""
 	bufferSize = 4096
-	client = socket.socket(socket.AF_INET, socket.SOCK_STREAM)
 	
-	def connect(self, ip, port):
+	def connect(self, ip, port, binary=False, rpc=False):
 		"""
 		Connect to remote Qtghost.
 
@@ -20,20 +54,158 @@ class Qtghost:
 			Qtghost address
 		port : int
 			Qtghost port
+		binary : bool
+			use binary framing (u32 little endian length prefix) instead of
+			the "<length>:" text one, falls back to text if not acknowledged
+		rpc : bool
+			use protocol v2 (opcodes, request ids, pipelining, see request()),
+			falls back to text if not acknowledged
 
 		"""
 		self.client.setsockopt(socket.SOL_SOCKET, socket.SO_REUSEADDR, 1)
 		self.client.connect((ip, port))
+		self._select_framing(binary, rpc)
+
+	def connect_local(self, name, binary=False, rpc=False):
+		"""
+		Connect to a remote Qtghost on the same host through a Unix domain
+		socket (see Qtghost::init(const QString &)), no TCP involved.
+
+		Parameters
+		----------
+		name : str
+			local socket name (looked up in the temp dir) or full path
+		binary : bool
+			use binary framing, see connect()
+		rpc : bool
+			use protocol v2, see connect()
+
+		"""
+		if (os.sep not in name):
+			name = os.path.join(os.environ.get('TMPDIR', '/tmp'), name)
+		self.client.close()
+		self.client = socket.socket(socket.AF_UNIX, socket.SOCK_STREAM)
+		self.client.connect(name)
+		self._select_framing(binary, rpc)
+
+	def _select_framing(self, binary, rpc):
+		"""Negotiate binary framing or protocol v2 if asked."""
+		if (rpc):
+			self.rpc = self._negotiate(RPC_MAGIC)
+			self.binary = self.rpc
+		elif (binary):
+			self.binary = self._negotiate(BINARY_MAGIC)
+
+	def _negotiate(self, magic):
+		"""Ask for binary framing or protocol v2, the server echoes the magic back."""
+		self.client.sendall(magic)
+		self.client.settimeout(2)
+		try:
+			self._fill(len(magic))
+			accepted = (self.rxbuf[:len(magic)] == magic)
+			if (accepted):
+				del self.rxbuf[:len(magic)]
+		except socket.timeout:
+			accepted = False
+		self.client.settimeout(None)
+		return accepted
 	
 	def disconnect(self):
 		"""Disconnect from remote Qtghost."""
 		self.client.close()
 	
+	def __init__(self):
+		# one socket per instance, several instances can drive the same app
+		self.client = socket.socket(socket.AF_INET, socket.SOCK_STREAM)
+		self.rxbuf = bytearray()
+		self.binary = False
+		self.rpc = False
+		self.requestId = 0
+		self.responses = {}
+		self.frame = TileFrame()
+
+	def _fill(self, size):
+		"""Read from the socket until at least size bytes are buffered."""
+		while len(self.rxbuf) < size:
+			part = self.client.recv(max(self.bufferSize, size - len(self.rxbuf)))
+			if not part:
+				raise ConnectionError('connection closed by remote Qtghost')
+			self.rxbuf += part
+
+	def recv_frame(self):
+		"""
+		Receive one packet.
+
+		Packets are framed as "<length>:<cmd> <data>", or with binary framing
+		as u32 little endian length then "<cmd> <data>". Streamed responses
+		are split into several packets, all but the last one have '+'
+		appended to cmd ("-j+").
+
+		Returns
+		-------
+		tuple
+			(cmd, data, more): packet command without '+', packet data and
+			if more packets of the same response follow.
+
+		"""
+		if (self.rpc):
+			req_id, op, flags, data = self._recv_rpc()
+			return RPC_COMMANDS.get(op, b''), data, bool(flags & RPC_MORE)
+		if (self.binary):
+			self._fill(4)
+			length = struct.unpack_from('<I', self.rxbuf)[0]
+			self._fill(4 + length)
+			end = self.rxbuf.find(b' ', 4, 4 + length)
+			cmd = bytes(self.rxbuf[4:end])
+			data = bytes(self.rxbuf[end+1:4+length])
+			del self.rxbuf[:4+length]
+			return cmd.rstrip(b'+'), data, cmd.endswith(b'+')
+		while True:
+			index = self.rxbuf.find(b':')
+			end = self.rxbuf.find(b' ', index+1) if index >= 0 else -1
+			if end >= 0:
+				break
+			self._fill(len(self.rxbuf)+1)
+		length = int(self.rxbuf[0:index])
+		cmd = bytes(self.rxbuf[index+1:end])
+		del self.rxbuf[:end+1]
+		self._fill(length)
+		data = bytes(self.rxbuf[:length])
+		del self.rxbuf[:length]
+		return cmd.rstrip(b'+'), data, cmd.endswith(b'+')
+
+	def recv_stream(self, out):
+		"""
+		Receive a response incrementally.
+
+		Every received chunk is written to out as soon as it arrives, so a
+		recording of any length is never fully held in memory.
+
+		Parameters
+		----------
+		out : file
+			binary file-like object to write to
+
+		Returns
+		-------
+		int
+			number of bytes received
+
+		"""
+		total = 0
+		more = True
+		while more:
+			cmd, data, more = self.recv_frame()
+			out.write(data)
+			total += len(data)
+		print('length received: ',total,' cmd:',cmd)
+		return total
+
 	def recvall(self):
 		"""
 		Receive all data.
 
-		Receive all data from remote Qtghost using TCP.
+		Receive a whole response from remote Qtghost using TCP.
 
 		Returns
 		-------
@@ -41,23 +213,13 @@ class Qtghost:
 			Data received from remote.
 
 		"""
-		data = b''
-		length = 0
-		while True:
-			part = self.client.recv(self.bufferSize)
-			if (length == 0):
-				index = part.find(b':')
-				indexcmd = part.find(b'-')
-				length = int(part[0:index])
-				cmd = part[index+1:indexcmd+2]
-				data = part[indexcmd+3:]
-				print('length to receive: ',length,' cmd:',cmd)
-			else:
-				data += part
-			if (len(data) >= length):
-				break
-		return data
-	
+		parts = []
+		more = True
+		while more:
+			cmd, data, more = self.recv_frame()
+			parts.append(data)
+		return b''.join(parts)
+
 	def send_pkt(self, msg):
 		"""
 		Send packet.
@@ -70,14 +232,138 @@ class Qtghost:
 			message to send
 
 		"""
-		length = len(msg)
-		msg = bytearray(str(length)+":"+msg, 'utf-8') #adding header
+		length = self.send_raw(msg.encode('utf-8'))
+		if (length is not None):
+			print('bytes sent, length:',length)
+
+	def send_raw(self, payload):
+		"""
+		Send a packet with a binary payload.
+
+		Parameters
+		----------
+		payload : bytes
+			command and its data
+
+		Returns
+		-------
+		int
+			payload length, None on error
+
+		"""
+		if (self.rpc):
+			# v1 command wrapped in a v2 request
+			self.request(OP_TEXT, payload)
+			return len(payload)
+		if (self.binary):
+			head = struct.pack('<I', len(payload))
+		else:
+			head = bytes(str(len(payload))+":", 'utf-8') #adding header
 		try:
-			self.client.sendall(msg)
+			if (len(payload) < 65536):
+				self.client.sendall(head + payload)
+			else:
+				# don't copy big payloads just to prepend the header
+				self.client.sendall(head)
+				self.client.sendall(payload)
 		except:
 			print('error while sending data')
-			return
-		print('bytes sent, length:',length)
+			return None
+		return len(payload)
+
+	def request(self, op, args=b''):
+		"""
+		Send a protocol v2 request without waiting for its response.
+
+		Requests can be pipelined, every response carries the id of its
+		request (see response()).
+
+		Parameters
+		----------
+		op : int
+			opcode (OP_*)
+		args : bytes
+			arguments, little endian (see qtghost/protocol.h)
+
+		Returns
+		-------
+		int
+			request id
+
+		"""
+		self.requestId = (self.requestId + 1) & 0xffffffff
+		payload = struct.pack('<BI', op, self.requestId) + args
+		self.client.sendall(struct.pack('<I', len(payload)) + payload)
+		return self.requestId
+
+	def _recv_rpc(self):
+		"""Receive one protocol v2 response: (request id, opcode, flags, data)."""
+		self._fill(4)
+		length = struct.unpack_from('<I', self.rxbuf)[0]
+		self._fill(4 + length)
+		req_id, op, flags = struct.unpack_from('<IBB', self.rxbuf, 4)
+		data = bytes(self.rxbuf[10:4+length])
+		del self.rxbuf[:4+length]
+		return req_id, op, flags, data
+
+	def response(self, req_id):
+		"""
+		Wait for the whole response to a protocol v2 request.
+
+		Responses to other requests received meanwhile are kept for their
+		own response() call.
+
+		Parameters
+		----------
+		req_id : int
+			request id returned by request()
+
+		Returns
+		-------
+		tuple
+			(opcode, data), OP_ACK for requests without data
+
+		"""
+		parts = []
+		while True:
+			queued = self.responses.get(req_id)
+			if (queued):
+				rid, op, flags, data = queued.pop(0)
+			else:
+				rid, op, flags, data = self._recv_rpc()
+				if (rid != req_id):
+					self.responses.setdefault(rid, []).append((rid, op, flags, data))
+					continue
+			if (op == OP_ERROR):
+				raise RuntimeError(data.decode())
+			parts.append(data)
+			if (not flags & RPC_MORE):
+				self.responses.pop(req_id, None)
+				return op, b''.join(parts)
+
+	def call(self, op, args=b''):
+		"""Send a protocol v2 request and wait for its response, see request()."""
+		return self.response(self.request(op, args))
+
+	def echo(self, data):
+		"""
+		Send data and receive it back (transport benchmark).
+
+		Parameters
+		----------
+		data : bytes
+			payload
+
+		Returns
+		-------
+		bytes
+			echoed payload
+
+		"""
+		if (self.rpc):
+			return self.call(OP_ECHO, data)[1]
+		self.send_raw(b'-o ' + data)
+		return self.recvall()
         
 	def setJSON(self, filename):
 		"""
@@ -108,28 +394,262 @@ class Qtghost:
 
 		"""
 		self.send_pkt('-g')
-		data = self.recvall()
-		#print ('Received message:',data.decode())
-		print('Received message length : ', len(data))
-		with open(filename, 'w') as f:
-			f.write(data.decode())
+		with open(filename, 'wb') as f:
+			length = self.recv_stream(f)
+		print('Received message length : ', length)
         
-	def play(self):
-		"""Sends play command to remote Qtghost."""
-		self.send_pkt('-p')
+	def setBin(self, filename):
+		"""
+		Set remote binary recording.
+
+		Send a binary recording file (see ghostbin.py) to remote Qtghost.
+
+		Parameters
+		----------
+		filename : string
+			filename to send
+
+		"""
+		with open(filename, 'rb') as f:
+			data = f.read()
+		length = self.send_raw(b'-k ' + data)
+		if (length is not None):
+			print('bytes sent, length:',length)
+
+	def getBin(self, filename):
+		"""
+		Get binary recording from remote Qtghost.
+
+		Ask for all recorded events in the compact binary format.
+
+		Parameters
+		----------
+		filename : string
+			filename to store locally the binary recording
+
+		"""
+		self.send_pkt('-b')
+		with open(filename, 'wb') as f:
+			length = self.recv_stream(f)
+		print('Received message length : ', length)
+
+	def play(self, speed=None, max_gap=None, fast=False, start=None, end=None, checkpoint=None, force_frames=False):
+		"""
+		Sends play command to remote Qtghost.
+
+		Parameters
+		----------
+		speed : float
+			speed multiplier, 1 (default) plays at the recorded pace
+		max_gap : int
+			cap (ms) on any single delay after scaling
+		fast : bool
+			ignore recorded delays, play as fast as possible
+		start : int
+			index of the first event played (default 0)
+		end : int
+			index of the event the play stops at (default: the end)
+		checkpoint : int
+			hash the window every checkpoint events played, the hashes are
+			in the play report (see first_divergence)
+		force_frames : bool
+			request a frame after every event played, so the frame latency
+			of the play report covers events that change nothing
+
+		"""
+		cmd = '-p'
+		if (speed is not None):
+			cmd += ' --speed ' + str(speed)
+		if (max_gap is not None):
+			cmd += ' --max-gap ' + str(max_gap)
+		if (fast):
+			cmd += ' --fast'
+		if (start is not None):
+			cmd += ' --from ' + str(start)
+		if (end is not None):
+			cmd += ' --to ' + str(end)
+		if (checkpoint is not None):
+			cmd += ' --checkpoint ' + str(checkpoint)
+		if (force_frames):
+			cmd += ' --force-frames'
+		self.send_pkt(cmd)
+
+	def seek(self, index=None, time=None):
+		"""
+		Moves the play cursor of remote Qtghost, skipped events are not played.
+
+		Parameters
+		----------
+		index : int
+			event index
+		time : int
+			recorded time (ms since the recording started), used if index is None
+
+		"""
+		by_time = index is None
+		value = time if by_time else index
+		if (self.rpc):
+			self.call(OP_SEEK, struct.pack('<Bq', by_time, value))
+		else:
+			self.send_pkt(('--seek-time ' if by_time else '--seek ') + str(value))
+
+	def wait_until(self, condition, timeout=None):
+		"""
+		Waits until a condition holds in remote Qtghost, checked on property
+		change notifications (no polling).
+
+		Parameters
+		----------
+		condition : str
+			"name" (an object with this objectName exists), "name.property"
+			(the property is true, e.g. "dialog.visible") or
+			"name.property=value" (e.g. "list.count=3"); no spaces without rpc
+		timeout : int
+			ms before giving up (default 10000)
+
+		Returns
+		-------
+		dict
+			condition, met (False on timeout) and ms waited
+
+		"""
+		if (self.rpc):
+			data = self.call(OP_WAIT, struct.pack('<I', timeout or 0) + condition.encode())[1]
+		else:
+			cmd = '-w ' + condition
+			if (timeout is not None):
+				cmd += ' --wait-timeout ' + str(timeout)
+			self.send_pkt(cmd)
+			data = self.recvall()
+		return json.loads(data.decode())
+
+	def wait_step(self, condition, timeout=None):
+		"""
+		Records a wait step: while playing, the next events wait for the
+		condition (see wait_until) instead of their recorded delays, so a
+		fast play doesn't race slow screens.
+
+		Parameters
+		----------
+		condition : str
+			condition, see wait_until
+		timeout : int
+			ms the play waits at most (default 10000)
+
+		"""
+		cmd = '--wait-step ' + condition
+		if (timeout is not None):
+			cmd += ' --wait-timeout ' + str(timeout)
+		self.send_pkt(cmd)
+
+	def pause(self):
+		"""Pauses the play of remote Qtghost."""
+		self.send_pkt('--pause')
+
+	def resume(self):
+		"""Resumes the paused play of remote Qtghost."""
+		self.send_pkt('--resume')
+
+	def play_report(self, per_event=False):
+		"""
+		Returns the timing report of the last (or current) play.
+
+		Parameters
+		----------
+		per_event : bool
+			also return the lateness (us) of each injected event ('perEvent')
+
+		Returns
+		-------
+		dict
+			speed, maxGap, fast, events (played), total, requested, actual and
+			drift (ms, pauses excluded), end (index the play stops at), paused,
+			checkpoints (index, time and hash of the window), waits (condition,
+			met and ms of each wait step), lateness summary (count, mean, max, p50, p95, p99 in us),
+			frames: input to frame latency and frame time summaries with their
+			histograms ([upper bound us, count] pairs), frames, dropped frames
+			and events still waiting for a frame (unmatched)
+
+		"""
+		self.send_pkt('-t --lateness' if per_event else '-t')
+		return json.loads(self.recvall().decode())
 	
 	def step(self):
 		"""Sends step-play command to remote Qtghost."""
 		self.send_pkt('-e')
 	
-	def rec(self):
-		"""Sends record command to remote Qtghost."""
-		self.send_pkt('-r')
+	def rec(self, capture=None, rotate=None, touch_coalesce=None):
+		"""
+		Sends record command to remote Qtghost.
+
+		Parameters
+		----------
+		capture : str
+			record to this file (binary format, app side) instead of memory,
+			written by a background thread so long recordings use constant
+			memory and survive a crash (see ghostbin.decode)
+		rotate : float
+			capture file size (MB) that starts a new file (name.1.qgr...)
+		touch_coalesce : int
+			merge touch moves closer than this (ms) to the previous stored touch
+			event, per point (16: one 60 Hz frame, 0: store every move)
+
+		"""
+		cmd = '-r'
+		if (touch_coalesce is not None):
+			cmd += ' --touch-coalesce ' + str(touch_coalesce)
+		if (capture is not None):
+			cmd += ' --capture ' + capture
+		if (rotate is not None):
+			cmd += ' --rotate ' + str(rotate)
+		self.send_pkt(cmd)
 	
+	def load(self, path):
+		"""
+		Make remote Qtghost play an indexed recording file in place.
+
+		The file is mapped, not loaded, so playback of a recording of any
+		size can start at once (see ghostbin.encode_indexed, 'ghost.py toidx').
+
+		Parameters
+		----------
+		path : str
+			indexed recording path, on the app side
+
+		"""
+		if (self.rpc):
+			self.call(OP_LOAD, path.encode())
+		else:
+			self.send_pkt('-l ' + path)
+
 	def stop_rec(self):
 		"""Sends stop recording command to remote Qtghost."""
 		self.send_pkt('-s')
         
+	def subscribe(self, callback, live_only=False):
+		"""
+		Follow a recording live.
+
+		Every event recorded by remote Qtghost is pushed in small batches,
+		callback is called with each batch until it returns False.
+
+		Parameters
+		----------
+		callback : function
+			called with a list of events (JSON recording format)
+		live_only : bool
+			if True remote Qtghost does not keep the pushed events
+
+		"""
+		self.send_pkt('-u --live-only' if live_only else '-u')
+		while True:
+			cmd, data, more = self.recv_frame()
+			if (cmd != b'-u'):
+				continue
+			if (callback(json.loads(data.decode())['events']) == False):
+				break
+		self.send_pkt('--unsubscribe')
+
 	def get_ver(self):
 		"""Returns the remote library version."""
 		self.send_pkt('-v')
@@ -140,9 +660,258 @@ class Qtghost:
 		"""Returns the class version."""
 		return self.lversion
 	
-	def getScreenshot(self):
-		"""Get remote screenshot"""
-		self.send_pkt('-c')
+	def getScreenshot(self, fmt='png', level=None, region=None, filename=None):
+		"""
+		Get remote screenshot.
+
+		Parameters
+		----------
+		fmt : string
+			'png', 'raw' (RGBA8888), 'fast' (zlib compressed RGBA8888) or
+			'diff' (only the tiles changed since the previous 'diff' screenshot)
+		level : int
+			PNG compression level (0-9)
+		region : tuple
+			(x, y, w, h) sub-rectangle, whole window if None
+		filename : string
+			where to save it, default scr.png (png) or scr.pam (raw, fast)
+
+		"""
+		cmd = '-c --format ' + fmt
+		if (level is not None):
+			cmd += ' --level ' + str(level)
+		if (region is not None):
+			cmd += ' --region ' + ','.join(str(v) for v in region)
+		self.send_pkt(cmd)
 		data = self.recvall()
-		with open("scr.png", 'wb') as f:
-			f.write(data)
+		if (fmt == 'png'):
+			with open(filename or "scr.png", 'wb') as f:
+				f.write(data)
+			return
+		if (fmt == 'diff'):
+			changed = self.frame.apply(data)
+			print('changed tiles: ', changed)
+			width, height, pixels = self.frame.width, self.frame.height, self.frame.pixels
+		else:
+			width, height, pixels = decode_raw(data)
+		write_pam(filename or "scr.pam", width, height, pixels)
+
+
+	def setReference(self, ref_id, filename):
+		"""
+		Upload a reference image for visual assertions.
+
+		Sent once, then compared remotely by assertFrame, no screenshot
+		comes back.
+
+		Parameters
+		----------
+		ref_id : int
+			reference id, replaces a previous image with the same id
+		filename : string
+			image file (png, jpg, ...), None removes the reference
+
+		"""
+		data = b''
+		if (filename is not None):
+			with open(filename, 'rb') as f:
+				data = f.read()
+		self.send_raw(bytes('-n ' + str(ref_id) + ' ', 'utf-8') + data)
+
+	def assertFrame(self, ref_id, region=None, tolerance=None, max_diff=None, phash=None, mask=None):
+		"""
+		Compare the remote frame to a reference image (see setReference).
+
+		Parameters
+		----------
+		ref_id : int
+			reference id
+		region : tuple
+			(x, y, w, h) frame sub-rectangle, whole window if None
+		tolerance : int
+			per channel difference (0-255) still counted as equal
+		max_diff : float
+			fraction (0-1) of differing pixels still passing, default 0
+		phash : int
+			if set, pass on perceptual hash distance (0-64 bits) instead
+		mask : string
+			if set, the PNG mask of the differing pixels is saved there
+
+		Returns
+		-------
+		dict
+			pass, reference, diffPixels, diffRatio, diffScore (0-1),
+			hashDistance, or error
+
+		"""
+		cmd = '-a ' + str(ref_id)
+		if (region is not None):
+			cmd += ' --region ' + ','.join(str(v) for v in region)
+		if (tolerance is not None):
+			cmd += ' --tolerance ' + str(tolerance)
+		if (max_diff is not None):
+			cmd += ' --max-diff ' + str(max_diff)
+		if (phash is not None):
+			cmd += ' --phash ' + str(phash)
+		if (mask is not None):
+			cmd += ' --mask'
+		self.send_pkt(cmd)
+		result = json.loads(self.recvall().decode())
+		if ('mask' in result):
+			with open(mask, 'wb') as f:
+				f.write(base64.b64decode(result.pop('mask')))
+		return result
+
+	def shm_open(self, name, slots=4):
+		"""
+		Create the shared memory frame ring on remote Qtghost (same host).
+
+		Frames are then exported raw into the ring, only small notifications
+		go through the connection (see shm_frame and shm_stream).
+
+		Parameters
+		----------
+		name : string
+			ring file name (in /dev/shm or the temp dir) or full path
+		slots : int
+			number of frame slots
+
+		Returns
+		-------
+		FrameRing
+			mapped ring
+
+		"""
+		self.send_pkt('-m ' + name + ' --slots ' + str(slots))
+		description = json.loads(self.recvall().decode())
+		if ('error' in description):
+			raise RuntimeError(description['error'])
+		return FrameRing(description['path'])
+
+	def shm_frame(self, ring):
+		"""
+		Export the current frame to the ring.
+
+		Returns
+		-------
+		tuple
+			(width, height, pixels, timestamp), see FrameRing.read
+
+		"""
+		self.send_pkt('--shm-frame')
+		return ring.read(json.loads(self.recvall().decode())['seq'])
+
+	def shm_stream(self, ring, callback):
+		"""
+		Export every rendered frame until callback returns False.
+
+		Parameters
+		----------
+		ring : FrameRing
+			mapped ring
+		callback : function
+			called with each frame (see FrameRing.read), None for frames
+			overwritten before they could be read
+
+		"""
+		self.send_pkt('--shm-stream')
+		while True:
+			cmd, data, more = self.recv_frame()
+			if (cmd != b'-m'):
+				continue
+			if (callback(ring.read(json.loads(data.decode())['seq'])) == False):
+				break
+		self.send_pkt('--shm-stop')
+
+class TileFrame:
+	"""Rebuilds full frames from 'diff' ('QGTD') screenshots."""
+
+	def __init__(self):
+		self.width = 0
+		self.height = 0
+		self.pixels = bytearray()
+
+	def apply(self, data):
+		"""
+		Apply a 'diff' screenshot to the current frame.
+
+		Returns
+		-------
+		int
+			number of changed tiles
+
+		"""
+		if (data[0:4] != b'QGTD'):
+			raise ValueError('not a qtghost diff screenshot')
+		width, height, tile, flags, count = struct.unpack_from('<IIHBI', data, 4)
+		offset = 19
+		if (flags & 1 or width != self.width or height != self.height):
+			self.width, self.height = width, height
+			self.pixels = bytearray(width * height * 4)
+		tiles = [struct.unpack_from('<HH', data, offset + i * 4) for i in range(count)]
+		offset += count * 4
+		blob = zlib.decompress(data[offset+4:])
+		pos = 0
+		for tx, ty in tiles:
+			x, y = tx * tile, ty * tile
+			w, h = min(tile, width - x), min(tile, height - y)
+			for row in range(y, y + h):
+				start = (row * width + x) * 4
+				self.pixels[start:start + w * 4] = blob[pos:pos + w * 4]
+				pos += w * 4
+		return count
+
+
+def first_divergence(good, bad):
+	"""
+	Compare the checkpoints of two plays of the same recording.
+
+	Parameters
+	----------
+	good, bad : dict
+		play reports (see Qtghost.play_report), played with the same checkpoint interval
+
+	Returns
+	-------
+	tuple
+		(last matching index, first differing index): the events to look at are
+		in between, None if every common checkpoint matches; the last matching
+		index is 0 if the first checkpoint already differs
+
+	"""
+	hashes = {c['index']: c['hash'] for c in good['checkpoints']}
+	last = 0
+	for checkpoint in bad['checkpoints']:
+		expected = hashes.get(checkpoint['index'])
+		if (expected is None):
+			continue
+		if (expected != checkpoint['hash']):
+			return last, checkpoint['index']
+		last = checkpoint['index']
+	return None
+
+
+def decode_raw(data):
+	"""
+	Decode a raw ('QGRW') or fast ('QGRZ') screenshot.
+
+	Returns
+	-------
+	tuple
+		(width, height, RGBA8888 pixels)
+
+	"""
+	width, height = struct.unpack_from('<II', data, 4)
+	if (data[0:4] == b'QGRZ'):
+		return width, height, zlib.decompress(data[16:])
+	if (data[0:4] == b'QGRW'):
+		return width, height, data[12:]
+	raise ValueError('not a qtghost raw screenshot')
+
+
+def write_pam(filename, width, height, pixels):
+	"""Save RGBA8888 pixels as a PAM (netpbm) image."""
+	with open(filename, 'wb') as f:
+		f.write(('P7\nWIDTH %d\nHEIGHT %d\nDEPTH 4\nMAXVAL 255\nTUPLTYPE RGB_ALPHA\nENDHDR\n'
+			% (width, height)).encode())
+		f.write(pixels)
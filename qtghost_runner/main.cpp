@@ -0,0 +1,268 @@
+/*
+* MIT License
+*
+* Copyright (c) 2018 Antonio Alecrim Jr
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*/
+
+/*
+ * qtghost_runner: headless batch replay of a recording.
+ *
+ * Loads a QML file (under the offscreen platform unless -platform or QT_QPA_PLATFORM says
+ * otherwise), attaches Qtghost without starting its server, replays a JSON, binary or
+ * indexed recording and writes a JSON result file: play reports (timings, drift, lateness) of every
+ * run, wall time and, optionally, the final screenshot.
+ *
+ * exit code: 0 success, 1 bad arguments or load failure, 2 timeout.
+ */
+
+#include <QGuiApplication>
+#include <QQmlApplicationEngine>
+#include <QQuickWindow>
+#include <QSGRendererInterface>
+#include <QCommandLineParser>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QFileInfo>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QTimer>
+#include <QUrl>
+#include "qtghost.h"
+#include "mappedrecording.h"
+#include "recbinary.h"
+
+static const int settle_default = 100; ///< \brief default wait (ms) after the last event, before the screenshot.
+
+/**
+  \brief loads a recording file into ghost memory, binary ("QGRB" magic) or JSON, or maps it
+  if it is an indexed recording ("QGRX" magic, nothing is loaded).
+  \param ghost target Qtghost.
+  \param path recording file.
+  \param error set to a human readable reason on failure.
+  \return number of loaded events, -1 on failure.
+*/
+static int load_recording(Qtghost *ghost, const QString &path, QString *error)
+{
+    QFile file(path);
+
+    if (!file.open(QIODevice::ReadOnly)) {
+        *error = file.errorString();
+        return -1;
+    }
+    if (file.peek(4) == rec_indexed_magic) {
+        file.close();
+        if (!ghost->mapEvents(path)) {
+            *error = "invalid indexed recording";
+            return -1;
+        }
+        return ghost->getPlayReport().value("total").toInt();
+    }
+
+    QByteArray data = file.readAll();
+    if (data.startsWith(rec_binary_magic)) {
+        if (!ghost->setBinaryEvents(data)) {
+            *error = "invalid binary recording";
+            return -1;
+        }
+    }
+    else {
+        QJsonParseError parse;
+        QJsonDocument doc = QJsonDocument::fromJson(data, &parse);
+        if (doc.isNull()) {
+            *error = parse.errorString();
+            return -1;
+        }
+        ghost->setJSONEvents(doc);
+    }
+
+    return ghost->getPlayReport().value("total").toInt();
+}
+
+/**
+  \brief writes the result document to a file, or to stdout for "-".
+  \return false if the file couldn't be written.
+*/
+static bool write_results(const QString &path, const QJsonObject &results)
+{
+    QFile file;
+    QByteArray data = QJsonDocument(results).toJson();
+
+    if (path == "-") {
+        file.open(stdout, QIODevice::WriteOnly);
+    }
+    else {
+        file.setFileName(path);
+        if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+            qWarning() << "Qtghost:" << "can't write results:" << path << file.errorString();
+            return false;
+        }
+    }
+
+    return file.write(data) == data.size();
+}
+
+/**
+  \brief min/mean/max of a numeric field over the play reports of every run.
+*/
+static QJsonObject summarize(const QJsonArray &runs, const QString &field)
+{
+    QJsonObject obj;
+    double sum = 0, lo = 0, hi = 0;
+
+    for (int i = 0; i < runs.size(); i++) {
+        double v = runs.at(i).toObject().value(field).toDouble();
+        lo = i == 0 ? v : qMin(lo, v);
+        hi = i == 0 ? v : qMax(hi, v);
+        sum += v;
+    }
+    obj.insert("min", lo);
+    obj.insert("mean", runs.isEmpty() ? 0.0 : sum / runs.size());
+    obj.insert("max", hi);
+
+    return obj;
+}
+
+int main(int argc, char *argv[])
+{
+    // headless by default; Qt Quick has no OpenGL on the offscreen platform, render in software
+    if (qEnvironmentVariableIsEmpty("QT_QPA_PLATFORM"))
+        qputenv("QT_QPA_PLATFORM", "offscreen");
+    if (qgetenv("QT_QPA_PLATFORM") == "offscreen" && qEnvironmentVariableIsEmpty("QT_QUICK_BACKEND"))
+        QQuickWindow::setSceneGraphBackend(QSGRendererInterface::Software);
+
+    QGuiApplication app(argc, argv);
+    QCommandLineParser parser;
+
+    parser.setApplicationDescription("Replays a qtghost recording against a QML file, headless.");
+    parser.addHelpOption();
+    parser.addPositionalArgument("qml", "QML file to load (root must be a Window).");
+    parser.addPositionalArgument("recording", "recording to replay (JSON, binary or indexed).");
+    QCommandLineOption fastOpt("fast", "ignore recorded delays, play as fast as the event loop allows.");
+    QCommandLineOption speedOpt("speed", "speed multiplier (default 1, real time).", "x", "1");
+    QCommandLineOption maxGapOpt("max-gap", "cap (ms) on any single delay.", "ms", "-1");
+    QCommandLineOption fromOpt("from", "index of the first event played (default 0).", "n", "0");
+    QCommandLineOption toOpt("to", "index of the event the play stops at (default: the end).", "n", "-1");
+    QCommandLineOption checkpointOpt("checkpoint", "hashes the window every n events (default 0, none).", "n", "0");
+    QCommandLineOption repeatOpt("repeat", "plays the recording n times (default 1).", "n", "1");
+    QCommandLineOption settleOpt("settle", "wait (ms) after the last event before the screenshot.",
+                                 "ms", QString::number(settle_default));
+    QCommandLineOption timeoutOpt("timeout", "gives up after ms (default: no timeout).", "ms", "0");
+    QCommandLineOption outputOpt(QStringList() << "o" << "output", "result file, - for stdout (default).", "file", "-");
+    QCommandLineOption shotOpt(QStringList() << "s" << "screenshot", "saves the final frame to file.", "file");
+    parser.addOptions(QList<QCommandLineOption>() << fastOpt << speedOpt << maxGapOpt << fromOpt << toOpt << checkpointOpt << repeatOpt
+                      << settleOpt << timeoutOpt << outputOpt << shotOpt);
+    parser.process(app);
+
+    const QStringList args = parser.positionalArguments();
+    if (args.size() != 2) {
+        parser.showHelp(1);
+    }
+
+    playOptions opts;
+    opts.fast = parser.isSet(fastOpt);
+    opts.speed = parser.value(speedOpt).toDouble();
+    opts.maxGap = parser.value(maxGapOpt).toInt();
+    opts.from = parser.value(fromOpt).toInt();
+    opts.to = parser.value(toOpt).toInt();
+    opts.checkpoint = qMax(parser.value(checkpointOpt).toInt(), 0);
+    const int repeat = qMax(parser.value(repeatOpt).toInt(), 1);
+    const int settle = qMax(parser.value(settleOpt).toInt(), 0);
+    const int timeout = parser.value(timeoutOpt).toInt();
+    const QString output = parser.value(outputOpt);
+    const QString shot = parser.value(shotOpt);
+    if (opts.speed <= 0) {
+        qWarning() << "Qtghost:" << "invalid speed:" << parser.value(speedOpt);
+        return 1;
+    }
+
+    QQmlApplicationEngine engine;
+    engine.load(QUrl::fromUserInput(args.at(0), QDir::currentPath()));
+    if (engine.rootObjects().isEmpty())
+        return 1;
+
+    Qtghost *ghost = new Qtghost(&app, &engine);
+    QString error;
+    int events = load_recording(ghost, args.at(1), &error);
+    if (events < 0) {
+        qWarning() << "Qtghost:" << "can't load recording:" << args.at(1) << error;
+        return 1;
+    }
+    ghost->setPlayOptions(opts);
+
+    QJsonObject results;
+    QJsonArray runs;
+    QElapsedTimer wall, total;
+    results.insert("qml", args.at(0));
+    results.insert("recording", args.at(1));
+    results.insert("events", events);
+    results.insert("platform", QGuiApplication::platformName());
+
+    auto finish = [&](bool timedOut) {
+        if (!runs.isEmpty()) {
+            // the frame of the last events is swapped after playFinished
+            QJsonObject last = runs.last().toObject();
+            last.insert("frames", ghost->getPlayReport().value("frames"));
+            runs.replace(runs.size() - 1, last);
+        }
+        results.insert("runs", runs);
+        results.insert("drift", summarize(runs, "drift"));
+        results.insert("wall", summarize(runs, "wall"));
+        results.insert("total", static_cast<double>(total.elapsed()));
+        results.insert("timeout", timedOut);
+        if (!shot.isEmpty()) {
+            QQuickWindow *view = qobject_cast<QQuickWindow*>(engine.rootObjects().first());
+            if (view && view->grabWindow().save(shot)) {
+                results.insert("screenshot", QFileInfo(shot).absoluteFilePath());
+            }
+            else {
+                qWarning() << "Qtghost:" << "can't save screenshot:" << shot;
+            }
+        }
+        bool written = write_results(output, results);
+        app.exit(timedOut ? 2 : (written ? 0 : 1));
+    };
+
+    QObject::connect(ghost, &Qtghost::playFinished, [&](QJsonObject report) {
+        report.insert("wall", static_cast<double>(wall.elapsed()));
+        runs.append(report);
+        if (runs.size() < repeat) {
+            // restart from the event loop, not from inside the play timer slot
+            QTimer::singleShot(0, ghost, [&]() {
+                wall.start();
+                ghost->play();
+            });
+        }
+        else {
+            QTimer::singleShot(settle, &app, [&]() { finish(false); });
+        }
+    });
+    if (timeout > 0) {
+        QTimer::singleShot(timeout, &app, [&]() { finish(true); });
+    }
+
+    total.start();
+    wall.start();
+    ghost->play();
+
+    return app.exec();
+}
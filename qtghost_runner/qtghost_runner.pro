@@ -0,0 +1,24 @@
+QT += quick
+CONFIG += c++11 console
+CONFIG -= app_bundle
+
+# The following define makes your compiler emit warnings if you use
+# any feature of Qt which as been marked deprecated (the exact warnings
+# depend on your compiler). Please consult the documentation of the
+# deprecated API in order to know how to port your code away from it.
+DEFINES += QT_DEPRECATED_WARNINGS
+
+SOURCES += \
+        main.cpp
+
+# Default rules for deployment.
+qnx: target.path = /tmp/$${TARGET}/bin
+else: unix:!android: target.path = /opt/$${TARGET}/bin
+!isEmpty(target.path): INSTALLS += target
+
+win32:CONFIG(release, debug|release): LIBS += -L$$PWD/../build-qtghost-Desktop_Qt_5_10_1_MinGW_32bit-Debug/release/ -lqtghost
+else:win32:CONFIG(debug, debug|release): LIBS += -L$$PWD/../build-qtghost-Desktop_Qt_5_10_1_MinGW_32bit-Debug/debug/ -lqtghost
+else:unix: LIBS += -L$$PWD/../build-qtghost-Desktop_Qt_5_10_1_MinGW_32bit-Debug/ -lqtghost
+
+INCLUDEPATH += $$PWD/../qtghost
+DEPENDPATH += $$PWD/../qtghost
@@ -0,0 +1,13 @@
+QT += quick concurrent testlib
+CONFIG += c++11 console testcase
+CONFIG -= app_bundle
+TARGET = qtghost_unit
+
+# the library is built in, so its internals can be tested directly
+DEFINES += QTGHOST_LIBRARY
+DEFINES += QT_DEPRECATED_WARNINGS
+
+include(../qtghost/qtghost.pri)
+
+SOURCES += \
+        unit.cpp
@@ -0,0 +1,1049 @@
+/*
+* MIT License
+*
+* Copyright (c) 2018 Antonio Alecrim Jr
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*/
+
+/*
+ * qtghost_unit: behaviour tests of the library's parsers and codecs (QtTest).
+ *
+ *   qtghost_unit -platform offscreen
+ * A single test can be run by name, e.g. qtghost_unit timeIndex.
+ */
+
+#include <QtTest>
+#include <QGuiApplication>
+#include <QQmlApplicationEngine>
+#include <QLocalSocket>
+#include <QLoggingCategory>
+#include <QtEndian>
+#include "capture.h"
+#include "eventstore.h"
+#include "mappedrecording.h"
+#include "pathsimplifier.h"
+#include "playback.h"
+#include "protocol.h"
+#include "qtghost.h"
+#include "recbinary.h"
+#include "ringbuffer.h"
+#include "server.h"
+#include "touchtrack.h"
+#include "waitcondition.h"
+
+class QtghostUnit : public QObject
+{
+    Q_OBJECT
+
+    QList<recEvent> events; ///< \brief codec sample, every field and encoding path.
+
+    /**
+      \brief encodes the codec sample.
+      \param ends stream size after each record, output (may be null).
+      \return binary recording.
+    */
+    QByteArray encode_sample(QList<int> *ends = nullptr) const;
+    /**
+      \brief compares two events field by field.
+      \param actual decoded event.
+      \param expected original event.
+    */
+    void compare_events(const recEvent &actual, const recEvent &expected) const;
+
+private slots:
+    void initTestCase();
+    void recBinaryRoundTrip();
+    void recBinaryTruncated();
+    void recBinaryInvalid_data();
+    void recBinaryInvalid();
+    void setBinaryEventsTruncated();
+    void ringBufferWrap();
+    void ringBufferGrowWrapped();
+    void packetSplitting_data();
+    void packetSplitting();
+    void opcodeForCommand();
+    void captureQueue();
+    void eventStoreSnapshot();
+    void eventStoreAppendMapped();
+    void timeIndex_data();
+    void timeIndex();
+    void waitConditionParse_data();
+    void waitConditionParse();
+    void waitConditionIsMet();
+    void objectIndexRelease();
+    void pathSimplifier_data();
+    void pathSimplifier();
+    void touchRecordSlots();
+    void touchRecordCoalescing();
+    void touchRecordFlushPending();
+    void touchReplayFrames();
+    void touchCancel();
+};
+
+/**
+  \brief makes a recorded event.
+  \return event, see recEvent for the parameters.
+*/
+static recEvent make_event(QEvent::Type type, QPointF pos, int time, int argI = 0,
+                           const QString &argS = QString(), QPointF pos2 = QPointF())
+{
+    recEvent event;
+
+    event.type = type;
+    event.pos = pos;
+    event.time = time;
+    event.argI = argI;
+    event.argS = argS;
+    event.pos2 = pos2;
+
+    return event;
+}
+
+/**
+  \brief makes a recording for the path simplifier: strokes of moves between other events.
+  \return events, one stroke longer than max_simplify_run.
+*/
+static QVector<recEvent> path_sample()
+{
+    QVector<recEvent> events;
+    QPointF pos(100, 100);
+    quint32 seed = 12345;
+
+    for (int stroke = 0; stroke < 6; stroke++) {
+        int moves = stroke == 3 ? 3 * max_simplify_run / 2 : 40 + 10 * stroke;
+
+        events << make_event(QEvent::MouseButtonPress, pos, 200);
+        for (int i = 0; i < moves; i++) {
+            seed = seed * 1103515245 + 12345;
+            int r = (seed >> 16) & 0xff;
+            // steady speed with some jitter, and a few moves delivered at once
+            pos += QPointF(4 + (r & 1), (r >> 1) % 3 - 1);
+            events << make_event(QEvent::MouseMove, pos, r & 15 ? 8 : 0);
+        }
+        events << make_event(QEvent::MouseButtonRelease, pos, 30)
+               << make_event(QEvent::KeyPress, QPointF(), 50, Qt::Key_A, "a")
+               << make_event(QEvent::MouseMove, pos + QPointF(1, 1), 10)
+               << make_event(QEvent::Wheel, pos, 20, 120, QString(), QPointF(0, 120));
+    }
+
+    return events;
+}
+
+/**
+  \brief makes a touch point as delivered by a device.
+  \return touch point.
+*/
+static QTouchEvent::TouchPoint touch_point(int id, Qt::TouchPointState state, QPointF pos)
+{
+    QTouchEvent::TouchPoint point(id);
+
+    point.setState(state);
+    point.setPos(pos);
+
+    return point;
+}
+
+/**
+  \brief feeds a touch event to a recorder.
+  \param recorder touch recorder.
+  \param type touch event type.
+  \param points touch points of the event.
+  \param now time the event is observed (ms).
+  \param out records, appended.
+  \return TouchRecorder::add().
+*/
+static bool record_touch(TouchRecorder *recorder, QEvent::Type type, const QList<QTouchEvent::TouchPoint> &points,
+                         qint64 now, QVector<recEvent> *out)
+{
+    Qt::TouchPointStates states;
+
+    foreach (const QTouchEvent::TouchPoint &point, points) {
+        states |= point.state();
+    }
+    QTouchEvent event(type, nullptr, Qt::NoModifier, states, points);
+
+    return recorder->add(&event, now, out);
+}
+
+/**
+  \brief describes a touch event: type, then slot, state and position of every point.
+  \return description, e.g. "update 0S10,0 1M105,0".
+*/
+static QString describe_touch(const QTouchEvent *event)
+{
+    QString text;
+
+    switch (event->type()) {
+    case QEvent::TouchBegin: text = "begin"; break;
+    case QEvent::TouchUpdate: text = "update"; break;
+    case QEvent::TouchEnd: text = "end"; break;
+    default: text = "cancel"; break;
+    }
+    foreach (const QTouchEvent::TouchPoint &point, event->touchPoints()) {
+        QChar state = point.state() == Qt::TouchPointPressed ? 'P' : point.state() == Qt::TouchPointMoved ? 'M'
+                    : point.state() == Qt::TouchPointReleased ? 'R' : 'S';
+        text += QString(" %1%2%3,%4").arg(point.id()).arg(state).arg(point.pos().x()).arg(point.pos().y());
+    }
+
+    return text;
+}
+
+/**
+  \brief replays touch records.
+  \param records touch records.
+  \return description of every rebuilt touch event (see describe_touch).
+*/
+static QStringList replay_touch(const QVector<recEvent> &records)
+{
+    TouchPlayer player;
+    QTouchDevice device;
+    QStringList out;
+
+    foreach (const recEvent &rec, records) {
+        if (player.add(rec)) {
+            QTouchEvent *event = player.take(&device, nullptr, static_cast<ulong>(rec.time));
+            out << describe_touch(event);
+            delete event;
+        }
+    }
+
+    return out;
+}
+
+void QtghostUnit::initTestCase()
+{
+    QLoggingCategory::setFilterRules("*.debug=false");
+
+    events << make_event(QEvent::MouseButtonPress, QPointF(100, 200), 0)
+           << make_event(QEvent::MouseMove, QPointF(90, 230), 16)
+           << make_event(QEvent::MouseMove, QPointF(-40, -7), 16)
+           << make_event(QEvent::MouseButtonRelease, QPointF(-40, -7), 1000000)
+           << make_event(QEvent::KeyPress, QPointF(), 5, Qt::Key_A, "a")
+           << make_event(QEvent::KeyRelease, QPointF(), 5, Qt::Key_A, "a")
+           << make_event(QEvent::KeyPress, QPointF(), 5, -3, QString::fromUtf8("\xc3\xa9t\xc3\xa9"))
+           << make_event(QEvent::Wheel, QPointF(12.5, 3.25), 2, 120, QString(), QPointF(0.5, -120))
+           << make_event(QEvent::Wheel, QPointF(10, 10), 2, -120, QString(), QPointF(10, 130))
+           << make_event(QEvent::MouseMove, QPointF(4294967296.0, 1), 3)
+           << make_event(wait_event, QPointF(), 0, 2000, "dialog.visible")
+           << make_event(QEvent::KeyPress, QPointF(), 7, Qt::Key_B, QString::fromUtf8("\xc3\xa9t\xc3\xa9"));
+}
+
+QByteArray QtghostUnit::encode_sample(QList<int> *ends) const
+{
+    RecEncoder encoder;
+    QByteArray out;
+
+    encoder.begin(&out);
+    foreach (const recEvent &event, events) {
+        encoder.encode(event, &out);
+        if (ends)
+            ends->append(out.size());
+    }
+
+    return out;
+}
+
+void QtghostUnit::compare_events(const recEvent &actual, const recEvent &expected) const
+{
+    QCOMPARE(actual.type, expected.type);
+    QCOMPARE(actual.pos, expected.pos);
+    QCOMPARE(actual.time, expected.time);
+    QCOMPARE(actual.argI, expected.argI);
+    QCOMPARE(actual.argS, expected.argS);
+    QCOMPARE(actual.pos2, expected.pos2);
+}
+
+void QtghostUnit::recBinaryRoundTrip()
+{
+    RecDecoder decoder(encode_sample());
+    recEvent event;
+    int count = 0;
+
+    while (decoder.next(&event)) {
+        QVERIFY(count < events.size());
+        compare_events(event, events.at(count));
+        count++;
+    }
+    QCOMPARE(count, events.size());
+    QVERIFY(decoder.isValid());
+    QVERIFY(decoder.atEnd());
+}
+
+void QtghostUnit::recBinaryTruncated()
+{
+    QList<int> ends;
+    QByteArray stream = encode_sample(&ends);
+
+    // every prefix decodes its complete records, and is flagged invalid when it cuts one
+    for (int size = rec_binary_header_size; size < stream.size(); size++) {
+        RecDecoder decoder(stream.left(size));
+        recEvent event;
+        int count = 0;
+
+        while (decoder.next(&event)) {
+            compare_events(event, events.at(count));
+            count++;
+        }
+        int complete = 0;
+        while (complete < ends.size() && ends.at(complete) <= size) {
+            complete++;
+        }
+        QCOMPARE(count, complete);
+        bool boundary = size == rec_binary_header_size || ends.contains(size);
+        QCOMPARE(decoder.isValid(), boundary);
+        QCOMPARE(decoder.isTruncated(), !boundary);
+        QCOMPARE(decoder.atEnd(), boundary);
+        QCOMPARE(decoder.remaining(), size - (complete ? ends.at(complete - 1) : rec_binary_header_size));
+        // a failed record doesn't advance
+        QVERIFY(!decoder.next(&event));
+    }
+}
+
+void QtghostUnit::recBinaryInvalid_data()
+{
+    QTest::addColumn<QByteArray>("stream");
+    QTest::addColumn<bool>("truncated");
+
+    QByteArray header(rec_binary_magic, 4);
+    header.append(static_cast<char>(rec_binary_version));
+    header.append('\0');
+
+    QTest::newRow("empty") << QByteArray() << false;
+    QTest::newRow("short header") << header.left(5) << false;
+    QTest::newRow("bad magic") << QByteArray("QGRJ").append(header.mid(4)) << false;
+    QTest::newRow("bad version") << QByteArray(header).replace(4, 1, "\x7f") << false;
+    // head with a reserved bit set
+    QTest::newRow("reserved head bit") << header + QByteArray("\x80\x05\x00\x00\x00", 5) << false;
+    // argS reference to a string never defined
+    QTest::newRow("string reference") << header + QByteArray("\x04\x05\x00\x00\x00\x01", 6) << false;
+    // string longer than the data left
+    QTest::newRow("string length") << header + QByteArray("\x04\x05\x00\x00\x00\x00\x10" "ab", 9) << true;
+    // varint running past 64 bits
+    QTest::newRow("varint overflow") << header + QByteArray(1, '\x00') + QByteArray(11, '\xff') << false;
+}
+
+void QtghostUnit::recBinaryInvalid()
+{
+    QFETCH(QByteArray, stream);
+    QFETCH(bool, truncated);
+    RecDecoder decoder(stream);
+    recEvent event;
+
+    QVERIFY(!decoder.next(&event));
+    QVERIFY(!decoder.isValid());
+    QCOMPARE(decoder.isTruncated(), truncated);
+}
+
+void QtghostUnit::setBinaryEventsTruncated()
+{
+    QQmlApplicationEngine engine;
+    engine.loadData("import QtQuick 2.0\nimport QtQuick.Window 2.0\nWindow { width: 320; height: 240 }");
+    QVERIFY(!engine.rootObjects().isEmpty());
+    Qtghost ghost(qobject_cast<QGuiApplication*>(qApp), &engine);
+    QList<int> ends;
+    QByteArray stream = encode_sample(&ends);
+
+    // an upload cut anywhere after the header keeps its complete records
+    for (int size = rec_binary_header_size; size <= stream.size(); size++) {
+        QVERIFY(ghost.setBinaryEvents(stream.left(size)));
+        RecDecoder decoder(ghost.getBinaryEvents());
+        recEvent event;
+        int count = 0;
+
+        while (decoder.next(&event)) {
+            compare_events(event, events.at(count));
+            count++;
+        }
+        QVERIFY(decoder.isValid());
+        int complete = 0;
+        while (complete < ends.size() && ends.at(complete) <= size) {
+            complete++;
+        }
+        QCOMPARE(count, complete);
+    }
+
+    // a corrupted record still rejects the whole upload, the recording is left untouched
+    QByteArray corrupted = stream.left(ends.at(2));
+    corrupted.append('\x80');
+    corrupted.append(stream.mid(ends.at(2) + 1));
+    QVERIFY(!ghost.setBinaryEvents(corrupted));
+    QVERIFY(!ghost.setBinaryEvents(stream.left(rec_binary_header_size - 1)));
+    RecDecoder decoder(ghost.getBinaryEvents());
+    recEvent event;
+    int count = 0;
+    while (decoder.next(&event)) {
+        count++;
+    }
+    QCOMPARE(count, events.size());
+}
+
+void QtghostUnit::ringBufferWrap()
+{
+    RingBuffer ring;
+    QByteArray expected;
+    QByteArray data(ring_initial_size, Qt::Uninitialized);
+    int length;
+
+    for (int i = 0; i < data.size(); i++) {
+        data[i] = static_cast<char>(i * 7);
+    }
+    ring.append(data.constData(), 60000);
+    ring.consume(50000);
+    expected = data.mid(50000, 10000);
+
+    // the free space is split: first up to the end of the storage, then from its start
+    char *to = ring.writePointer(&length);
+    QCOMPARE(length, ring.capacity() - 60000);
+    memcpy(to, data.constData(), length);
+    ring.commit(length);
+    expected.append(data.constData(), length);
+    ring.writePointer(&length);
+    QCOMPARE(length, 50000);
+    ring.append(data.constData() + 100, 20000);
+    expected.append(data.constData() + 100, 20000);
+
+    QCOMPARE(ring.capacity(), ring_initial_size);
+    QCOMPARE(ring.size(), expected.size());
+    QCOMPARE(ring.mid(0, ring.size()), expected);
+    for (int offset = 0; offset < expected.size(); offset += 997) {
+        QCOMPARE(ring.at(offset), expected.at(offset));
+    }
+    // a read across the end of the storage
+    int across = ring.capacity() - 50000 - 10;
+    QCOMPARE(ring.mid(across, 20), expected.mid(across, 20));
+
+    ring.consume(ring.size());
+    QCOMPARE(ring.size(), 0);
+    ring.writePointer(&length);
+    QCOMPARE(length, ring.capacity());
+}
+
+void QtghostUnit::ringBufferGrowWrapped()
+{
+    RingBuffer ring;
+    QByteArray data(3 * ring_initial_size, Qt::Uninitialized);
+
+    for (int i = 0; i < data.size(); i++) {
+        data[i] = static_cast<char>(i * 13 + (i >> 8));
+    }
+    ring.append(data.constData(), 40000);
+    ring.consume(30000);
+    ring.append(data.constData() + 40000, 50000);
+
+    // growing unwraps the data, in order
+    ring.append(data.constData() + 90000, 100000);
+    QVERIFY(ring.capacity() > ring_initial_size);
+    QCOMPARE(ring.capacity() & (ring.capacity() - 1), 0);
+    QCOMPARE(ring.mid(0, ring.size()), data.mid(30000, 160000));
+
+    ring.consume(ring.size());
+    ring.squeeze();
+    QCOMPARE(ring.capacity(), ring_initial_size);
+}
+
+void QtghostUnit::packetSplitting_data()
+{
+    QTest::addColumn<bool>("binary");
+    QTest::addColumn<int>("chunk");
+
+    QTest::newRow("text, 1 byte writes") << false << 1;
+    QTest::newRow("text, 7 byte writes") << false << 7;
+    QTest::newRow("text, 4 KB writes") << false << 4096;
+    QTest::newRow("binary, 1 byte writes") << true << 1;
+    QTest::newRow("binary, 7 byte writes") << true << 7;
+    QTest::newRow("binary, 4 KB writes") << true << 4096;
+}
+
+void QtghostUnit::packetSplitting()
+{
+    QFETCH(bool, binary);
+    QFETCH(int, chunk);
+    QString name = QString("qtghost-unit-%1").arg(QCoreApplication::applicationPid());
+    Server server(nullptr, name);
+    QSignalSpy received(&server, SIGNAL(dataReceived(QByteArray,int)));
+    QLocalSocket client;
+    QList<QByteArray> packets;
+    QByteArray stream;
+
+    // small packets wrap the receive ring, the big one makes it grow
+    packets << "-v" << "" << QByteArray(100, 'a');
+    for (int i = 0; i < 150; i++) {
+        packets << QByteArray(1000 + i, static_cast<char>('a' + i % 26));
+    }
+    packets << QByteArray(100000, 'b') << "-e";
+
+    if (binary)
+        stream.append(binary_framing_magic, sizeof(binary_framing_magic) - 1);
+    foreach (const QByteArray &packet, packets) {
+        if (binary) {
+            char size[4];
+            qToLittleEndian<quint32>(packet.size(), reinterpret_cast<uchar*>(size));
+            stream.append(size, 4);
+        }
+        else {
+            stream.append(QByteArray::number(packet.size()) + ":");
+        }
+        stream.append(packet);
+    }
+
+    client.connectToServer(name);
+    QVERIFY(client.waitForConnected(5000));
+    for (int offset = 0; offset < stream.size(); offset += chunk) {
+        client.write(stream.mid(offset, chunk));
+        client.flush();
+        // let the server parse what it got so far when the writes are small
+        if (chunk < 16 && offset < 64)
+            QCoreApplication::processEvents();
+    }
+    QTRY_COMPARE_WITH_TIMEOUT(received.count(), packets.size(), 10000);
+    for (int i = 0; i < packets.size(); i++) {
+        QCOMPARE(received.at(i).at(0).toByteArray(), packets.at(i));
+    }
+    client.disconnectFromServer();
+}
+
+void QtghostUnit::opcodeForCommand()
+{
+    QCOMPARE(::opcodeForCommand("-j "), quint8(OP_GET_REC));
+    QCOMPARE(::opcodeForCommand("-j+ "), quint8(OP_GET_REC));
+    QCOMPARE(::opcodeForCommand("-ok"), quint8(OP_ACK));
+    QCOMPARE(::opcodeForCommand("-w "), quint8(OP_WAIT));
+    QCOMPARE(::opcodeForCommand("-zz "), quint8(OP_ERROR));
+    QCOMPARE(::opcodeForCommand(""), quint8(OP_ERROR));
+}
+
+void QtghostUnit::captureQueue()
+{
+    CaptureQueue queue;
+    QVector<recEvent> out;
+    QString text(30000, 'x');
+
+    // long texts go through the text ring, wrapping around it
+    for (int i = 0; i < 5; i++) {
+        text[0] = QChar('a' + i);
+        QVERIFY(queue.push(QPointF(i, 0), 1, wait_event, 0, text, QPointF()));
+        QVERIFY(queue.push(QPointF(), 1, QEvent::KeyPress, Qt::Key_A, "a", QPointF()));
+        out.resize(0);
+        QCOMPARE(queue.drain(&out), 2);
+        QCOMPARE(out.at(0).argS, text);
+        QCOMPARE(out.at(1).argS, QString("a"));
+    }
+
+    // a full text ring drops the event, its delay goes to the next one
+    QVERIFY(queue.push(QPointF(), 1, wait_event, 0, text, QPointF()));
+    QVERIFY(queue.push(QPointF(), 2, wait_event, 0, text, QPointF()));
+    QVERIFY(!queue.push(QPointF(), 30, wait_event, 0, text, QPointF()));
+    QVERIFY(queue.push(QPointF(), 4, QEvent::MouseMove, 0, QString(), QPointF()));
+    out.resize(0);
+    QCOMPARE(queue.drain(&out), 3);
+    QCOMPARE(out.at(2).time, 34);
+
+    // same for a full record queue
+    for (int i = 0; i < capture_queue_size; i++) {
+        QVERIFY(queue.push(QPointF(), 1, QEvent::MouseMove, 0, QString(), QPointF()));
+    }
+    QVERIFY(!queue.push(QPointF(), 50, QEvent::MouseMove, 0, QString(), QPointF()));
+    QVERIFY(!queue.push(QPointF(), 50, QEvent::MouseMove, 0, QString(), QPointF()));
+    out.resize(0);
+    QCOMPARE(queue.drain(&out), capture_queue_size);
+    QVERIFY(queue.push(QPointF(), 5, QEvent::MouseMove, 0, QString(), QPointF()));
+    out.resize(0);
+    QCOMPARE(queue.drain(&out), 1);
+    QCOMPARE(out.at(0).time, 105);
+    QCOMPARE(queue.droppedCount(), quint32(3));
+}
+
+void QtghostUnit::eventStoreSnapshot()
+{
+    EventStore store;
+    QVector<recEvent> expected;
+    int first = event_chunk_size + 100;
+
+    store.reserve(event_chunk_size);
+    for (int i = 0; i < first; i++) {
+        recEvent event = make_event(i % 3 ? QEvent::MouseMove : QEvent::KeyPress, QPointF(i, -i), i % 17, i,
+                                    i % 3 ? QString() : QString("key %1").arg(i % 5), QPointF(0.5 * i, 2));
+        store.append(event);
+        expected << event;
+    }
+
+    // a copy taken while recording keeps its events while the original appends to the shared chunk
+    EventStore snapshot(store);
+    for (int i = 0; i < event_chunk_size; i++) {
+        store.append(make_event(QEvent::KeyPress, QPointF(-1, -1), 99, -1, QString("new %1").arg(i % 7)));
+    }
+    store.reserve(3 * event_chunk_size);
+    for (int i = 0; i < 2 * event_chunk_size; i++) {
+        store.append(make_event(QEvent::MouseMove, QPointF(-2, -2), 98, -2));
+    }
+    snapshot.reserve(event_chunk_size);
+
+    QCOMPARE(snapshot.size(), first);
+    QCOMPARE(store.size(), first + 3 * event_chunk_size);
+    for (int i = 0; i < first; i++) {
+        compare_events(snapshot.at(i), expected.at(i));
+        compare_events(store.at(i), expected.at(i));
+        QCOMPARE(snapshot.typeAt(i), expected.at(i).type);
+        QCOMPARE(snapshot.timeAt(i), expected.at(i).time);
+    }
+
+    // so does an assigned copy once the original is cleared
+    EventStore assigned;
+    assigned = store;
+    store.clear();
+    store.append(make_event(QEvent::MouseMove, QPointF(-3, -3), 97));
+    QCOMPARE(assigned.size(), first + 3 * event_chunk_size);
+    compare_events(assigned.at(0), expected.at(0));
+    QCOMPARE(assigned.at(first).argS, QString("new 0"));
+    QCOMPARE(assigned.at(assigned.size() - 1).pos, QPointF(-2, -2));
+}
+
+void QtghostUnit::eventStoreAppendMapped()
+{
+    QTemporaryFile file;
+    EventStore store;
+
+    // two events, no strings
+    QVERIFY(file.open());
+    QDataStream out(&file);
+    out.setByteOrder(QDataStream::LittleEndian);
+    out.setFloatingPointPrecision(QDataStream::DoublePrecision);
+    out.writeRawData(rec_indexed_magic, 4);
+    out << rec_indexed_version << quint32(2) << quint32(sizeof(indexedRecord))
+        << quint64(sizeof(indexedHeader) + 2 * sizeof(indexedRecord)) << quint32(0)
+        << quint32(sizeof(indexedHeader));
+    for (int i = 0; i < 2; i++) {
+        out << 10.0 * i << 20.0 << 0.0 << 0.0 << qint32(16) << qint32(0) << qint32(0)
+            << quint16(QEvent::MouseMove) << quint16(0);
+    }
+    file.close();
+
+    QVERIFY(store.map(file.fileName()));
+    QCOMPARE(store.size(), 2);
+    QCOMPARE(store.at(1).pos, QPointF(10, 20));
+
+    // appending to a mapped store starts a new in-memory recording
+    store.append(QPointF(1, 2), 5, QEvent::MouseButtonPress, 0, QString(), QPointF());
+    QVERIFY(!store.isMapped());
+    QCOMPARE(store.size(), 1);
+    QCOMPARE(store.at(0).pos, QPointF(1, 2));
+    QCOMPARE(store.timeAt(0), 5);
+}
+
+void QtghostUnit::timeIndex_data()
+{
+    QTest::addColumn<QList<int> >("delays");
+
+    QList<int> mixed;
+    for (int i = 0; i < 1000; i++) {
+        // runs of simultaneous events across the sample strides
+        mixed << ((i / 40) % 3 ? i % 7 : 0);
+    }
+    QList<int> zeros;
+    for (int i = 0; i < 2 * time_index_stride; i++) {
+        zeros << 0;
+    }
+    QList<int> steady;
+    for (int i = 0; i < 3 * time_index_stride + 1; i++) {
+        steady << 10;
+    }
+
+    QTest::newRow("empty") << QList<int>();
+    QTest::newRow("one event") << (QList<int>() << 25);
+    QTest::newRow("all at once") << zeros;
+    QTest::newRow("strides") << steady;
+    QTest::newRow("mixed") << mixed;
+}
+
+void QtghostUnit::timeIndex()
+{
+    QFETCH(QList<int>, delays);
+    EventStore store;
+    TimeIndex index;
+    qint64 total = 0;
+
+    foreach (int delay, delays) {
+        store.append(QPointF(), delay, QEvent::MouseMove, 0, QString(), QPointF());
+        total += delay;
+    }
+    QVERIFY(!index.covers(store) || delays.isEmpty());
+    index.build(store);
+    QVERIFY(index.covers(store));
+
+    // first event recorded at or after ms, by a linear walk
+    for (qint64 ms = -1; ms <= total + 1; ms++) {
+        int expected = 0;
+        qint64 time = delays.isEmpty() ? 0 : delays.first();
+        while (expected < delays.size() && time < ms) {
+            expected++;
+            if (expected < delays.size())
+                time += delays.at(expected);
+        }
+        QCOMPARE(index.indexAt(store, ms), expected);
+    }
+
+    store.append(QPointF(), 1, QEvent::MouseMove, 0, QString(), QPointF());
+    QVERIFY(!index.covers(store));
+    index.clear();
+    QCOMPARE(index.covers(store), false);
+}
+
+void QtghostUnit::waitConditionParse_data()
+{
+    QTest::addColumn<QString>("spec");
+    QTest::addColumn<QString>("name");
+    QTest::addColumn<QString>("property");
+    QTest::addColumn<QString>("value");
+    QTest::addColumn<bool>("compare");
+
+    QTest::newRow("exists") << "dialog" << "dialog" << "" << "" << false;
+    QTest::newRow("property") << "dialog.visible" << "dialog" << "visible" << "" << false;
+    QTest::newRow("value") << "list.count=3" << "list" << "count" << "3" << true;
+    QTest::newRow("empty value") << "field.text=" << "field" << "text" << "" << true;
+    QTest::newRow("dotted value") << "label.text=v1.2" << "label" << "text" << "v1.2" << true;
+    QTest::newRow("value with =") << "label.text=a=b" << "label" << "text" << "a=b" << true;
+    QTest::newRow("padded") << "  dialog . visible  " << "dialog" << "visible" << "" << false;
+    QTest::newRow("empty") << "" << "" << "" << "" << false;
+    QTest::newRow("blank") << "   " << "" << "" << "" << false;
+    QTest::newRow("no name") << ".visible" << "" << "visible" << "" << false;
+    QTest::newRow("value only") << "=3" << "" << "" << "3" << true;
+    QTest::newRow("value without property") << "list=3" << "" << "" << "3" << true;
+}
+
+void QtghostUnit::waitConditionParse()
+{
+    QFETCH(QString, spec);
+    QFETCH(QString, name);
+    QFETCH(QString, property);
+    QFETCH(QString, value);
+    QFETCH(bool, compare);
+    waitCondition condition = waitCondition::parse(spec);
+
+    QCOMPARE(condition.name, name);
+    if (name.isEmpty())
+        return;
+    QCOMPARE(condition.property, property);
+    QCOMPARE(condition.value, value);
+    QCOMPARE(condition.compare, compare);
+    // toString() parses back to the same condition
+    waitCondition again = waitCondition::parse(condition.toString());
+    QCOMPARE(again.name, name);
+    QCOMPARE(again.property, property);
+    QCOMPARE(again.value, value);
+    QCOMPARE(again.compare, compare);
+}
+
+void QtghostUnit::waitConditionIsMet()
+{
+    QObject object;
+
+    object.setObjectName("dialog");
+    object.setProperty("shown", false);
+    object.setProperty("count", 3);
+
+    QVERIFY(!waitCondition::parse("dialog").isMet(nullptr));
+    QVERIFY(waitCondition::parse("dialog").isMet(&object));
+    QVERIFY(!waitCondition::parse("dialog.shown").isMet(&object));
+    QVERIFY(!waitCondition::parse("dialog.missing").isMet(&object));
+    QVERIFY(waitCondition::parse("dialog.count").isMet(&object));
+    QVERIFY(waitCondition::parse("dialog.count=3").isMet(&object));
+    QVERIFY(!waitCondition::parse("dialog.count=4").isMet(&object));
+    QVERIFY(waitCondition::parse("dialog.objectName=dialog").isMet(&object));
+    object.setProperty("shown", true);
+    QVERIFY(waitCondition::parse("dialog.shown").isMet(&object));
+}
+
+void QtghostUnit::objectIndexRelease()
+{
+    QObject root;
+    QObject *child = new QObject(&root);
+    ObjectIndex index;
+    QSignalSpy changed(&index, SIGNAL(changed()));
+
+    child->setObjectName("dialog");
+    index.setRoot(&root);
+    changed.clear();
+    QCOMPARE(index.find("dialog"), child);
+    QCOMPARE(index.walks(), 1);
+
+    // watched objects mark the index stale when renamed
+    child->setObjectName("other");
+    QCOMPARE(changed.count(), 1);
+    QCOMPARE(index.find("other"), child);
+    QCOMPARE(index.walks(), 2);
+
+    // released, nothing is watched until the next lookup walks the scene again
+    index.release();
+    child->setObjectName("dialog");
+    QCOMPARE(changed.count(), 1);
+    QCOMPARE(index.find("dialog"), child);
+    QCOMPARE(index.walks(), 3);
+    child->setObjectName("again");
+    QCOMPARE(changed.count(), 2);
+}
+
+void QtghostUnit::pathSimplifier_data()
+{
+    QTest::addColumn<qreal>("tolerance");
+    QTest::addColumn<qreal>("minDistance");
+    QTest::addColumn<int>("minInterval");
+
+    QTest::newRow("tolerance") << qreal(2) << qreal(0) << 0;
+    QTest::newRow("fine tolerance") << qreal(0.5) << qreal(0) << 0;
+    QTest::newRow("min distance") << qreal(0) << qreal(12) << 0;
+    QTest::newRow("min interval") << qreal(0) << qreal(0) << 12;
+    QTest::newRow("all") << qreal(3) << qreal(6) << 10;
+}
+
+void QtghostUnit::pathSimplifier()
+{
+    QFETCH(qreal, tolerance);
+    QFETCH(qreal, minDistance);
+    QFETCH(int, minInterval);
+    QVector<recEvent> input = path_sample();
+    QVector<recEvent> output;
+    QVector<qint64> inputTimes;
+    QVector<qint64> outputTimes;
+    QVector<int> kept;
+    PathSimplifier simplifier;
+    qint64 time = 0;
+
+    simplifier.configure(tolerance, minDistance, minInterval);
+    QVERIFY(simplifier.isEnabled());
+    foreach (const recEvent &event, input) {
+        simplifier.add(event, &output);
+        time += event.time;
+        inputTimes << time;
+    }
+    simplifier.flush(&output);
+    QVERIFY(output.size() < input.size());
+
+    // the output is the input, in order, at the same recorded times: only moves are dropped
+    time = 0;
+    int next = 0;
+    foreach (const recEvent &event, output) {
+        time += event.time;
+        while (next < input.size() && !(input.at(next).type == event.type && input.at(next).pos == event.pos
+                                        && inputTimes.at(next) == time)) {
+            QCOMPARE(input.at(next).type, QEvent::MouseMove);
+            next++;
+        }
+        QVERIFY(next < input.size());
+        QCOMPARE(event.argI, input.at(next).argI);
+        QCOMPARE(event.argS, input.at(next).argS);
+        QCOMPARE(event.pos2, input.at(next).pos2);
+        kept << next;
+        outputTimes << time;
+        next++;
+    }
+    // so the delays sum to the original timeline
+    QCOMPARE(kept.last(), input.size() - 1);
+    QCOMPARE(time, inputTimes.last());
+
+    // the last move before any other event is kept
+    for (int i = 1; i < input.size(); i++) {
+        if (input.at(i).type != QEvent::MouseMove && input.at(i - 1).type == QEvent::MouseMove)
+            QVERIFY2(kept.contains(i - 1), qPrintable(QString("move %1").arg(i - 1)));
+    }
+
+    if (minDistance > 0 || minInterval > 0)
+        return;
+    // every dropped move is within tolerance of the kept path, at its own time
+    for (int k = 0; k + 1 < kept.size(); k++) {
+        const recEvent &a = output.at(k);
+        const recEvent &b = output.at(k + 1);
+        qreal span = outputTimes.at(k + 1) - outputTimes.at(k);
+
+        for (int i = kept.at(k) + 1; i < kept.at(k + 1); i++) {
+            qreal ratio = span > 0 ? (inputTimes.at(i) - outputTimes.at(k)) / span : 0.5;
+            QPointF at = a.pos + (b.pos - a.pos) * ratio;
+            QVERIFY2(QLineF(at, input.at(i).pos).length() <= tolerance, qPrintable(QString("move %1").arg(i)));
+        }
+    }
+}
+
+void QtghostUnit::touchRecordSlots()
+{
+    typedef QTouchEvent::TouchPoint P;
+    TouchRecorder recorder;
+    QVector<recEvent> out;
+
+    // device ids are mapped to the lowest free slots, a released slot is reused
+    QVERIFY(!record_touch(&recorder, QEvent::TouchBegin, QList<P>() << touch_point(100, Qt::TouchPointPressed, QPointF(10, 10))
+                          << touch_point(200, Qt::TouchPointPressed, QPointF(50, 50)), 0, &out));
+    QVERIFY(!record_touch(&recorder, QEvent::TouchUpdate, QList<P>() << touch_point(100, Qt::TouchPointReleased, QPointF(12, 10))
+                          << touch_point(200, Qt::TouchPointStationary, QPointF(50, 50)), 10, &out));
+    QVERIFY(!record_touch(&recorder, QEvent::TouchUpdate, QList<P>() << touch_point(200, Qt::TouchPointMoved, QPointF(52.4, 50))
+                          << touch_point(300, Qt::TouchPointPressed, QPointF(30, 30)), 20, &out));
+    QVERIFY(!record_touch(&recorder, QEvent::TouchEnd, QList<P>() << touch_point(200, Qt::TouchPointReleased, QPointF(52, 50))
+                          << touch_point(300, Qt::TouchPointReleased, QPointF(30, 30)), 30, &out));
+
+    QCOMPARE(out.size(), 7);
+    compare_events(out.at(0), make_event(QEvent::TouchBegin, QPointF(10, 10), 0, 0 | touch_frame_more));
+    compare_events(out.at(1), make_event(QEvent::TouchBegin, QPointF(50, 50), 0, 1));
+    compare_events(out.at(2), make_event(QEvent::TouchEnd, QPointF(12, 10), 10, 0));
+    compare_events(out.at(3), make_event(QEvent::TouchUpdate, QPointF(52, 50), 20, 1 | touch_frame_more));
+    compare_events(out.at(4), make_event(QEvent::TouchBegin, QPointF(30, 30), 20, 0));
+    compare_events(out.at(5), make_event(QEvent::TouchEnd, QPointF(52, 50), 30, 1 | touch_frame_more));
+    compare_events(out.at(6), make_event(QEvent::TouchEnd, QPointF(30, 30), 30, 0));
+
+    QCOMPARE(replay_touch(out), QStringList() << "begin 0P10,10 1P50,50" << "update 0R12,10 1S50,50"
+             << "update 0P30,30 1M52,50" << "end 0R30,30 1R52,50");
+}
+
+void QtghostUnit::touchRecordCoalescing()
+{
+    typedef QTouchEvent::TouchPoint P;
+    TouchRecorder recorder;
+    QVector<recEvent> out;
+
+    recorder.setCoalescing(16);
+    QVERIFY(!record_touch(&recorder, QEvent::TouchBegin, QList<P>() << touch_point(1, Qt::TouchPointPressed, QPointF(0, 0))
+                          << touch_point(2, Qt::TouchPointPressed, QPointF(100, 0)), 0, &out));
+    QCOMPARE(out.size(), 2);
+
+    // moves closer than the interval to the last stored event are merged, per point
+    QVERIFY(record_touch(&recorder, QEvent::TouchUpdate, QList<P>() << touch_point(1, Qt::TouchPointMoved, QPointF(5, 0))
+                         << touch_point(2, Qt::TouchPointStationary, QPointF(100, 0)), 4, &out));
+    QVERIFY(record_touch(&recorder, QEvent::TouchUpdate, QList<P>() << touch_point(1, Qt::TouchPointStationary, QPointF(5, 0))
+                         << touch_point(2, Qt::TouchPointMoved, QPointF(105, 0)), 8, &out));
+    QVERIFY(record_touch(&recorder, QEvent::TouchUpdate, QList<P>() << touch_point(1, Qt::TouchPointMoved, QPointF(9, 0))
+                         << touch_point(2, Qt::TouchPointStationary, QPointF(105, 0)), 12, &out));
+    QCOMPARE(out.size(), 2);
+    // the interval is over: one event, latest positions, observed at the last move
+    QVERIFY(!record_touch(&recorder, QEvent::TouchUpdate, QList<P>() << touch_point(1, Qt::TouchPointMoved, QPointF(10, 0))
+                          << touch_point(2, Qt::TouchPointStationary, QPointF(105, 0)), 17, &out));
+    QCOMPARE(out.size(), 4);
+    compare_events(out.at(2), make_event(QEvent::TouchUpdate, QPointF(10, 0), 17, 0 | touch_frame_more));
+    compare_events(out.at(3), make_event(QEvent::TouchUpdate, QPointF(105, 0), 17, 1));
+
+    // flushed later (no event follows), it keeps the time it was observed at
+    QVERIFY(record_touch(&recorder, QEvent::TouchUpdate, QList<P>() << touch_point(1, Qt::TouchPointStationary, QPointF(10, 0))
+                         << touch_point(2, Qt::TouchPointMoved, QPointF(110, 0)), 20, &out));
+    QVERIFY(record_touch(&recorder, QEvent::TouchUpdate, QList<P>() << touch_point(1, Qt::TouchPointStationary, QPointF(10, 0))
+                         << touch_point(2, Qt::TouchPointMoved, QPointF(110.3, 0)), 22, &out));
+    recorder.flush(&out);
+    QCOMPARE(out.size(), 5);
+    compare_events(out.at(4), make_event(QEvent::TouchUpdate, QPointF(110, 0), 20, 1));
+    recorder.flush(&out);
+    QCOMPARE(out.size(), 5);
+
+    QCOMPARE(replay_touch(out), QStringList() << "begin 0P0,0 1P100,0" << "update 0M10,0 1M105,0"
+             << "update 0S10,0 1M110,0");
+}
+
+void QtghostUnit::touchRecordFlushPending()
+{
+    typedef QTouchEvent::TouchPoint P;
+    TouchRecorder recorder;
+    QVector<recEvent> out;
+
+    recorder.setCoalescing(16);
+    record_touch(&recorder, QEvent::TouchBegin, QList<P>() << touch_point(1, Qt::TouchPointPressed, QPointF(0, 0)), 0, &out);
+    QVERIFY(record_touch(&recorder, QEvent::TouchUpdate, QList<P>() << touch_point(1, Qt::TouchPointMoved, QPointF(3, 0)), 5, &out));
+
+    // a press stores the pending moves first, as their own event
+    QVERIFY(!record_touch(&recorder, QEvent::TouchUpdate, QList<P>() << touch_point(1, Qt::TouchPointStationary, QPointF(3, 0))
+                          << touch_point(2, Qt::TouchPointPressed, QPointF(50, 50)), 9, &out));
+    QCOMPARE(out.size(), 3);
+    compare_events(out.at(1), make_event(QEvent::TouchUpdate, QPointF(3, 0), 5, 0));
+    compare_events(out.at(2), make_event(QEvent::TouchBegin, QPointF(50, 50), 9, 1));
+
+    // so does a release
+    QVERIFY(record_touch(&recorder, QEvent::TouchUpdate, QList<P>() << touch_point(1, Qt::TouchPointMoved, QPointF(6, 0))
+                         << touch_point(2, Qt::TouchPointStationary, QPointF(50, 50)), 11, &out));
+    QVERIFY(!record_touch(&recorder, QEvent::TouchUpdate, QList<P>() << touch_point(1, Qt::TouchPointReleased, QPointF(6, 0))
+                          << touch_point(2, Qt::TouchPointStationary, QPointF(50, 50)), 13, &out));
+    QCOMPARE(out.size(), 5);
+    compare_events(out.at(3), make_event(QEvent::TouchUpdate, QPointF(6, 0), 11, 0));
+    compare_events(out.at(4), make_event(QEvent::TouchEnd, QPointF(6, 0), 13, 0));
+
+    QCOMPARE(replay_touch(out), QStringList() << "begin 0P0,0" << "update 0M3,0" << "update 0S3,0 1P50,50"
+             << "update 0M6,0 1S50,50" << "update 0R6,0 1S50,50");
+}
+
+void QtghostUnit::touchReplayFrames()
+{
+    TouchPlayer player;
+    QTouchDevice device;
+    QTouchEvent *event;
+
+    // records flagged touch_frame_more wait for the rest of their event
+    QVERIFY(!player.add(make_event(QEvent::TouchBegin, QPointF(1, 1), 0, 0 | touch_frame_more)));
+    QVERIFY(player.add(make_event(QEvent::TouchBegin, QPointF(2, 2), 0, 1)));
+    event = player.take(&device, nullptr, 40);
+    QCOMPARE(describe_touch(event), QString("begin 0P1,1 1P2,2"));
+    QCOMPARE(event->device(), &device);
+    QCOMPARE(event->timestamp(), ulong(40));
+    QCOMPARE(int(event->touchPointStates()), int(Qt::TouchPointPressed));
+    QCOMPARE(event->touchPoints().at(0).pressure(), qreal(1));
+    delete event;
+
+    // stationary points are sent again
+    QVERIFY(player.add(make_event(QEvent::TouchUpdate, QPointF(3, 3), 16, 1)));
+    event = player.take(&device, nullptr, 56);
+    QCOMPARE(describe_touch(event), QString("update 0S1,1 1M3,3"));
+    QCOMPARE(event->touchPoints().at(1).lastPos(), QPointF(2, 2));
+    QCOMPARE(event->touchPoints().at(1).startPos(), QPointF(2, 2));
+    delete event;
+
+    QVERIFY(!player.add(make_event(QEvent::TouchEnd, QPointF(1, 1), 16, 0 | touch_frame_more)));
+    QVERIFY(player.add(make_event(QEvent::TouchEnd, QPointF(3, 3), 0, 1)));
+    event = player.take(&device, nullptr, 72);
+    QCOMPARE(describe_touch(event), QString("end 0R1,1 1R3,3"));
+    QCOMPARE(event->touchPoints().at(0).pressure(), qreal(0));
+    delete event;
+
+    // a play starting in the middle of a gesture presses the unknown points
+    QVERIFY(player.add(make_event(QEvent::TouchUpdate, QPointF(4, 4), 0, 2)));
+    event = player.take(&device, nullptr, 88);
+    QCOMPARE(describe_touch(event), QString("begin 2P4,4"));
+    delete event;
+}
+
+void QtghostUnit::touchCancel()
+{
+    typedef QTouchEvent::TouchPoint P;
+    TouchRecorder recorder;
+    QVector<recEvent> out;
+
+    recorder.setCoalescing(16);
+    record_touch(&recorder, QEvent::TouchBegin, QList<P>() << touch_point(7, Qt::TouchPointPressed, QPointF(10, 10)), 0, &out);
+    record_touch(&recorder, QEvent::TouchUpdate, QList<P>() << touch_point(7, Qt::TouchPointStationary, QPointF(10, 10))
+                 << touch_point(8, Qt::TouchPointPressed, QPointF(20, 20)), 1, &out);
+    QVERIFY(record_touch(&recorder, QEvent::TouchUpdate, QList<P>() << touch_point(7, Qt::TouchPointMoved, QPointF(12, 10))
+                         << touch_point(8, Qt::TouchPointStationary, QPointF(20, 20)), 3, &out));
+
+    // the pending moves and the slots are dropped
+    QVERIFY(!record_touch(&recorder, QEvent::TouchCancel, QList<P>(), 4, &out));
+    QCOMPARE(out.size(), 3);
+    compare_events(out.at(2), make_event(QEvent::TouchCancel, QPointF(), 4, 0));
+    recorder.flush(&out);
+    QCOMPARE(out.size(), 3);
+    record_touch(&recorder, QEvent::TouchBegin, QList<P>() << touch_point(9, Qt::TouchPointPressed, QPointF(30, 30)), 5, &out);
+    compare_events(out.at(3), make_event(QEvent::TouchBegin, QPointF(30, 30), 5, 0));
+
+    QCOMPARE(replay_touch(out), QStringList() << "begin 0P10,10" << "update 0S10,10 1P20,20" << "cancel"
+             << "begin 0P30,30");
+}
+
+QTEST_MAIN(QtghostUnit)
+
+#include "unit.moc"